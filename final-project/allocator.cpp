@@ -0,0 +1,67 @@
+#include "allocator.h"
+
+// Standard library
+#include <atomic>
+#include <stdlib.h>
+
+static std::atomic<size_t> allocationCount(0);
+static std::atomic<size_t> allocationBytes(0);
+
+// Replacements for the global operators, every container and new expression in the program comes through here.
+// The nothrow, array and sized forms all end up in these two
+void* operator new(size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocationBytes.fetch_add(size, std::memory_order_relaxed);
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+size_t AllocationCounter::getCount() {
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+size_t AllocationCounter::getBytes() {
+	return allocationBytes.load(std::memory_order_relaxed);
+}
+
+FrameArena::FrameArena(size_t capacity) {
+	this->memory = (unsigned char*)malloc(capacity);
+	this->capacity = capacity;
+	this->head = 0;
+	this->peak = 0;
+	this->overflows = 0;
+	overflowBlocks.reserve(64);
+}
+
+FrameArena::~FrameArena() {
+	reset();
+	free(memory);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+	size_t offset = (head + alignment - 1) / alignment * alignment;
+	if (offset + size > capacity) {
+		overflows++;
+		void* block = malloc(size > 0 ? size : 1);
+		overflowBlocks.push_back(block);
+		return block;
+	}
+	head = offset + size;
+	return memory + offset;
+}
+
+void FrameArena::reset() {
+	for (void* block : overflowBlocks) {
+		free(block);
+	}
+	overflowBlocks.clear();
+	peak = head > peak ? head : peak;
+	head = 0;
+}
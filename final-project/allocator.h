@@ -0,0 +1,154 @@
+#pragma once
+
+// Standard library
+#include <vector>
+#include <new>
+#include <utility>
+#include <stddef.h>
+
+// Counts every operator new in the process (allocator.cpp replaces the global operators), read it before and
+// after a stretch of code to see how many heap allocations it made
+class AllocationCounter {
+public:
+	static size_t getCount();
+	static size_t getBytes();
+};
+
+// Linear allocator for scratch data that lives for one frame. Allocation bumps a pointer into one block
+// reserved up front and reset() releases everything at once; nothing is freed individually. Requests that
+// don't fit go to the heap and are counted, so the capacity can be raised until a frame never overflows
+class FrameArena {
+public:
+	FrameArena(size_t capacity);
+	~FrameArena();
+
+	void* allocate(size_t size, size_t alignment);
+	// Start of the next frame, everything allocated before is invalid after this
+	void reset();
+
+	size_t getUsed() const { return head; }
+	size_t getPeak() const { return peak; }
+	size_t getCapacity() const { return capacity; }
+	int getOverflows() const { return overflows; }
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+private:
+	unsigned char* memory;
+	size_t capacity;
+	size_t head;
+	size_t peak;
+	int overflows;
+	std::vector<void*> overflowBlocks;
+};
+
+// Standard allocator over a FrameArena, for containers that are rebuilt every frame. Deallocation is a no-op,
+// the memory comes back with the arena's reset()
+template <typename T>
+class ArenaAllocator {
+public:
+	typedef T value_type;
+
+	ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) {
+		return (T*)arena->allocate(count * sizeof(T), alignof(T));
+	}
+	void deallocate(T*, size_t) {}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+	FrameArena* arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+// Fixed-size object pool. Objects are constructed in chunks of CHUNK_SIZE slots that are never returned to the
+// heap while the pool lives; destroyed slots go on a free list and are reused first, so creating and destroying
+// many objects of one type costs one heap allocation per chunk
+template <typename T>
+class Pool {
+public:
+	static constexpr size_t CHUNK_SIZE = 256;
+
+	Pool() : freeList(nullptr), live(0) {}
+
+	// Every object still alive is destroyed with the pool
+	~Pool() {
+		clear();
+	}
+
+	template <typename... Args>
+	T* create(Args&&... args) {
+		if (freeList == nullptr) {
+			grow();
+		}
+		Slot* slot = freeList;
+		freeList = slot->next;
+		slot->next = nullptr;
+		slot->used = true;
+		live++;
+		return new (slot->storage) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(T* object) {
+		if (object == nullptr) {
+			return;
+		}
+		object->~T();
+		Slot* slot = (Slot*)((unsigned char*)object - offsetof(Slot, storage));
+		slot->used = false;
+		slot->next = freeList;
+		freeList = slot;
+		live--;
+	}
+
+	// Destroys every live object and releases the chunks
+	void clear() {
+		for (Slot* chunk : chunks) {
+			for (size_t i = 0; i < CHUNK_SIZE; i++) {
+				if (chunk[i].used) {
+					((T*)chunk[i].storage)->~T();
+				}
+			}
+			delete[] chunk;
+		}
+		chunks.clear();
+		freeList = nullptr;
+		live = 0;
+	}
+
+	size_t getLiveCount() const { return live; }
+	size_t getCapacity() const { return chunks.size() * CHUNK_SIZE; }
+
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+
+private:
+	struct Slot {
+		alignas(T) unsigned char storage[sizeof(T)];
+		Slot* next;
+		bool used;
+	};
+
+	std::vector<Slot*> chunks;
+	Slot* freeList;
+	size_t live;
+
+	void grow() {
+		Slot* chunk = new Slot[CHUNK_SIZE];
+		for (size_t i = 0; i < CHUNK_SIZE; i++) {
+			chunk[i].used = false;
+			chunk[i].next = i + 1 < CHUNK_SIZE ? &chunk[i + 1] : nullptr;
+		}
+		chunks.push_back(chunk);
+		freeList = chunk;
+	}
+};
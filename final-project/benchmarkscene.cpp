@@ -0,0 +1,257 @@
+#include "benchmarkscene.h"
+
+// Standard library
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdio.h>
+
+// Windows specific
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+bool BenchmarkScene::load(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "BenchmarkScene: could not open " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		std::istringstream stream(line);
+		std::string key;
+		if (!(stream >> key) || key[0] == '#') {
+			continue;
+		}
+
+		std::string text;
+		bool valid = true;
+		if (key == "name") valid = (bool)(stream >> name);
+		else if (key == "model") valid = (bool)(stream >> model);
+		else if (key == "instances") valid = (bool)(stream >> instances);
+		else if (key == "materials") valid = (bool)(stream >> materials);
+		else if (key == "lights") valid = (bool)(stream >> lights);
+		else if (key == "spacing") valid = (bool)(stream >> spacing);
+		else if (key == "seed") valid = (bool)(stream >> seed);
+		else if (key == "renderer") {
+			valid = (bool)(stream >> text) && (text == "forward" || text == "deferred");
+			deferred = text == "deferred";
+		}
+		else if (key == "shadows") valid = (bool)(stream >> shadows);
+		else if (key == "ssao") valid = (bool)(stream >> ambientOcclusion);
+		else if (key == "ibl") valid = (bool)(stream >> imageBasedLighting);
+		else if (key == "taa") valid = (bool)(stream >> temporalAA);
+		else if (key == "camera") {
+			valid = (bool)(stream >> text);
+			if (text == "orbit") {
+				valid = (bool)(stream >> orbitRadius >> orbitHeight >> orbitSeconds);
+			}
+			else if (text == "static") {
+				valid = (bool)(stream >> orbitRadius >> orbitHeight);
+				orbitSeconds = 0.0f;
+			}
+			else {
+				valid = false;
+			}
+		}
+		else if (key == "warmup") valid = (bool)(stream >> warmupFrames);
+		else if (key == "frames") valid = (bool)(stream >> frames);
+		else {
+			std::cerr << "BenchmarkScene: " << path << ":" << lineNumber << ": unknown key " << key << std::endl;
+			continue;
+		}
+
+		if (!valid) {
+			std::cerr << "BenchmarkScene: " << path << ":" << lineNumber << ": bad value for " << key << std::endl;
+			return false;
+		}
+	}
+
+	instances = instances < 1 ? 1 : instances;
+	materials = materials < 1 ? 1 : materials;
+	frames = frames < 1 ? 1 : frames;
+	return true;
+}
+
+void BenchmarkRecorder::addFrame(double cpuMilliseconds, double gpuMilliseconds, size_t drawCalls, size_t triangles, size_t allocations) {
+	Sample sample = { cpuMilliseconds, gpuMilliseconds, drawCalls, triangles, allocations };
+	samples.push_back(sample);
+}
+
+void BenchmarkRecorder::sampleMemory() {
+	PROCESS_MEMORY_COUNTERS counters;
+	counters.cb = sizeof(counters);
+	processBytes = GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? (long long)counters.WorkingSetSize : -1;
+
+	// Only NVIDIA drivers expose the memory counters, in kilobytes
+	videoBytes = -1;
+	if (GLEW_NVX_gpu_memory_info) {
+		GLint total = 0, available = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+		videoBytes = (long long)(total - available) * 1024;
+	}
+}
+
+double BenchmarkRecorder::percentile(std::vector<double> values, double fraction) {
+	if (values.empty()) {
+		return 0.0;
+	}
+	// Nearest rank
+	size_t rank = (size_t)(fraction * (values.size() - 1) + 0.5);
+	std::nth_element(values.begin(), values.begin() + rank, values.end());
+	return values[rank];
+}
+
+double BenchmarkRecorder::mean(const std::vector<double>& values) {
+	double sum = 0.0;
+	for (double value : values) {
+		sum += value;
+	}
+	return values.empty() ? 0.0 : sum / values.size();
+}
+
+std::map<std::string, double> BenchmarkRecorder::summarize() const {
+	std::vector<double> cpu, gpu, draws, triangles, allocations;
+	for (const Sample& sample : samples) {
+		cpu.push_back(sample.cpuMilliseconds);
+		gpu.push_back(sample.gpuMilliseconds);
+		draws.push_back((double)sample.drawCalls);
+		triangles.push_back((double)sample.triangles);
+		allocations.push_back((double)sample.allocations);
+	}
+
+	std::map<std::string, double> summary;
+	summary["frames"] = (double)samples.size();
+	summary["cpu_mean_ms"] = mean(cpu);
+	summary["cpu_p50_ms"] = percentile(cpu, 0.5);
+	summary["cpu_p95_ms"] = percentile(cpu, 0.95);
+	summary["cpu_p99_ms"] = percentile(cpu, 0.99);
+	summary["cpu_max_ms"] = percentile(cpu, 1.0);
+	summary["gpu_mean_ms"] = mean(gpu);
+	summary["gpu_p50_ms"] = percentile(gpu, 0.5);
+	summary["gpu_p95_ms"] = percentile(gpu, 0.95);
+	summary["gpu_p99_ms"] = percentile(gpu, 0.99);
+	summary["gpu_max_ms"] = percentile(gpu, 1.0);
+	summary["draw_calls"] = mean(draws);
+	summary["triangles"] = mean(triangles);
+	summary["heap_allocations"] = mean(allocations);
+	summary["process_mb"] = processBytes < 0 ? -1.0 : processBytes / (1024.0 * 1024.0);
+	summary["video_mb"] = videoBytes < 0 ? -1.0 : videoBytes / (1024.0 * 1024.0);
+	return summary;
+}
+
+void BenchmarkRecorder::print(const BenchmarkScene& scene) const {
+	std::map<std::string, double> summary = summarize();
+	std::cout << "Scene benchmark '" << scene.name << "': " << scene.instances << " x " << scene.model << ", " << scene.materials
+		<< " materials, " << scene.lights << " lights, " << (scene.deferred ? "deferred" : "forward") << ", " << samples.size() << " frames" << std::endl;
+	std::cout << "  CPU ms: mean " << summary["cpu_mean_ms"] << ", p50 " << summary["cpu_p50_ms"] << ", p95 " << summary["cpu_p95_ms"]
+		<< ", p99 " << summary["cpu_p99_ms"] << ", max " << summary["cpu_max_ms"] << std::endl;
+	std::cout << "  GPU ms: mean " << summary["gpu_mean_ms"] << ", p50 " << summary["gpu_p50_ms"] << ", p95 " << summary["gpu_p95_ms"]
+		<< ", p99 " << summary["gpu_p99_ms"] << ", max " << summary["gpu_max_ms"] << std::endl;
+	std::cout << "  Draw calls: " << summary["draw_calls"] << ", triangles: " << summary["triangles"] << ", heap allocations: " << summary["heap_allocations"] << std::endl;
+	std::cout << "  Memory: " << summary["process_mb"] << " MB process, " << summary["video_mb"] << " MB video" << std::endl;
+}
+
+bool BenchmarkRecorder::writeCSV(const std::string& path) const {
+	FILE* file = nullptr;
+	if (fopen_s(&file, path.c_str(), "w") != 0 || file == nullptr) {
+		std::cerr << "BenchmarkRecorder: could not write " << path << std::endl;
+		return false;
+	}
+	fprintf(file, "frame,cpu_ms,gpu_ms,draw_calls,triangles,heap_allocations\n");
+	for (size_t i = 0; i < samples.size(); i++) {
+		fprintf(file, "%d,%.4f,%.4f,%llu,%llu,%llu\n", (int)i, samples[i].cpuMilliseconds, samples[i].gpuMilliseconds,
+			(unsigned long long)samples[i].drawCalls, (unsigned long long)samples[i].triangles, (unsigned long long)samples[i].allocations);
+	}
+	fclose(file);
+	return true;
+}
+
+bool BenchmarkRecorder::writeJSON(const std::string& path, const BenchmarkScene& scene) const {
+	FILE* file = nullptr;
+	if (fopen_s(&file, path.c_str(), "w") != 0 || file == nullptr) {
+		std::cerr << "BenchmarkRecorder: could not write " << path << std::endl;
+		return false;
+	}
+
+	// One key per line, readSummary() depends on it
+	fprintf(file, "{\n");
+	fprintf(file, "  \"scene\": \"%s\",\n", scene.name.c_str());
+	fprintf(file, "  \"model\": \"%s\",\n", scene.model.c_str());
+	fprintf(file, "  \"renderer\": \"%s\",\n", scene.deferred ? "deferred" : "forward");
+	fprintf(file, "  \"instances\": %d,\n", scene.instances);
+	fprintf(file, "  \"materials\": %d,\n", scene.materials);
+	fprintf(file, "  \"lights\": %d,\n", scene.lights);
+	std::map<std::string, double> summary = summarize();
+	size_t written = 0;
+	for (const auto& entry : summary) {
+		fprintf(file, "  \"%s\": %.4f%s\n", entry.first.c_str(), entry.second, ++written < summary.size() ? "," : "");
+	}
+	fprintf(file, "}\n");
+	fclose(file);
+	return true;
+}
+
+bool BenchmarkRecorder::readSummary(const std::string& path, std::map<std::string, double>& values) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "BenchmarkRecorder: could not open " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line)) {
+		size_t open = line.find('"');
+		size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+		size_t colon = close == std::string::npos ? std::string::npos : line.find(':', close);
+		if (colon == std::string::npos) {
+			continue;
+		}
+		// String values don't parse as a number and are skipped
+		std::istringstream stream(line.substr(colon + 1));
+		double value;
+		if (stream >> value) {
+			values[line.substr(open + 1, close - open - 1)] = value;
+		}
+	}
+	return true;
+}
+
+bool BenchmarkRecorder::compare(const std::string& baselinePath, const std::string& currentPath, double thresholdPercent) {
+	std::map<std::string, double> baseline, current;
+	if (!readSummary(baselinePath, baseline) || !readSummary(currentPath, current)) {
+		return false;
+	}
+
+	const char* gated[4] = { "cpu_p50_ms", "cpu_p95_ms", "gpu_p50_ms", "gpu_p95_ms" };
+	bool passed = true;
+	std::cout << "Benchmark comparison: " << baselinePath << " -> " << currentPath << " (threshold " << thresholdPercent << "%)" << std::endl;
+	for (const auto& entry : baseline) {
+		auto found = current.find(entry.first);
+		if (found == current.end()) {
+			continue;
+		}
+		double change = entry.second != 0.0 ? (found->second - entry.second) / entry.second * 100.0 : 0.0;
+		bool regressed = false;
+		for (const char* key : gated) {
+			if (entry.first == key && entry.second > 0.0 && change > thresholdPercent) {
+				regressed = true;
+			}
+		}
+		char row[160];
+		snprintf(row, sizeof(row), "  %-14s %12.4f %12.4f %+8.2f%%%s", entry.first.c_str(), entry.second, found->second, change, regressed ? "  REGRESSION" : "");
+		std::cout << row << std::endl;
+		passed = passed && !regressed;
+	}
+	std::cout << "  " << (passed ? "PASS" : "FAIL") << std::endl;
+	return passed;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// Standard library
+#include <map>
+#include <string>
+#include <vector>
+
+// Parametric stress scene for the benchmark runner, read from a plain text file of "key value" lines
+// (see scenes/). The instances are laid out on a square grid around the scene centre with a random turn
+// each, the materials are tints over the three texture sets and the camera orbits the grid
+struct BenchmarkScene {
+	std::string name = "unnamed";
+	std::string model = "utah_teapot.obj";
+	int instances = 1000;
+	int materials = 16;
+	int lights = 0;
+	float spacing = 6.0f;
+	unsigned int seed = 1;
+
+	bool deferred = false;
+	bool shadows = true;
+	bool ambientOcclusion = true;
+	bool imageBasedLighting = true;
+	bool temporalAA = true;
+
+	// A non-positive period keeps the camera still
+	float orbitRadius = 120.0f;
+	float orbitHeight = 40.0f;
+	float orbitSeconds = 20.0f;
+
+	int warmupFrames = 30;
+	int frames = 300;
+
+	bool load(const std::string& path);
+};
+
+// Per-frame samples of one run. The summary is a flat JSON object so two runs, typically from two
+// commits, can be compared key by key with compare()
+class BenchmarkRecorder {
+public:
+	void addFrame(double cpuMilliseconds, double gpuMilliseconds, size_t drawCalls, size_t triangles, size_t allocations);
+	// Working set of the process and video memory in use, -1 where the driver doesn't report it
+	void sampleMemory();
+
+	void print(const BenchmarkScene& scene) const;
+	bool writeCSV(const std::string& path) const;
+	bool writeJSON(const std::string& path, const BenchmarkScene& scene) const;
+
+	// Prints every shared metric of two summaries and returns false when a frame time percentile of
+	// current is more than thresholdPercent slower than baseline
+	static bool compare(const std::string& baselinePath, const std::string& currentPath, double thresholdPercent);
+
+private:
+	struct Sample {
+		double cpuMilliseconds;
+		double gpuMilliseconds;
+		size_t drawCalls;
+		size_t triangles;
+		size_t allocations;  // heap allocations made by the frame
+	};
+
+	std::vector<Sample> samples;
+	long long processBytes = -1;
+	long long videoBytes = -1;
+
+	static double percentile(std::vector<double> values, double fraction);
+	static double mean(const std::vector<double>& values);
+	static bool readSummary(const std::string& path, std::map<std::string, double>& values);
+	std::map<std::string, double> summarize() const;
+};
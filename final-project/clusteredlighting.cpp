@@ -0,0 +1,156 @@
+#include "clusteredlighting.h"
+
+// Standard library
+#include <vector>
+#include <chrono>
+#include <math.h>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+ClusteredLighting::ClusteredLighting(ThreadPool* threadPool) {
+	this->threadPool = threadPool;
+	this->zNear = 0.1f;
+	this->zFar = 1000.0f;
+	this->binningMilliseconds = 0.0;
+
+	clusterLights.resize(CLUSTER_COUNT);
+	clusterRanges.resize(CLUSTER_COUNT);
+
+	glGenBuffers(1, &lightBuffer);
+	glGenBuffers(1, &clusterBuffer);
+	glGenBuffers(1, &lightIndexBuffer);
+}
+
+ClusteredLighting::~ClusteredLighting() {
+	GLuint buffers[3] = { lightBuffer, clusterBuffer, lightIndexBuffer };
+	glDeleteBuffers(3, buffers);
+}
+
+int ClusteredLighting::getSlice(float depth) const {
+	// Exponential slicing keeps clusters roughly cubic in view space
+	int slice = (int)floorf(logf(depth / zNear) / logf(zFar / zNear) * GRID_Z);
+	return slice < 0 ? 0 : (slice >= GRID_Z ? GRID_Z - 1 : slice);
+}
+
+ClusteredLighting::LightBounds ClusteredLighting::computeBounds(const Light& light, const glm::mat4& view, const glm::mat4& proj) const {
+	LightBounds result = { 0, -1, 0, -1, 0, -1 };
+
+	glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(light.positionRadius), 1.0f));
+	float radius = light.positionRadius.w;
+
+	// View space looks down -z, work with positive depth
+	float minDepth = -center.z - radius;
+	float maxDepth = -center.z + radius;
+	if (maxDepth < zNear || minDepth > zFar) {
+		return result;
+	}
+	minDepth = minDepth < zNear ? zNear : minDepth;
+	maxDepth = maxDepth > zFar ? zFar : maxDepth;
+
+	// x / depth is monotonic in both, so the projected extremes of the bounding box are at its corners
+	float ndcMinX = 1e30f, ndcMaxX = -1e30f, ndcMinY = 1e30f, ndcMaxY = -1e30f;
+	float depths[2] = { minDepth, maxDepth };
+	for (int d = 0; d < 2; d++) {
+		for (int s = -1; s <= 1; s += 2) {
+			float x = (proj[0][0] * (center.x + s * radius)) / depths[d] - proj[2][0];
+			float y = (proj[1][1] * (center.y + s * radius)) / depths[d] - proj[2][1];
+			ndcMinX = x < ndcMinX ? x : ndcMinX;
+			ndcMaxX = x > ndcMaxX ? x : ndcMaxX;
+			ndcMinY = y < ndcMinY ? y : ndcMinY;
+			ndcMaxY = y > ndcMaxY ? y : ndcMaxY;
+		}
+	}
+	if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f) {
+		return result;
+	}
+
+	result.minX = (int)floorf((glm::clamp(ndcMinX, -1.0f, 1.0f) * 0.5f + 0.5f) * GRID_X);
+	result.maxX = (int)floorf((glm::clamp(ndcMaxX, -1.0f, 1.0f) * 0.5f + 0.5f) * GRID_X);
+	result.minY = (int)floorf((glm::clamp(ndcMinY, -1.0f, 1.0f) * 0.5f + 0.5f) * GRID_Y);
+	result.maxY = (int)floorf((glm::clamp(ndcMaxY, -1.0f, 1.0f) * 0.5f + 0.5f) * GRID_Y);
+	result.maxX = result.maxX >= GRID_X ? GRID_X - 1 : result.maxX;
+	result.maxY = result.maxY >= GRID_Y ? GRID_Y - 1 : result.maxY;
+	result.minZ = getSlice(minDepth);
+	result.maxZ = getSlice(maxDepth);
+	return result;
+}
+
+void ClusteredLighting::update(const glm::mat4& view, const glm::mat4& proj, float zNear, float zFar) {
+	auto start = std::chrono::high_resolution_clock::now();
+	this->zNear = zNear;
+	this->zFar = zFar;
+
+	// Pass 1: cluster ranges per light, split across the pool by light
+	bounds.resize(lights.size());
+	threadPool->parallelFor((int)lights.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			bounds[i] = computeBounds(lights[i], view, proj);
+		}
+	});
+
+	// Pass 2: split by depth slice so every cluster list is only written by one thread
+	threadPool->parallelFor(GRID_Z, [&](int begin, int end) {
+		for (int z = begin; z < end; z++) {
+			for (int cluster = z * GRID_X * GRID_Y; cluster < (z + 1) * GRID_X * GRID_Y; cluster++) {
+				clusterLights[cluster].clear();
+			}
+			for (size_t i = 0; i < bounds.size(); i++) {
+				const LightBounds& b = bounds[i];
+				if (z < b.minZ || z > b.maxZ) {
+					continue;
+				}
+				for (int y = b.minY; y <= b.maxY; y++) {
+					for (int x = b.minX; x <= b.maxX; x++) {
+						clusterLights[x + GRID_X * (y + GRID_Y * z)].push_back((GLuint)i);
+					}
+				}
+			}
+		}
+	});
+
+	// Pass 3: flatten into one index list
+	lightIndices.clear();
+	for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+		clusterRanges[cluster].offset = (GLuint)lightIndices.size();
+		clusterRanges[cluster].count = (GLuint)clusterLights[cluster].size();
+		lightIndices.insert(lightIndices.end(), clusterLights[cluster].begin(), clusterLights[cluster].end());
+	}
+
+	binningMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Orphan and refill, the previous frame's contents may still be in use by the GPU
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (lights.size() + 1) * sizeof(Light), NULL, GL_STREAM_DRAW);
+	if (!lights.empty()) {
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, lights.size() * sizeof(Light), &lights[0]);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_COUNT * sizeof(ClusterRange), &clusterRanges[0], GL_STREAM_DRAW);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightIndexBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (lightIndices.size() + 1) * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+	if (!lightIndices.empty()) {
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, lightIndices.size() * sizeof(GLuint), &lightIndices[0]);
+	}
+}
+
+void ClusteredLighting::bind(Shader* shader, int width, int height) {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_BINDING, lightIndexBuffer);
+
+	// slice = log(depth) * scale - bias, matching getSlice()
+	float scale = GRID_Z / logf(zFar / zNear);
+	float bias = GRID_Z * logf(zNear) / logf(zFar / zNear);
+	glUniform3i(glGetUniformLocation(shader->ID, "clusterGrid"), GRID_X, GRID_Y, GRID_Z);
+	glUniform2f(glGetUniformLocation(shader->ID, "screenSize"), (float)width, (float)height);
+	shader->setFloat("clusterScale", scale);
+	shader->setFloat("clusterBias", bias);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// Standard library
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "threadpool.h"
+
+// Point or spot light as read by the fragment shader (std430)
+struct Light {
+	glm::vec4 positionRadius; // world space position, w = range
+	glm::vec4 color;          // rgb, w = intensity
+	glm::vec4 spotDirection;  // xyz = direction, w = cosine of the cone angle (-1 for point lights)
+};
+
+// Offset and count into the light index list for one cluster
+struct ClusterRange {
+	GLuint offset;
+	GLuint count;
+};
+
+// Clustered forward lighting: the view frustum is split into GRID_X x GRID_Y screen tiles and GRID_Z
+// exponential depth slices, and every frame the lights are binned into the clusters they overlap
+class ClusteredLighting {
+public:
+	static constexpr int GRID_X = 16;
+	static constexpr int GRID_Y = 9;
+	static constexpr int GRID_Z = 24;
+	static constexpr int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+	// Binding points of the shader storage blocks in indirectFragmentShader.txt
+	static constexpr GLuint LIGHT_BINDING = 3;
+	static constexpr GLuint CLUSTER_BINDING = 4;
+	static constexpr GLuint LIGHT_INDEX_BINDING = 5;
+
+	std::vector<Light> lights;
+
+	ClusteredLighting(ThreadPool* threadPool);
+	~ClusteredLighting();
+
+	void update(const glm::mat4& view, const glm::mat4& proj, float zNear, float zFar);
+	void bind(Shader* shader, int width, int height);
+
+	double getBinningMilliseconds() const { return binningMilliseconds; }
+	size_t getLightIndexCount() const { return lightIndices.size(); }
+
+private:
+	// Inclusive cluster ranges covered by a light, minZ > maxZ when the light is not visible
+	struct LightBounds {
+		int minX, maxX;
+		int minY, maxY;
+		int minZ, maxZ;
+	};
+
+	ThreadPool* threadPool;
+	float zNear, zFar;
+	double binningMilliseconds;
+
+	GLuint lightBuffer, clusterBuffer, lightIndexBuffer;
+
+	std::vector<LightBounds> bounds;
+	std::vector<std::vector<GLuint>> clusterLights;
+	std::vector<ClusterRange> clusterRanges;
+	std::vector<GLuint> lightIndices;
+
+	LightBounds computeBounds(const Light& light, const glm::mat4& view, const glm::mat4& proj) const;
+	int getSlice(float depth) const;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+// Standard library
+#include <iostream>
+#include <string>
+#include <stdio.h>
+
+// OpenGL
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Single compute stage program. Not cached or hot reloaded like Shader, a failed build is printed
+// and leaves ID at 0 so dispatches are skipped
+class ComputeShader {
+public:
+	GLuint ID;
+	std::string computePath;
+
+	ComputeShader(const char* computePath) {
+		this->computePath = computePath;
+		this->ID = 0;
+
+		std::string source = readSource(computePath);
+		if (source.empty()) {
+			std::cerr << "Error reading compute shader source " << computePath << std::endl;
+			return;
+		}
+
+		GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+		const char* pSource = source.c_str();
+		glShaderSource(shader, 1, (const GLchar**)&pSource, NULL);
+		glCompileShader(shader);
+		GLint success = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success) {
+			GLchar infoLog[1024] = { '\0' };
+			glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+			std::cerr << "Error compiling compute shader " << computePath << ": " << infoLog << std::endl;
+			glDeleteShader(shader);
+			return;
+		}
+
+		GLuint program = glCreateProgram();
+		glAttachShader(program, shader);
+		glLinkProgram(program);
+		glDetachShader(program, shader);
+		glDeleteShader(shader);
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			GLchar infoLog[1024] = { '\0' };
+			glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+			std::cerr << "Error linking compute shader " << computePath << ": " << infoLog << std::endl;
+			glDeleteProgram(program);
+			return;
+		}
+		ID = program;
+	}
+
+	~ComputeShader() {
+		glDeleteProgram(ID);
+	}
+
+	bool isValid() const { return ID != 0; }
+
+	void use() {
+		glUseProgram(ID);
+	}
+
+	void dispatch(GLuint groupsX, GLuint groupsY = 1, GLuint groupsZ = 1) {
+		if (ID != 0) {
+			glDispatchCompute(groupsX, groupsY, groupsZ);
+		}
+	}
+
+	void setInt(const char* name, int value) const {
+		glUniform1i(glGetUniformLocation(ID, name), value);
+	}
+
+	void setFloat(const char* name, float value) const {
+		glUniform1f(glGetUniformLocation(ID, name), value);
+	}
+
+private:
+	static std::string readSource(const char* path) {
+		FILE* fp;
+		fopen_s(&fp, path, "rb");
+		if (fp == NULL) {
+			return std::string();
+		}
+		fseek(fp, 0L, SEEK_END);
+		long size = ftell(fp);
+		fseek(fp, 0L, SEEK_SET);
+		std::string buffer(size, '\0');
+		fread(&buffer[0], 1, size, fp);
+		fclose(fp);
+		return buffer;
+	}
+};
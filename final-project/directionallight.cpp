@@ -27,7 +27,7 @@ DirectionalLight::DirectionalLight(glm::vec4 position, glm::vec3 diffuse, glm::v
 void DirectionalLight::Draw(float deltaTime) {
 	this->Update(deltaTime);
 	int position_location = glGetUniformLocation(shaderProgramID, "LightPosition");
-	glUniform3fv(position_location,1, glm::value_ptr(position));
+	glUniform4f(position_location, position.x, position.y, position.z,1.0f);
 
 	int diffuse_location = glGetUniformLocation(shaderProgramID, "Ld");
 	glUniform3fv(diffuse_location,1, glm::value_ptr(diffuse));
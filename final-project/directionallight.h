@@ -24,11 +24,11 @@ public:
 
 	DirectionalLight(glm::vec4 position, glm::vec3 diffuse, glm::vec3 specular, glm::vec3 ambient, GLuint shaderProgramID, bool dayCycle = false);
 	void Draw(float deltaTime);
+	void Update(float deltaTime);
 	
 private:
 	
 	float cycleDuration;
-	void Update(float deltaTime);
 	glm::vec3 getLightColor(float time);
 	glm::vec3 getAmbientColor(float time);
 	glm::vec3 getLightPosition(float time);
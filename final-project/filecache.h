@@ -0,0 +1,30 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+
+// Windows specific
+#include <windows.h>
+
+// 64-bit FNV-1a over raw bytes, used for the keys of the on-disk caches
+inline unsigned long long hashBytes(const void* bytes, size_t length, unsigned long long hash = 14695981039346656037ull) {
+	for (size_t i = 0; i < length; i++) {
+		hash ^= ((const unsigned char*)bytes)[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Key over file paths, sizes and write times, so editing or replacing a source file invalidates the cache entry
+inline unsigned long long hashFiles(const std::vector<std::string>& paths, unsigned long long hash = 14695981039346656037ull) {
+	for (const std::string& path : paths) {
+		hash = hashBytes(path.c_str(), path.size() + 1, hash);
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes)) {
+			hash = hashBytes(&attributes.nFileSizeLow, sizeof(attributes.nFileSizeLow), hash);
+			hash = hashBytes(&attributes.ftLastWriteTime, sizeof(attributes.ftLastWriteTime), hash);
+		}
+	}
+	return hash;
+}
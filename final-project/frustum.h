@@ -0,0 +1,37 @@
+#pragma once
+
+// GLM
+#include <glm/glm.hpp>
+
+// Six clip planes (left, right, bottom, top, near, far) extracted from a view-projection matrix
+struct Frustum {
+	glm::vec4 planes[6];
+
+	Frustum() {}
+
+	Frustum(const glm::mat4& viewProj) {
+		// Gribb-Hartmann: each plane is the last row of the matrix plus or minus one of the others
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+		}
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		planes[4] = rows[3] + rows[2];
+		planes[5] = rows[3] - rows[2];
+		for (int i = 0; i < 6; i++) {
+			planes[i] /= glm::length(glm::vec3(planes[i]));
+		}
+	}
+
+	bool intersectsSphere(const glm::vec3& center, float radius) const {
+		for (int i = 0; i < 6; i++) {
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
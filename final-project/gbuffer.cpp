@@ -0,0 +1,96 @@
+#include "gbuffer.h"
+
+// Standard library
+#include <iostream>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+GBuffer::GBuffer(int width, int height) {
+	this->width = width;
+	this->height = height;
+	glGenFramebuffers(1, &framebuffer);
+	glGenVertexArrays(1, &emptyVAO);
+	createTargets();
+}
+
+GBuffer::~GBuffer() {
+	deleteTargets();
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteVertexArrays(1, &emptyVAO);
+}
+
+static GLuint createTarget(GLenum internalFormat, int width, int height) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+	// Only ever read with texelFetch
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+void GBuffer::createTargets() {
+	albedoTexture = createTarget(GL_RGBA8, width, height);
+	normalTexture = createTarget(GL_RG16_SNORM, width, height);
+	materialTexture = createTarget(GL_R16UI, width, height);
+	depthTexture = createTarget(GL_DEPTH_COMPONENT24, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, materialTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "GBuffer: framebuffer incomplete at " << width << "x" << height << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::deleteTargets() {
+	GLuint textures[4] = { albedoTexture, normalTexture, materialTexture, depthTexture };
+	glDeleteTextures(4, textures);
+}
+
+void GBuffer::resize(int width, int height) {
+	if (width == this->width && height == this->height) {
+		return;
+	}
+	this->width = width;
+	this->height = height;
+	deleteTargets();
+	createTargets();
+}
+
+void GBuffer::bindForWriting() {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+	// Colour is not cleared, the lighting pass skips every pixel still at the far plane
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::bindForReading() {
+	glActiveTexture(GL_TEXTURE0 + ALBEDO_UNIT);
+	glBindTexture(GL_TEXTURE_2D, albedoTexture);
+	glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+	glBindTexture(GL_TEXTURE_2D, normalTexture);
+	glActiveTexture(GL_TEXTURE0 + MATERIAL_UNIT);
+	glBindTexture(GL_TEXTURE_2D, materialTexture);
+	glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void GBuffer::drawFullscreen() {
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+}
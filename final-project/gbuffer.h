@@ -0,0 +1,42 @@
+#pragma once
+
+// OpenGL
+#include <GL/glew.h>
+
+// Render targets of the deferred path, 14 bytes per pixel:
+//   albedo   RGBA8   rgb = diffuse texture colour
+//   normal   RG16    octahedral encoded world space normal
+//   material R16UI   index into the material SSBO, the lighting pass reads Ka/Kd/Ks/Ns from there
+//   depth    24 bit  world position is reconstructed from it
+class GBuffer {
+public:
+	// Texture units read by deferredFragmentShader.txt, clear of the material arrays and the shadow map
+	static constexpr GLuint ALBEDO_UNIT = 4;
+	static constexpr GLuint NORMAL_UNIT = 5;
+	static constexpr GLuint MATERIAL_UNIT = 6;
+	static constexpr GLuint DEPTH_UNIT = 7;
+
+	GBuffer(int width, int height);
+	~GBuffer();
+
+	// Reallocates the targets when the window size changed
+	void resize(int width, int height);
+
+	void bindForWriting();
+	void bindForReading();
+	// Fullscreen triangle, the vertex shader builds it from gl_VertexID
+	void drawFullscreen();
+
+	GLuint getDepthTexture() const { return depthTexture; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+private:
+	int width, height;
+	GLuint framebuffer;
+	GLuint albedoTexture, normalTexture, materialTexture, depthTexture;
+	GLuint emptyVAO;
+
+	void createTargets();
+	void deleteTargets();
+};
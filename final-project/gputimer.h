@@ -0,0 +1,95 @@
+#pragma once
+
+// Standard library
+#include <map>
+#include <iostream>
+
+// OpenGL
+#include <GL/glew.h>
+
+// Begin/end query (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ...) over a small ring of query objects. Results
+// are only read once the driver reports them available, so measuring never stalls the pipeline; the
+// reported value lags a frame or two behind.
+// Only one query per target can be active, and a nested begin would make the inner end() close the outer
+// query, so a begin while another query of the same target is open is skipped instead. Passes that nest are
+// timed with the Profiler's GL_TIMESTAMP markers
+class GpuQuery {
+public:
+	static constexpr int QUERY_COUNT = 3;
+
+	GpuQuery(GLenum target) {
+		this->target = target;
+		glGenQueries(QUERY_COUNT, queries);
+		for (int i = 0; i < QUERY_COUNT; i++) {
+			pending[i] = false;
+		}
+		current = 0;
+		active = false;
+		result = 0;
+	}
+
+	~GpuQuery() {
+		glDeleteQueries(QUERY_COUNT, queries);
+	}
+
+	void begin() {
+		collect();
+		GpuQuery*& open = openQuery(target);
+		if (open != nullptr) {
+			static bool warned = false;
+			if (!warned) {
+				std::cerr << "GpuQuery: a query of this target is already active, skipping the nested one" << std::endl;
+				warned = true;
+			}
+			active = false;
+			return;
+		}
+		// Every query in the ring is still in flight, skip this measurement rather than wait
+		active = !pending[current];
+		if (active) {
+			glBeginQuery(target, queries[current]);
+			open = this;
+		}
+	}
+
+	void end() {
+		if (!active) {
+			return;
+		}
+		glEndQuery(target);
+		openQuery(target) = nullptr;
+		pending[current] = true;
+		current = (current + 1) % QUERY_COUNT;
+		active = false;
+	}
+
+	GLuint64 getResult() const { return result; }
+
+private:
+	GLenum target;
+	GLuint queries[QUERY_COUNT];
+	bool pending[QUERY_COUNT];
+	int current;
+	bool active;
+	GLuint64 result;
+
+	// The query currently active on target, if it is one of these
+	static GpuQuery*& openQuery(GLenum target) {
+		static std::map<GLenum, GpuQuery*> open;
+		return open[target];
+	}
+
+	void collect() {
+		for (int i = 0; i < QUERY_COUNT; i++) {
+			if (!pending[i]) {
+				continue;
+			}
+			GLint available = 0;
+			glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &result);
+				pending[i] = false;
+			}
+		}
+	}
+};
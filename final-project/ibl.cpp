@@ -0,0 +1,458 @@
+#include "ibl.h"
+
+// Standard library
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <math.h>
+
+// Windows specific
+#include <windows.h>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes
+#include "stb_image.h"
+#include "filecache.h"
+
+#define IBL_PI 3.14159265358979f
+
+static constexpr unsigned int IBL_CACHE_MAGIC = 0x4C424947; // "GIBL"
+static constexpr unsigned int IBL_CACHE_VERSION = 1;
+
+struct IBLCacheHeader {
+	unsigned int magic;
+	unsigned int version;
+	int prefilterSize;
+	int prefilterLevels;
+	int lutSize;
+};
+
+// One square level of a cube map, face-major then row
+struct CubeLevel {
+	int size;
+	std::vector<glm::vec3> texels;
+
+	glm::vec3& at(int face, int x, int y) { return texels[(face * size + y) * size + x]; }
+	const glm::vec3& at(int face, int x, int y) const { return texels[(face * size + y) * size + x]; }
+};
+
+// Direction through (u, v) in [-1, 1] on a face, following the GL cube map face orientation
+static glm::vec3 faceDirection(int face, float u, float v) {
+	switch (face) {
+		case 0: return glm::normalize(glm::vec3(1.0f, -v, -u));
+		case 1: return glm::normalize(glm::vec3(-1.0f, -v, u));
+		case 2: return glm::normalize(glm::vec3(u, 1.0f, v));
+		case 3: return glm::normalize(glm::vec3(u, -1.0f, -v));
+		case 4: return glm::normalize(glm::vec3(u, -v, 1.0f));
+		default: return glm::normalize(glm::vec3(-u, -v, -1.0f));
+	}
+}
+
+static void directionToFace(const glm::vec3& d, int& face, float& u, float& v) {
+	glm::vec3 a = glm::abs(d);
+	if (a.x >= a.y && a.x >= a.z) {
+		face = d.x > 0.0f ? 0 : 1;
+		u = (d.x > 0.0f ? -d.z : d.z) / a.x;
+		v = -d.y / a.x;
+	}
+	else if (a.y >= a.z) {
+		face = d.y > 0.0f ? 2 : 3;
+		u = d.x / a.y;
+		v = (d.y > 0.0f ? d.z : -d.z) / a.y;
+	}
+	else {
+		face = d.z > 0.0f ? 4 : 5;
+		u = (d.z > 0.0f ? d.x : -d.x) / a.z;
+		v = -d.y / a.z;
+	}
+}
+
+// Bilinear within the face, clamped at its edges
+static glm::vec3 sampleLevel(const CubeLevel& level, const glm::vec3& direction) {
+	int face;
+	float u, v;
+	directionToFace(direction, face, u, v);
+	float x = (u * 0.5f + 0.5f) * level.size - 0.5f;
+	float y = (v * 0.5f + 0.5f) * level.size - 0.5f;
+	x = glm::clamp(x, 0.0f, (float)(level.size - 1));
+	y = glm::clamp(y, 0.0f, (float)(level.size - 1));
+	int x0 = (int)x, y0 = (int)y;
+	int x1 = x0 + 1 < level.size ? x0 + 1 : x0;
+	int y1 = y0 + 1 < level.size ? y0 + 1 : y0;
+	float fx = x - x0, fy = y - y0;
+	glm::vec3 top = glm::mix(level.at(face, x0, y0), level.at(face, x1, y0), fx);
+	glm::vec3 bottom = glm::mix(level.at(face, x0, y1), level.at(face, x1, y1), fx);
+	return glm::mix(top, bottom, fy);
+}
+
+static glm::vec3 sampleChain(const std::vector<CubeLevel>& chain, const glm::vec3& direction, float mip) {
+	float maxMip = (float)(chain.size() - 1);
+	mip = glm::clamp(mip, 0.0f, maxMip);
+	int lower = (int)mip;
+	int upper = lower + 1 < (int)chain.size() ? lower + 1 : lower;
+	return glm::mix(sampleLevel(chain[lower], direction), sampleLevel(chain[upper], direction), mip - lower);
+}
+
+static CubeLevel downsample(const CubeLevel& level) {
+	CubeLevel half;
+	half.size = level.size / 2;
+	half.texels.resize(6 * half.size * half.size);
+	for (int face = 0; face < 6; face++) {
+		for (int y = 0; y < half.size; y++) {
+			for (int x = 0; x < half.size; x++) {
+				half.at(face, x, y) = (level.at(face, 2 * x, 2 * y) + level.at(face, 2 * x + 1, 2 * y) +
+					level.at(face, 2 * x, 2 * y + 1) + level.at(face, 2 * x + 1, 2 * y + 1)) * 0.25f;
+			}
+		}
+	}
+	return half;
+}
+
+static glm::vec2 hammersley(unsigned int i, unsigned int count) {
+	unsigned int bits = i;
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return glm::vec2((float)i / count, bits * 2.3283064365386963e-10f);
+}
+
+static glm::vec3 importanceSampleGGX(const glm::vec2& xi, const glm::vec3& N, float roughness) {
+	float a = roughness * roughness;
+	float phi = 2.0f * IBL_PI * xi.x;
+	float cosTheta = sqrtf((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+	float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+	glm::vec3 H = glm::vec3(cosf(phi) * sinTheta, sinf(phi) * sinTheta, cosTheta);
+
+	glm::vec3 up = fabsf(N.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 tangentX = glm::normalize(glm::cross(up, N));
+	glm::vec3 tangentY = glm::cross(N, tangentX);
+	return glm::normalize(tangentX * H.x + tangentY * H.y + N * H.z);
+}
+
+static float distributionGGX(float NdotH, float roughness) {
+	float a2 = roughness * roughness * roughness * roughness;
+	float d = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+	return a2 / (IBL_PI * d * d);
+}
+
+// Loads one face and resamples it to size x size
+static bool loadFace(const std::string& path, CubeLevel& level, int face) {
+	int width, height, nrComponents;
+	unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &nrComponents, 3);
+	if (!pixels) {
+		std::cout << "IBL: failed to load " << path << std::endl;
+		return false;
+	}
+	for (int y = 0; y < level.size; y++) {
+		for (int x = 0; x < level.size; x++) {
+			// Box filter the source texels covered by this texel
+			int x0 = x * width / level.size, x1 = (x + 1) * width / level.size;
+			int y0 = y * height / level.size, y1 = (y + 1) * height / level.size;
+			x1 = x1 > x0 ? x1 : x0 + 1;
+			y1 = y1 > y0 ? y1 : y0 + 1;
+			glm::vec3 sum = glm::vec3(0.0f, 0.0f, 0.0f);
+			for (int sy = y0; sy < y1; sy++) {
+				for (int sx = x0; sx < x1; sx++) {
+					const unsigned char* p = pixels + 3 * (sy * width + sx);
+					sum += glm::vec3(p[0], p[1], p[2]);
+				}
+			}
+			level.at(face, x, y) = sum / (255.0f * (x1 - x0) * (y1 - y0));
+		}
+	}
+	stbi_image_free(pixels);
+	return true;
+}
+
+bool ImageBasedLighting::compute(const std::vector<std::string>& faces, ThreadPool* threadPool, IBLData& data) {
+	if (faces.size() != 6) {
+		return false;
+	}
+
+	// Source chain, SOURCE_SIZE down to 1x1, used for filtered importance sampling
+	std::vector<CubeLevel> chain(1);
+	chain[0].size = SOURCE_SIZE;
+	chain[0].texels.resize(6 * SOURCE_SIZE * SOURCE_SIZE);
+	bool loaded[6];
+	threadPool->parallelFor(6, [&](int begin, int end) {
+		for (int face = begin; face < end; face++) {
+			loaded[face] = loadFace(faces[face], chain[0], face);
+		}
+	});
+	for (int face = 0; face < 6; face++) {
+		if (!loaded[face]) {
+			return false;
+		}
+	}
+	while (chain.back().size > 1) {
+		chain.push_back(downsample(chain.back()));
+	}
+
+	// SH9 projection, one partial sum per row, weighted by each texel's solid angle
+	const CubeLevel& shLevel = chain[2];
+	int rows = 6 * shLevel.size;
+	std::vector<glm::vec3> rowSums(rows * 9, glm::vec3(0.0f, 0.0f, 0.0f));
+	std::vector<float> rowWeights(rows, 0.0f);
+	threadPool->parallelFor(rows, [&](int begin, int end) {
+		for (int row = begin; row < end; row++) {
+			int face = row / shLevel.size;
+			int y = row % shLevel.size;
+			for (int x = 0; x < shLevel.size; x++) {
+				float u = 2.0f * (x + 0.5f) / shLevel.size - 1.0f;
+				float v = 2.0f * (y + 0.5f) / shLevel.size - 1.0f;
+				float solidAngle = 1.0f / powf(1.0f + u * u + v * v, 1.5f);
+				glm::vec3 n = faceDirection(face, u, v);
+				glm::vec3 radiance = shLevel.at(face, x, y) * solidAngle;
+
+				float basis[9] = {
+					0.282095f,
+					0.488603f * n.y, 0.488603f * n.z, 0.488603f * n.x,
+					1.092548f * n.x * n.y, 1.092548f * n.y * n.z, 0.315392f * (3.0f * n.z * n.z - 1.0f),
+					1.092548f * n.x * n.z, 0.546274f * (n.x * n.x - n.y * n.y)
+				};
+				for (int i = 0; i < 9; i++) {
+					rowSums[row * 9 + i] += radiance * basis[i];
+				}
+				rowWeights[row] += solidAngle;
+			}
+		}
+	});
+
+	float totalWeight = 0.0f;
+	for (int i = 0; i < 9; i++) {
+		data.sh[i] = glm::vec3(0.0f, 0.0f, 0.0f);
+	}
+	for (int row = 0; row < rows; row++) {
+		for (int i = 0; i < 9; i++) {
+			data.sh[i] += rowSums[row * 9 + i];
+		}
+		totalWeight += rowWeights[row];
+	}
+	// Normalise the solid angles to 4 pi, then cosine lobe convolution (pi, 2pi/3, pi/4) divided by pi
+	const float bandScale[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	for (int i = 0; i < 9; i++) {
+		data.sh[i] *= 4.0f * IBL_PI / totalWeight * bandScale[i];
+	}
+
+	// GGX prefiltered levels
+	data.prefilterSize = PREFILTER_SIZE;
+	data.prefilterLevels = PREFILTER_LEVELS;
+	data.prefiltered.clear();
+	float texelSolidAngle = 4.0f * IBL_PI / (6.0f * SOURCE_SIZE * SOURCE_SIZE);
+	for (int level = 0; level < PREFILTER_LEVELS; level++) {
+		int size = PREFILTER_SIZE >> level;
+		float roughness = (float)level / (PREFILTER_LEVELS - 1);
+		size_t levelStart = data.prefiltered.size();
+		data.prefiltered.resize(levelStart + 6 * size * size);
+
+		threadPool->parallelFor(6 * size, [&](int begin, int end) {
+			for (int row = begin; row < end; row++) {
+				int face = row / size;
+				int y = row % size;
+				for (int x = 0; x < size; x++) {
+					glm::vec3 N = faceDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f);
+					glm::vec3& result = data.prefiltered[levelStart + (face * size + y) * size + x];
+
+					// Mirror level, the source resampled to this size
+					if (level == 0) {
+						result = sampleChain(chain, N, log2f((float)SOURCE_SIZE / size));
+						continue;
+					}
+
+					// N = V = R approximation; the source mip per sample follows the sample's pdf so few samples don't alias
+					glm::vec3 sum = glm::vec3(0.0f, 0.0f, 0.0f);
+					float weight = 0.0f;
+					for (int i = 0; i < PREFILTER_SAMPLES; i++) {
+						glm::vec3 H = importanceSampleGGX(hammersley(i, PREFILTER_SAMPLES), N, roughness);
+						glm::vec3 L = 2.0f * glm::dot(N, H) * H - N;
+						float NdotL = glm::dot(N, L);
+						if (NdotL <= 0.0f) {
+							continue;
+						}
+						float NdotH = glm::max(glm::dot(N, H), 0.0f);
+						float pdf = distributionGGX(NdotH, roughness) * 0.25f;
+						float sampleSolidAngle = 1.0f / (PREFILTER_SAMPLES * pdf + 0.0001f);
+						float mip = 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f;
+						sum += sampleChain(chain, L, mip) * NdotL;
+						weight += NdotL;
+					}
+					result = weight > 0.0f ? sum / weight : sampleLevel(chain.back(), N);
+				}
+			}
+		});
+	}
+
+	// Split-sum BRDF integration
+	data.lutSize = LUT_SIZE;
+	data.brdfLUT.resize(LUT_SIZE * LUT_SIZE);
+	threadPool->parallelFor(LUT_SIZE, [&](int begin, int end) {
+		for (int y = begin; y < end; y++) {
+			float roughness = (y + 0.5f) / LUT_SIZE;
+			float k = roughness * roughness * 0.5f;
+			for (int x = 0; x < LUT_SIZE; x++) {
+				float NdotV = (x + 0.5f) / LUT_SIZE;
+				glm::vec3 V = glm::vec3(sqrtf(1.0f - NdotV * NdotV), 0.0f, NdotV);
+				glm::vec3 N = glm::vec3(0.0f, 0.0f, 1.0f);
+				float scale = 0.0f, bias = 0.0f;
+				for (int i = 0; i < LUT_SAMPLES; i++) {
+					glm::vec3 H = importanceSampleGGX(hammersley(i, LUT_SAMPLES), N, roughness);
+					glm::vec3 L = 2.0f * glm::dot(V, H) * H - V;
+					float NdotL = glm::max(L.z, 0.0f);
+					float NdotH = glm::max(H.z, 0.0f);
+					float VdotH = glm::max(glm::dot(V, H), 0.0f);
+					if (NdotL <= 0.0f) {
+						continue;
+					}
+					float G = (NdotV / (NdotV * (1.0f - k) + k)) * (NdotL / (NdotL * (1.0f - k) + k));
+					float visibility = G * VdotH / (NdotH * NdotV);
+					float fresnel = powf(1.0f - VdotH, 5.0f);
+					scale += (1.0f - fresnel) * visibility;
+					bias += fresnel * visibility;
+				}
+				data.brdfLUT[y * LUT_SIZE + x] = glm::vec2(scale, bias) / (float)LUT_SAMPLES;
+			}
+		}
+	});
+	return true;
+}
+
+std::string ImageBasedLighting::getCachePath(const std::vector<std::string>& faces) {
+	// Face files plus the precompute settings, changing either recomputes
+	int settings[6] = { SOURCE_SIZE, PREFILTER_SIZE, PREFILTER_LEVELS, PREFILTER_SAMPLES, LUT_SIZE, LUT_SAMPLES };
+	unsigned long long key = hashBytes(settings, sizeof(settings), hashFiles(faces));
+
+	char name[64];
+	snprintf(name, sizeof(name), "iblcache/%016llx.bin", key);
+	return name;
+}
+
+bool ImageBasedLighting::loadCache(const std::string& path, IBLData& data) {
+	FILE* fp;
+	fopen_s(&fp, path.c_str(), "rb");
+	if (fp == NULL) {
+		return false;
+	}
+
+	IBLCacheHeader header;
+	bool valid = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == IBL_CACHE_MAGIC &&
+		header.version == IBL_CACHE_VERSION && header.prefilterSize == PREFILTER_SIZE &&
+		header.prefilterLevels == PREFILTER_LEVELS && header.lutSize == LUT_SIZE;
+	if (valid) {
+		data.prefilterSize = header.prefilterSize;
+		data.prefilterLevels = header.prefilterLevels;
+		data.lutSize = header.lutSize;
+		size_t texelCount = 0;
+		for (int level = 0; level < header.prefilterLevels; level++) {
+			int size = header.prefilterSize >> level;
+			texelCount += 6 * size * size;
+		}
+		data.prefiltered.resize(texelCount);
+		data.brdfLUT.resize(header.lutSize * header.lutSize);
+		valid = fread(data.sh, sizeof(data.sh), 1, fp) == 1 &&
+			fread(&data.prefiltered[0], sizeof(glm::vec3), texelCount, fp) == texelCount &&
+			fread(&data.brdfLUT[0], sizeof(glm::vec2), data.brdfLUT.size(), fp) == data.brdfLUT.size();
+	}
+	fclose(fp);
+	return valid;
+}
+
+void ImageBasedLighting::saveCache(const std::string& path, const IBLData& data) {
+	CreateDirectoryA("iblcache", NULL);
+	FILE* fp;
+	fopen_s(&fp, path.c_str(), "wb");
+	if (fp == NULL) {
+		std::cerr << "Could not write IBL cache " << path << std::endl;
+		return;
+	}
+	IBLCacheHeader header;
+	header.magic = IBL_CACHE_MAGIC;
+	header.version = IBL_CACHE_VERSION;
+	header.prefilterSize = data.prefilterSize;
+	header.prefilterLevels = data.prefilterLevels;
+	header.lutSize = data.lutSize;
+	fwrite(&header, sizeof(header), 1, fp);
+	fwrite(data.sh, sizeof(data.sh), 1, fp);
+	fwrite(&data.prefiltered[0], sizeof(glm::vec3), data.prefiltered.size(), fp);
+	fwrite(&data.brdfLUT[0], sizeof(glm::vec2), data.brdfLUT.size(), fp);
+	fclose(fp);
+}
+
+ImageBasedLighting::ImageBasedLighting(const std::vector<std::string>& faces, ThreadPool* threadPool) {
+	this->prefilteredMap = 0;
+	this->brdfLUT = 0;
+	this->loadedFromCache = false;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::string cachePath = getCachePath(faces);
+	valid = loadCache(cachePath, data);
+	loadedFromCache = valid;
+	if (!valid) {
+		valid = compute(faces, threadPool, data);
+		if (valid) {
+			saveCache(cachePath, data);
+		}
+	}
+	setupMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "IBL " << (loadedFromCache ? "loaded from cache" : "precomputed") << " in " << setupMilliseconds << " ms" << std::endl;
+
+	if (valid) {
+		upload();
+	}
+}
+
+ImageBasedLighting::~ImageBasedLighting() {
+	GLuint textures[2] = { prefilteredMap, brdfLUT };
+	glDeleteTextures(2, textures);
+}
+
+void ImageBasedLighting::upload() {
+	glGenTextures(1, &prefilteredMap);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, prefilteredMap);
+	glTexStorage2D(GL_TEXTURE_CUBE_MAP, data.prefilterLevels, GL_RGB16F, data.prefilterSize, data.prefilterSize);
+	size_t offset = 0;
+	for (int level = 0; level < data.prefilterLevels; level++) {
+		int size = data.prefilterSize >> level;
+		for (int face = 0; face < 6; face++) {
+			glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, size, size, GL_RGB, GL_FLOAT, &data.prefiltered[offset]);
+			offset += size * size;
+		}
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	// Rough levels are tiny, filtering across face edges hides the seams
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	glGenTextures(1, &brdfLUT);
+	glBindTexture(GL_TEXTURE_2D, brdfLUT);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, data.lutSize, data.lutSize);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, data.lutSize, data.lutSize, GL_RG, GL_FLOAT, &data.brdfLUT[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void ImageBasedLighting::bind(Shader* shader) {
+	glActiveTexture(GL_TEXTURE0 + PREFILTERED_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, prefilteredMap);
+	glActiveTexture(GL_TEXTURE0 + BRDF_LUT_UNIT);
+	glBindTexture(GL_TEXTURE_2D, brdfLUT);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniform3fv(glGetUniformLocation(shader->ID, "shIrradiance"), 9, glm::value_ptr(data.sh[0]));
+	shader->setFloat("prefilteredMaxLod", (float)(data.prefilterLevels - 1));
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "threadpool.h"
+
+// Everything the IBL precompute produces. Plain CPU data, so it can be computed and checked without a GL context
+struct IBLData {
+	// Irradiance as 9 SH coefficients, already convolved with the cosine lobe and divided by pi,
+	// so the shader multiplies the evaluated sum straight with the albedo
+	glm::vec3 sh[9];
+
+	// GGX prefiltered radiance, level-major then face then row, roughness = level / (levels - 1)
+	int prefilterSize;
+	int prefilterLevels;
+	std::vector<glm::vec3> prefiltered;
+
+	// Split-sum BRDF, x = N.V, y = roughness, stores (scale, bias) for F0
+	int lutSize;
+	std::vector<glm::vec2> brdfLUT;
+};
+
+// Image based lighting from the skybox faces: SH9 diffuse irradiance, a GGX prefiltered specular mip
+// chain and the split-sum BRDF LUT. Computed once on the thread pool and cached on disk, keyed by the
+// face files, then uploaded for the shaders
+class ImageBasedLighting {
+public:
+	static constexpr GLuint PREFILTERED_UNIT = 8;
+	static constexpr GLuint BRDF_LUT_UNIT = 9;
+
+	static constexpr int SOURCE_SIZE = 256;
+	static constexpr int PREFILTER_SIZE = 128;
+	static constexpr int PREFILTER_LEVELS = 6;
+	static constexpr int PREFILTER_SAMPLES = 64;
+	static constexpr int LUT_SIZE = 64;
+	static constexpr int LUT_SAMPLES = 256;
+
+	ImageBasedLighting(const std::vector<std::string>& faces, ThreadPool* threadPool);
+	~ImageBasedLighting();
+
+	void bind(Shader* shader);
+
+	bool isValid() const { return valid; }
+	bool wasLoadedFromCache() const { return loadedFromCache; }
+	double getSetupMilliseconds() const { return setupMilliseconds; }
+	const IBLData& getData() const { return data; }
+
+	// CPU only entry points
+	static bool compute(const std::vector<std::string>& faces, ThreadPool* threadPool, IBLData& data);
+	static std::string getCachePath(const std::vector<std::string>& faces);
+	static bool loadCache(const std::string& path, IBLData& data);
+	static void saveCache(const std::string& path, const IBLData& data);
+
+private:
+	IBLData data;
+	bool valid;
+	bool loadedFromCache;
+	double setupMilliseconds;
+
+	GLuint prefilteredMap;
+	GLuint brdfLUT;
+
+	void upload();
+};
@@ -5,6 +5,10 @@
 #include <vector>
 #include <iostream>
 #include <limits>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <unordered_set>
 #include <math.h>
 
 namespace std {
@@ -37,13 +41,58 @@ namespace std {
 #include "model.h"
 #include "directionallight.h"
 #include "skybox.h"
+#include "meshbuffer.h"
+#include "streambuffer.h"
+#include "allocator.h"
+#include "materiallibrary.h"
+#include "shaderwatcher.h"
+#include "shadervariants.h"
+#include "threadpool.h"
+#include "clusteredlighting.h"
+#include "shadowmap.h"
+#include "frustum.h"
+#include "gbuffer.h"
+#include "gputimer.h"
+#include "ibl.h"
+#include "scenetarget.h"
+#include "ssao.h"
+#include "postprocess.h"
+#include "taa.h"
+#include "profiler.h"
+#include "benchmarkscene.h"
+#include "virtualtexture.h"
+#include "texturestreamer.h"
 
 #include "imgui.h"
 #include "imgui_impl_glut.h"
 #include "imgui_impl_opengl3.h"
 
 #define CAMERASPEED 50.0f
-
+#define NEAR_PLANE 0.1f
+#define FAR_PLANE 1000.0f
+#define BENCHMARK_MESH_COUNT 10000
+#define BENCHMARK_FRAMES 100
+#define BENCHMARK_MATERIAL_COUNT 1000
+#define SHADOW_MAP_SIZE 2048
+#define OVERDRAW_LAYERS 24
+#define TAA_SUPERSAMPLE 4
+#define TAA_CONVERGE_FRAMES 32
+// Bytes of per-frame data (draw lists, transforms) each frame can stream, three frames are in flight
+#define STREAM_FRAME_SIZE (16 << 20)
+// Scratch memory for one frame's transient containers
+#define FRAME_ARENA_SIZE (1 << 20)
+// The virtual texture page cache is this many pages on a side, 30 x 136 texels is just under 4K
+#define VIRTUAL_TEXTURE_CACHE_SLOTS 30
+#define VIRTUAL_TEXTURE_SIMULATION_FRAMES 2000
+// Video memory the streamed material textures may use, in MB
+#define TEXTURE_STREAMING_BUDGET 64
+#define STREAMING_FRAMES 300
+
+
+enum RenderPath {
+	RENDER_FORWARD = 0,
+	RENDER_DEFERRED = 1
+};
 
 typedef struct
 {
@@ -60,7 +109,7 @@ int height = 600;
 
 // Root of the Hierarchy
 glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0, 0.0, -10.0f));
-glm::mat4 persp_proj = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 1000.0f);
+glm::mat4 persp_proj = glm::perspective(glm::radians(45.0f), (float)width / (float)height, NEAR_PLANE, FAR_PLANE);
 
 float delta;
 float yaw, pitch;
@@ -70,21 +119,74 @@ bool firstMouse = true;
 
 Shader* shader = nullptr;
 Shader* skyboxShader = nullptr;
+ShaderVariants* sceneVariants = nullptr;
+MeshBuffer* meshBuffer = nullptr;
+StreamBuffer* streamBuffer = nullptr;
+FrameArena* frameArena = nullptr;
+// Instances of the scene benchmark, which can number in the thousands
+Pool<Model> instancePool;
+// Heap allocations made by the last display(), the goal is zero in steady state
+size_t frameAllocations = 0;
+MaterialLibrary* materialLibrary = nullptr;
+ShaderWatcher* shaderWatcher = nullptr;
+ThreadPool* threadPool = nullptr;
+ClusteredLighting* clusteredLighting = nullptr;
+CascadedShadowMap* shadowMap = nullptr;
+Shader* shadowDepthShader = nullptr;
+Shader* depthShader = nullptr;
+Shader* overdrawShader = nullptr;
+GpuQuery* fragmentQuery = nullptr;
+GBuffer* gbuffer = nullptr;
+ShaderVariants* gbufferVariants = nullptr;
+ShaderVariants* deferredVariants = nullptr;
+Profiler* profiler = nullptr;
+ImageBasedLighting* ibl = nullptr;
+SceneTarget* sceneTarget = nullptr;
+ScreenSpaceAmbientOcclusion* ssao = nullptr;
+PostProcessChain* postProcess = nullptr;
+TemporalAntiAliasing* taa = nullptr;
 DirectionalLight* lightSource = nullptr;
+VirtualTextureSystem* virtualTextures = nullptr;
+TextureStreamer* textureStreamer = nullptr;
 std::vector<Model*> teapots;
 std::vector<Model*> cubes;
+std::vector<Model*> overdrawStack;
+// Instances of a --bench-scene stress scene, shape 3
+std::vector<Model*> sceneModels;
 Skybox* skybox = nullptr;
 
 bool showGUI = false;
+bool showProfiler = false;
 
 float eta = 0.5;
 float chromatic = 0.0;
 bool rotating = false;
+bool multiDrawIndirect = true;
+static int renderPath = RENDER_FORWARD;
+bool depthPrepass = false;
+bool frontToBack = false;
+bool overdrawView = false;
+static int lightingModel = LIGHTING_BLINN_PHONG;
+float roughness = 0.5f;
+bool clusteredLights = false;
+int lightCount = 256;
+bool shadows = true;
+bool imageBasedLighting = true;
+bool ambientOcclusion = true;
+bool temporalAA = true;
+// Only takes effect once --virtual-texture has given the materials a virtual texture
+bool virtualTexturing = false;
+int textureBudget = TEXTURE_STREAMING_BUDGET;
+bool dayCycle = false;
+int visibleModels = 0;
 static int shape = 0;
 float normal = 1;
 
 float lightPos[3] = { 10.0f, 10.0f, 4.0f };
 
+// The models sit around here, the sun's shadow direction points at it
+glm::vec3 sceneCenter = glm::vec3(0.0f, 0.0f, -20.0f);
+
 // Material selection
 static int currentMaterial = 0;
 static int previousMaterial = -1;
@@ -96,28 +198,76 @@ struct MaterialTextures {
 };
 MaterialTextures materialTextures[3]; // brick, wicker, fabric
 
-// Forward declaration - defined in model.cpp
-unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false);
+// Same three materials as entries in the material library, used by the indirect path
+GLuint materialIds[3];
+
+// Scatters point and spot lights around the models, seeded so every run sees the same lights
+void generateLights(int count) {
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	clusteredLighting->lights.resize(count);
+	for (Light& light : clusteredLighting->lights) {
+		glm::vec3 position = glm::vec3(-40.0f + 80.0f * unit(random), -8.0f + 20.0f * unit(random), -60.0f + 50.0f * unit(random));
+		light.positionRadius = glm::vec4(position, 3.0f + 6.0f * unit(random));
+		light.color = glm::vec4(unit(random), unit(random), unit(random), 20.0f + 40.0f * unit(random));
+
+		// Every fourth light is a spot light pointing down
+		if (unit(random) < 0.25f) {
+			light.spotDirection = glm::vec4(0.0f, -1.0f, 0.0f, cos(glm::radians(20.0f + 25.0f * unit(random))));
+		}
+		else {
+			light.spotDirection = glm::vec4(0.0f, -1.0f, 0.0f, -1.0f);
+		}
+	}
+}
+
+// Orbits the lights around the middle of the scene so the binning has to be redone every frame
+void animateLights(float deltaTime) {
+	glm::mat4 orbit = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -20.0f)) *
+		glm::rotate(glm::mat4(1.0f), glm::radians(10.0f * deltaTime), glm::vec3(0.0f, 1.0f, 0.0f)) *
+		glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 20.0f));
+	for (Light& light : clusteredLighting->lights) {
+		glm::vec3 position = glm::vec3(orbit * glm::vec4(glm::vec3(light.positionRadius), 1.0f));
+		light.positionRadius = glm::vec4(position, light.positionRadius.w);
+	}
+}
+
+// Models of the shape picked in the GUI
+std::vector<Model*>& getShapeModels() {
+	switch (shape) {
+		case 1: return cubes;
+		case 2: return overdrawStack;
+		case 3: return sceneModels;
+		default: return teapots;
+	}
+}
 
-// Function to update textures on all models
+// Function to update textures on all models, on the Mesh::Draw textures and on the library entries the indirect path reads
 void updateModelTextures(int materialIndex) {
-	std::vector<std::vector<Model*>*> allModels = { &cubes, &teapots };
+	std::vector<Model*>* registered[3] = { &teapots, &cubes, &overdrawStack };
+	for (auto* modelList : registered) {
+		for (Model* model : *modelList) {
+			for (GLuint id : model->libraryMaterials) {
+				materialLibrary->setTextures(id, materialIds[materialIndex]);
+			}
+		}
+	}
+
+	std::vector<Model*>* allModels[2] = { &cubes, &teapots };
 	
 	for (auto* modelList : allModels) {
 		for (Model* model : *modelList) {
 			for (Mesh& mesh : model->meshes) {
-				// Clear existing textures and add the new ones
-				mesh.textures.clear();
-				
-				Texture diffuseTex;
-				diffuseTex.id = materialTextures[materialIndex].diffuse;
-				diffuseTex.type = "texture_diffuse";
-				mesh.textures.push_back(diffuseTex);
-				
-				Texture normalTex;
-				normalTex.id = materialTextures[materialIndex].normal;
-				normalTex.type = "texture_normal";
-				mesh.textures.push_back(normalTex);
+				// Only the first time does the vector need rebuilding, after that the ids are swapped in place
+				if (mesh.textures.size() != 2 || mesh.textures[0].slot != TEXTURE_DIFFUSE || mesh.textures[1].slot != TEXTURE_NORMAL) {
+					mesh.textures.resize(2);
+					mesh.textures[0].slot = TEXTURE_DIFFUSE;
+					mesh.textures[1].slot = TEXTURE_NORMAL;
+				}
+				mesh.textures[0].id = materialTextures[materialIndex].diffuse;
+				mesh.textures[1].id = materialTextures[materialIndex].normal;
+				mesh.resolveBindings();
 			}
 		}
 	}
@@ -203,7 +353,7 @@ void reshape(int x, int y) {
 	width = x;
 	height = y;
 	glViewport(0, 0, x, y);
-	persp_proj = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 1000.0f);
+	persp_proj = glm::perspective(glm::radians(45.0f), (float)width / (float)height, NEAR_PLANE, FAR_PLANE);
 
 	ImGui_ImplGLUT_ReshapeFunc(x, y);
 }
@@ -212,6 +362,7 @@ void reshape(int x, int y) {
 
 
 void renderGUI() {
+	ProfileScope scope(profiler, "GUI");
 	ImGuiIO& io = ImGui::GetIO();
 	io.DisplaySize = ImVec2((float)width, (float)height);
 
@@ -225,12 +376,126 @@ void renderGUI() {
 		if (ImGui::CollapsingHeader("Object Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
 			ImGui::Checkbox("Rotate", &rotating);
 
-			const char* items[] = { "Teapot", "Cube" };
+			const char* items[] = { "Teapot", "Cube", "Overdraw stack" };
 			ImGui::Combo("Shape", &shape, items, IM_ARRAYSIZE(items));
 
 			ImGui::DragFloat("Intensity", &normal, 0.1f, 0.0f, 10.0f);
+			ImGui::Checkbox("Multi-draw indirect", &multiDrawIndirect);
+			if (multiDrawIndirect) {
+				const char* paths[] = { "Forward", "Deferred" };
+				ImGui::Combo("Renderer", &renderPath, paths, IM_ARRAYSIZE(paths));
+			}
+			if (multiDrawIndirect) {
+				ImGui::Checkbox("Depth pre-pass", &depthPrepass);
+				ImGui::Checkbox("Front-to-back sort", &frontToBack);
+				ImGui::Checkbox("Overdraw view", &overdrawView);
+			}
+			ImGui::Checkbox("Profiler", &showProfiler);
+			ImGui::Text("Scene: %.3f ms GPU", profiler->getGpuMilliseconds("Scene"));
+			ImGui::Text("Shaded fragments: %llu (%.2f per pixel)", (unsigned long long)fragmentQuery->getResult(),
+				(double)fragmentQuery->getResult() / ((double)width * height));
+			ImGui::Text("Streamed: %.1f KB/frame (peak %.1f of %.0f KB), fence wait %.3f ms%s", streamBuffer->getFrameBytes() / 1024.0,
+				streamBuffer->getPeakFrameBytes() / 1024.0, streamBuffer->getFrameSize() / 1024.0, streamBuffer->getFenceWaitMilliseconds(),
+				streamBuffer->isPersistent() ? "" : " (not mapped)");
+			if (streamBuffer->getOverflows() > 0) {
+				ImGui::Text("Stream overflows: %d", streamBuffer->getOverflows());
+			}
+			ImGui::Text("Heap allocations: %llu last frame, frame arena peak %.1f of %.0f KB", (unsigned long long)frameAllocations,
+				frameArena->getPeak() / 1024.0, frameArena->getCapacity() / 1024.0);
+			if (frameArena->getOverflows() > 0) {
+				ImGui::Text("Frame arena overflows: %d", frameArena->getOverflows());
+			}
+			if (!multiDrawIndirect) {
+				if (ImGui::SliderInt("Texture budget (MB)", &textureBudget, 1, 256)) {
+					textureStreamer->setBudget((size_t)textureBudget << 20);
+				}
+				ImGui::Text("Textures: %.1f of %.1f MB resident, %d loading, %.1f MB uploaded, %llu evictions",
+					textureStreamer->getResidentBytes() / (1024.0 * 1024.0), textureStreamer->getFullBytes() / (1024.0 * 1024.0),
+					textureStreamer->getPendingLoads(), textureStreamer->getUploadedBytes() / (1024.0 * 1024.0), textureStreamer->getEvictions());
+				ImGui::Text("Diffuse mip %d (wants %d)", textureStreamer->getResidentMip(materialTextures[currentMaterial].diffuse),
+					textureStreamer->getWantedMip(materialTextures[currentMaterial].diffuse));
+			}
+		}
+
+		if (multiDrawIndirect && ImGui::CollapsingHeader("Lighting", ImGuiTreeNodeFlags_DefaultOpen)) {
+			const char* models[] = { "Blinn-Phong", "Gooch", "Oren-Nayar", "Reflectance", "GGX" };
+			if (renderPath == RENDER_DEFERRED) {
+				ImGui::Text("Deferred lighting is Blinn-Phong only");
+			}
+			else {
+				ImGui::Combo("Lighting Model", &lightingModel, models, IM_ARRAYSIZE(models));
+			}
+
+			if (lightingModel == LIGHTING_OREN_NAYAR) {
+				ImGui::SliderFloat("Roughness", &roughness, 0.0f, 1.0f);
+			}
+			if (lightingModel == LIGHTING_REFLECTANCE) {
+				ImGui::SliderFloat("Eta", &eta, 0.0f, 1.0f);
+				ImGui::SliderFloat("Chromatic", &chromatic, 0.0f, 1.0f);
+			}
+			if (ImGui::Checkbox("Day cycle", &dayCycle)) {
+				lightSource->dayCycle = dayCycle;
+			}
+			ImGui::Text("Skybox %s in %.1f ms", skybox->wasLoadedFromCache() ? "loaded from cache" : "decoded", skybox->getLoadMilliseconds());
+			ImGui::Checkbox("Image based lighting", &imageBasedLighting);
+			if (imageBasedLighting) {
+				ImGui::Text("IBL %s in %.1f ms", ibl->wasLoadedFromCache() ? "loaded from cache" : "precomputed", ibl->getSetupMilliseconds());
+			}
+			ImGui::Checkbox("Ambient occlusion", &ambientOcclusion);
+			if (ambientOcclusion) {
+				const char* presets[ScreenSpaceAmbientOcclusion::PRESET_COUNT];
+				for (int i = 0; i < ScreenSpaceAmbientOcclusion::PRESET_COUNT; i++) {
+					presets[i] = ScreenSpaceAmbientOcclusion::presets[i].name;
+				}
+				ImGui::Combo("AO preset", &ssao->preset, presets, ScreenSpaceAmbientOcclusion::PRESET_COUNT);
+				ImGui::SliderFloat("AO intensity", &ssao->intensity, 0.0f, 4.0f);
+				ImGui::Text("AO: %.3f ms occlusion, %.3f ms temporal, %.3f ms upsample", ssao->getOcclusionMilliseconds(),
+					ssao->getTemporalMilliseconds(), ssao->getUpsampleMilliseconds());
+			}
+			ImGui::Checkbox("Temporal anti-aliasing", &temporalAA);
+			if (temporalAA) {
+				ImGui::SliderFloat("TAA feedback", &taa->feedback, 0.5f, 0.98f);
+				ImGui::Text("TAA: %.3f ms velocity, %.3f ms resolve", taa->getVelocityMilliseconds(), taa->getResolveMilliseconds());
+			}
+			ImGui::Checkbox("Shadows", &shadows);
+			if (shadows) {
+				ImGui::SliderFloat("Shadow distance", &shadowMap->shadowDistance, 10.0f, FAR_PLANE);
+				ImGui::SliderFloat("Split lambda", &shadowMap->splitLambda, 0.0f, 1.0f);
+				for (int i = 0; i < shadowMap->getCascadeCount(); i++) {
+					const CascadedShadowMap::CascadeStats& stats = shadowMap->getStats(i);
+					ImGui::Text("Cascade %d: to %.1f, %d drawn, %d culled", i, shadowMap->getSplit(i), stats.drawn, stats.culled);
+				}
+				ImGui::Text("Shadow pass: %.3f ms CPU, %.3f ms GPU", shadowMap->getCpuMilliseconds(), shadowMap->getGpuMilliseconds());
+			}
+			ImGui::Text("Visible models: %d", visibleModels);
+			ImGui::Checkbox("Clustered lights", &clusteredLights);
+			if (clusteredLights) {
+				if (ImGui::SliderInt("Light count", &lightCount, 0, 8192)) {
+					generateLights(lightCount);
+				}
+				ImGui::Text("Binning: %.3f ms, %d light indices", clusteredLighting->getBinningMilliseconds(), (int)clusteredLighting->getLightIndexCount());
+			}
+			ImGui::Text("Shader variants: %d (%.1f ms to build)", (int)sceneVariants->getVariantCount(), sceneVariants->getCompileMilliseconds());
 		}
 		
+		if (ImGui::CollapsingHeader("Post processing")) {
+			for (int pass = 0; pass < POST_PASS_COUNT; pass++) {
+				ImGui::Checkbox(PostProcessChain::getPassName(pass), &postProcess->enabled[pass]);
+				ImGui::SameLine();
+				ImGui::Text("%.3f ms", postProcess->enabled[pass] ? postProcess->getPassMilliseconds(pass) : 0.0);
+			}
+			if (postProcess->enabled[POST_BLOOM]) {
+				ImGui::SliderFloat("Bloom threshold", &postProcess->bloomThreshold, 0.0f, 4.0f);
+				ImGui::SliderFloat("Bloom intensity", &postProcess->bloomIntensity, 0.0f, 2.0f);
+			}
+			ImGui::SliderFloat("Exposure compensation", &postProcess->exposureCompensation, -4.0f, 4.0f);
+			if (!postProcess->enabled[POST_AUTO_EXPOSURE]) {
+				ImGui::SliderFloat("Exposure", &postProcess->manualExposure, 0.0f, 8.0f);
+			}
+			const char* operators[] = { "ACES", "Filmic" };
+			ImGui::Combo("Tone map", &postProcess->toneMapOperator, operators, IM_ARRAYSIZE(operators));
+		}
+
 		if (ImGui::CollapsingHeader("Material Selection", ImGuiTreeNodeFlags_DefaultOpen)) {
 			const char* materials[] = { "Brick", "Wicker", "Fabric" };
 			ImGui::Combo("Material", &currentMaterial, materials, IM_ARRAYSIZE(materials));
@@ -240,9 +505,41 @@ void renderGUI() {
 				updateModelTextures(currentMaterial);
 				previousMaterial = currentMaterial;
 			}
+
+			// Edits the first material of the shape, one table entry shared by every copy of the model. The SSBO
+			// is only uploaded again when a widget changed it
+			std::vector<Model*>& shapeModels = getShapeModels();
+			if (multiDrawIndirect && lightingModel == LIGHTING_GGX && !shapeModels.empty()) {
+				Model* selected = shapeModels[0];
+				GLuint id = selected->libraryMaterial != Model::NO_LIBRARY_MATERIAL ? selected->libraryMaterial :
+					!selected->libraryMaterials.empty() ? selected->libraryMaterials[0] : materialIds[currentMaterial];
+				MaterialData data = materialLibrary->getMaterial(id);
+				bool changed = ImGui::ColorEdit3("Base color", &data.Kd.x);
+				changed |= ImGui::SliderFloat("Metallic", &data.Kd.w, 0.0f, 1.0f);
+				changed |= ImGui::SliderFloat("Material roughness", &data.emissive.w, 0.0f, 1.0f);
+				changed |= ImGui::SliderFloat("Occlusion", &data.Ka.w, 0.0f, 1.0f);
+				changed |= ImGui::ColorEdit3("Emissive", &data.emissive.x);
+				if (changed) {
+					materialLibrary->setMaterialData(id, data);
+				}
+			}
+
+			if (multiDrawIndirect && virtualTextures->getTextureCount() > 0) {
+				ImGui::Checkbox("Virtual texturing", &virtualTexturing);
+				const PageCache& cache = virtualTextures->getCache();
+				unsigned long long lookups = cache.getHits() + cache.getMisses();
+				ImGui::Text("Pages: %d of %d resident, %d requested, %d reading, %d uploaded", cache.getResidentCount(), cache.getSlotCount(),
+					virtualTextures->getRequestedPages(), virtualTextures->getPendingReads(), virtualTextures->getUploadsLastFrame());
+				ImGui::Text("Hit rate %.1f%%, %llu evictions", lookups > 0 ? 100.0 * cache.getHits() / lookups : 100.0, cache.getEvictions());
+				ImGui::Text("%.0f MB of pages in a %.0f MB cache", virtualTextures->getVirtualBytes() / (1024.0 * 1024.0),
+					virtualTextures->getCacheBytes() / (1024.0 * 1024.0));
+			}
 		}
 		ImGui::End();
 	}
+	if (showProfiler) {
+		profiler->drawOverlay(&showProfiler);
+	}
 
 	ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -259,11 +556,173 @@ void printMatrix(const glm::mat4& matrix, const std::string& name) {
 	}
 }
 
-void display() {
-	glEnable(GL_DEPTH_TEST);
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// Cheapest variant for the current settings: the normal map is compiled out entirely at zero intensity
+unsigned int getSceneFeatures() {
+	unsigned int features = lightingFeature((LightingModel)lightingModel);
+	if (normal > 0.0f) {
+		features |= FEATURE_NORMAL_MAP;
+	}
+	if (clusteredLights) {
+		features |= FEATURE_CLUSTERED_LIGHTS;
+	}
+	if (shadows) {
+		features |= FEATURE_SHADOWS;
+	}
+	// Also called from init() to warm up the default variant, before the IBL data exists
+	if (imageBasedLighting && ibl != nullptr && ibl->isValid()) {
+		features |= FEATURE_IBL;
+	}
+	if (ambientOcclusion) {
+		features |= FEATURE_SSAO;
+	}
+	if (virtualTexturing && virtualTextures != nullptr && virtualTextures->getTextureCount() > 0) {
+		features |= FEATURE_VIRTUAL_TEXTURE;
+	}
+	return features;
+}
+
+// Sun uniforms, from the day cycle when it runs, otherwise the fixed light position
+void setLightUniforms(Shader* sceneShader) {
+	if (dayCycle) {
+		// Already advanced in display(), this only uploads the sun's position and colours
+		lightSource->shaderProgramID = sceneShader->ID;
+		lightSource->Draw(0.0f);
+	}
+	else {
+		int light_pos_location = glGetUniformLocation(sceneShader->ID, "LightPosition");
+		glUniform4f(light_pos_location, lightPos[0], lightPos[1], lightPos[2], 1.0f);
+	}
+}
+
+void renderForward(const FrameVector<Model*>& visible) {
+	Shader* sceneShader = multiDrawIndirect ? sceneVariants->get(getSceneFeatures()) : shader;
+	sceneShader->use();
+
+	int view_mat_location = glGetUniformLocation(sceneShader->ID, "view");
+	int proj_mat_location = glGetUniformLocation(sceneShader->ID, "proj");
+
+	glUniformMatrix4fv(proj_mat_location, 1, GL_FALSE, glm::value_ptr(persp_proj));
+	glUniformMatrix4fv(view_mat_location, 1, GL_FALSE, glm::value_ptr(view));
+
+	int normal_location = glGetUniformLocation(sceneShader->ID, "normalMapIntensity");
+	glUniform1f(normal_location, normal);
+
+	setLightUniforms(sceneShader);
+
+	if (!multiDrawIndirect) {
+		for (Model* currentModel : visible) {
+			currentModel->Draw();
+		}
+		return;
+	}
+
+	sceneShader->setFloat("roughness", roughness);
+	sceneShader->setFloat("eta", eta);
+	sceneShader->setFloat("chromatic", chromatic);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, skybox->textureID);
 
+	if (clusteredLights) {
+		clusteredLighting->bind(sceneShader, width, height);
+	}
+	if (shadows) {
+		shadowMap->bind(sceneShader);
+	}
+	if (imageBasedLighting && ibl->isValid()) {
+		ibl->bind(sceneShader);
+	}
+	if (ambientOcclusion) {
+		ssao->bind();
+	}
+	if (getSceneFeatures() & FEATURE_VIRTUAL_TEXTURE) {
+		virtualTextures->bind(sceneShader);
+	}
+
+	// All material textures live in the library's arrays, so they are bound once for the whole batch
+	materialLibrary->bind();
+	meshBuffer->submit();
+}
+
+// Fills the G-buffer bound by display(), see gbuffer.h for the layout
+void renderDeferredGeometry() {
+	unsigned int gbufferFeatures = FEATURE_GBUFFER;
+	if (normal > 0.0f) {
+		gbufferFeatures |= FEATURE_NORMAL_MAP;
+	}
+	gbufferFeatures |= getSceneFeatures() & FEATURE_VIRTUAL_TEXTURE;
+	Shader* gbufferShader = gbufferVariants->get(gbufferFeatures);
+	gbufferShader->use();
+	gbufferShader->setMat4("view", view);
+	gbufferShader->setMat4("proj", persp_proj);
+	gbufferShader->setFloat("normalMapIntensity", normal);
+	if (gbufferFeatures & FEATURE_VIRTUAL_TEXTURE) {
+		virtualTextures->bind(gbufferShader);
+	}
+
+	materialLibrary->bind();
+	meshBuffer->submit();
+}
+
+// One fullscreen lighting pass so each covered pixel is lit exactly once
+void renderDeferredLighting() {
+	ProfileScope scope(profiler, "Deferred lighting");
+	sceneTarget->bind();
+
+	Shader* lightingShader = deferredVariants->get(getSceneFeatures() & (FEATURE_CLUSTERED_LIGHTS | FEATURE_SHADOWS | FEATURE_IBL | FEATURE_SSAO));
+	lightingShader->use();
+	lightingShader->setMat4("view", view);
+	lightingShader->setMat4("inverseViewProj", glm::inverse(persp_proj * view));
+	setLightUniforms(lightingShader);
+	if (clusteredLights) {
+		clusteredLighting->bind(lightingShader, width, height);
+	}
+	if (shadows) {
+		shadowMap->bind(lightingShader);
+	}
+	if (imageBasedLighting && ibl->isValid()) {
+		ibl->bind(lightingShader);
+	}
+	if (ambientOcclusion) {
+		ssao->bind();
+	}
+	materialLibrary->bind();
+	gbuffer->bindForReading();
+
+	// The shader writes the G-buffer depth through, depth testing itself is not wanted here
+	glDepthFunc(GL_ALWAYS);
+	gbuffer->drawFullscreen();
+	glDepthFunc(GL_LESS);
+}
+
+// Lays down depth for the queued draws through the position-only stream; the shading pass after it
+// runs with GL_EQUAL and no depth writes, so each pixel is shaded once
+void renderDepthPrepass() {
+	ProfileScope scope(profiler, "Depth pre-pass");
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	depthShader->use();
+	depthShader->setMat4("view", view);
+	depthShader->setMat4("proj", persp_proj);
+	meshBuffer->submit(true);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+}
+
+// Every fragment that passes the depth test adds a fixed amount of colour
+void renderOverdraw() {
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	overdrawShader->use();
+	overdrawShader->setMat4("view", view);
+	overdrawShader->setMat4("proj", persp_proj);
+	meshBuffer->submit(true);
+	glDisable(GL_BLEND);
+}
+
+// Drawn after the opaque geometry, at the far plane with GL_LEQUAL it only shades uncovered pixels
+void renderSkybox() {
+	ProfileScope scope(profiler, "Skybox");
 	glDepthFunc(GL_LEQUAL);
 	skyboxShader->use();
 
@@ -285,44 +744,192 @@ void display() {
 	glDrawArrays(GL_TRIANGLES,0,36);
 
 	glDepthFunc(GL_LESS);
-	
+}
+
+void display() {
+	profiler->beginFrame();
+	streamBuffer->beginFrame();
+	frameArena->reset();
+	size_t allocationsBefore = AllocationCounter::getCount();
+
+	// Pick up edited shader files before anything is drawn with them
+	shaderWatcher->poll();
+	// Pages that finished loading go in before the scene samples them
+	bool virtualTextured = multiDrawIndirect && (getSceneFeatures() & FEATURE_VIRTUAL_TEXTURE);
+	if (virtualTextured) {
+		ProfileScope scope(profiler, "Virtual texture update");
+		virtualTextures->update();
+	}
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
 	
 	glm::vec3 rotation = glm::vec3(0.0, 50.0, 50.0);
 	glm::vec3 position;
 	
 	// Select the current model list based on shape selection
-	std::vector<Model*>* currentModels = nullptr;
-	switch (shape) {
-		case 0: currentModels = &teapots; break;
-		case 1: currentModels = &cubes; break;
-		default: currentModels = &teapots; break;
+	std::vector<Model*>* currentModels = &getShapeModels();
+
+	for (Model* currentModel : *currentModels) {
+		if (rotating) {
+			position = glm::vec3(currentModel->model[3][0], currentModel->model[3][1], currentModel->model[3][2]);
+			currentModel->translate(-position);
+			currentModel->rotate(rotation * delta);
+			currentModel->translate(position);
+		}
+	}
+
+	// With TAA the whole frame is drawn with a sub-pixel offset, persp_proj is restored before returning
+	bool antiAliased = temporalAA && !overdrawView;
+	glm::mat4 projection = persp_proj;
+	if (antiAliased) {
+		taa->resize(width, height);
+		persp_proj = taa->jitter(projection);
+	}
+
+	// The camera pass only draws models whose bounding sphere touches the view frustum
+	Frustum cameraFrustum(persp_proj * view);
+	// Per-frame lists come out of the frame arena rather than the heap
+	ArenaAllocator<Model*> arena(*frameArena);
+	FrameVector<Model*> visible(arena);
+	FrameVector<float> visibleDepth(arena);
+	visible.reserve(currentModels->size());
+	visibleDepth.reserve(currentModels->size());
+	for (Model* currentModel : *currentModels) {
+		glm::vec3 center;
+		float radius;
+		currentModel->getWorldBounds(center, radius);
+		if (cameraFrustum.intersectsSphere(center, radius)) {
+			visible.push_back(currentModel);
+			visibleDepth.push_back(-(view * glm::vec4(center, 1.0f)).z);
+		}
+	}
+	visibleModels = (int)visible.size();
+
+	// Only the per-Mesh::Draw path samples the streamed textures, the indirect one reads the library's arrays
+	if (!multiDrawIndirect) {
+		ProfileScope scope(profiler, "Texture streaming");
+		for (Model* currentModel : visible) {
+			currentModel->requestTextures(*textureStreamer, view, persp_proj, height);
+		}
+		textureStreamer->update();
+	}
+
+	// Nearest first so early-Z rejects as much of what is behind as possible
+	if (frontToBack) {
+		FrameVector<size_t> order(visible.size(), 0, arena);
+		for (size_t i = 0; i < order.size(); i++) {
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return visibleDepth[a] < visibleDepth[b]; });
+		FrameVector<Model*> sorted(visible.size(), nullptr, arena);
+		for (size_t i = 0; i < order.size(); i++) {
+			sorted[i] = visible[order[i]];
+		}
+		visible.swap(sorted);
+	}
+
+	if (dayCycle) {
+		lightSource->Update(delta);
+	}
+	glm::vec3 lightPosition = dayCycle ? lightSource->position : glm::vec3(lightPos[0], lightPos[1], lightPos[2]);
+
+	// Shadow casters outside the camera frustum still matter, so the cascades cull the full list themselves
+	if (multiDrawIndirect && shadows) {
+		glm::vec3 lightDirection = glm::normalize(sceneCenter - lightPosition);
+		shadowMap->update(view, glm::radians(45.0f), (float)width / (float)height, NEAR_PLANE, FAR_PLANE, lightDirection);
+		shadowMap->render(*currentModels, *meshBuffer, shadowDepthShader);
 	}
 	
-	shader->use();
+	if (multiDrawIndirect && clusteredLights) {
+		ProfileScope scope(profiler, "Light binning");
+		animateLights(delta);
+		clusteredLighting->update(view, persp_proj, NEAR_PLANE, FAR_PLANE);
+	}
 
-	view_mat_location = glGetUniformLocation(shader->ID, "view");
-	proj_mat_location = glGetUniformLocation(shader->ID, "proj");
+	// One draw list for the pre-pass and the shading pass, uploaded once
+	if (multiDrawIndirect) {
+		meshBuffer->beginFrame();
+		for (Model* currentModel : visible) {
+			currentModel->Submit(*meshBuffer, materialIds[currentMaterial]);
+		}
+	}
 
-	glUniformMatrix4fv(proj_mat_location, 1, GL_FALSE, glm::value_ptr(persp_proj));
-	glUniformMatrix4fv(view_mat_location, 1, GL_FALSE, glm::value_ptr(view));
+	bool deferred = multiDrawIndirect && renderPath == RENDER_DEFERRED && !overdrawView;
+	bool occlusionPass = multiDrawIndirect && ambientOcclusion && !overdrawView;
 
-	int normal_location = glGetUniformLocation(shader->ID, "normalMapIntensity");
-	glUniform1f(normal_location, normal);
+	// Everything is drawn offscreen so the screen-space passes can read the depth
+	sceneTarget->resize(width, height);
+	sceneTarget->bind();
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	int light_pos_location = glGetUniformLocation(shader->ID, "LightPosition");
-	glUniform4f(light_pos_location, lightPos[0], lightPos[1], lightPos[2], 1.0f);
+	ProfileScope sceneScope(profiler, "Scene");
+	if (deferred) {
+		gbuffer->resize(width, height);
+		gbuffer->bindForWriting();
+	}
+	// Forward shading needs the occlusion before it runs, so the pre-pass is forced on to provide the depth
+	if (multiDrawIndirect && (depthPrepass || (occlusionPass && !deferred))) {
+		renderDepthPrepass();
+	}
+	if (occlusionPass && !deferred) {
+		ssao->resize(width, height);
+		ssao->render(sceneTarget->getDepthTexture(), view, persp_proj);
+		sceneTarget->bind();
+	}
 
-	for (int i = 0; i < 3; i++) {
-		Model* currentModel = (*currentModels)[i];
-		if (rotating) {
-			position = glm::vec3(currentModel->model[3][0], currentModel->model[3][1], currentModel->model[3][2]);
-			currentModel->translate(-position);
-			currentModel->rotate(rotation * delta);
-			currentModel->translate(position);
+	ProfileScope opaqueScope(profiler, "Opaque");
+	fragmentQuery->begin();
+	if (multiDrawIndirect && overdrawView) {
+		renderOverdraw();
+	}
+	else if (deferred) {
+		renderDeferredGeometry();
+	}
+	else {
+		renderForward(visible);
+	}
+	fragmentQuery->end();
+	opaqueScope.end();
+
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	// Uses the same draw list, with the jittered projection the scene was drawn with
+	if (virtualTextured && !overdrawView) {
+		ProfileScope scope(profiler, "Virtual texture feedback");
+		virtualTextures->renderFeedback(*meshBuffer, view, persp_proj, width, height);
+	}
+	if (deferred) {
+		if (occlusionPass) {
+			ssao->resize(width, height);
+			ssao->render(gbuffer->getDepthTexture(), view, persp_proj);
+		}
+		renderDeferredLighting();
+	}
+	sceneScope.end();
+
+	if (!(multiDrawIndirect && overdrawView)) {
+		renderSkybox();
+	}
+	// Without the draw list the history is reprojected by the camera motion only
+	if (antiAliased) {
+		if (multiDrawIndirect) {
+			taa->renderVelocity(*sceneTarget, *meshBuffer, view, persp_proj, projection);
 		}
-		currentModel->Draw();
+		taa->resolve(*sceneTarget, view, projection);
 	}
+	persp_proj = projection;
+	for (Model* currentModel : *currentModels) {
+		currentModel->endFrame();
+	}
+	postProcess->render(*sceneTarget, delta);
+
 	renderGUI();
+	streamBuffer->endFrame();
+	profiler->endFrame();
+	frameAllocations = AllocationCounter::getCount() - allocationsBefore;
 	glutSwapBuffers();
 }
 
@@ -350,20 +957,69 @@ void updateScene() {
 void init()
 {
 	shader = new Shader("simpleVertexShader.txt", "simpleFragmentShader.txt");
+	Mesh::bindSamplers(shader);
 	skyboxShader = new Shader("skyboxVertexShader.txt", "skyboxFragmentShader.txt");
+
+	profiler = new Profiler();
+	shaderWatcher = new ShaderWatcher();
+	shaderWatcher->watch(shader);
+	shaderWatcher->watch(skyboxShader);
+
+	// Variants of the indirect shaders are built on first use and registered with the watcher
+	sceneVariants = new ShaderVariants("indirectVertexShader.txt", "indirectFragmentShader.txt", shaderWatcher);
+	sceneVariants->get(getSceneFeatures());
+
+	threadPool = new ThreadPool();
+	clusteredLighting = new ClusteredLighting(threadPool);
+	generateLights(lightCount);
+
+	lightSource = new DirectionalLight(glm::vec4(lightPos[0], lightPos[1], lightPos[2], 1.0f), glm::vec3(0.7f, 0.7f, 0.7f),
+		glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.25f, 0.35f, 0.425f), 0, dayCycle);
+	shadowMap = new CascadedShadowMap(SHADOW_MAP_SIZE, CascadedShadowMap::MAX_CASCADES, profiler);
+	shadowDepthShader = new Shader("shadowVertexShader.txt", "shadowFragmentShader.txt");
+	shaderWatcher->watch(shadowDepthShader);
+
+	depthShader = new Shader("depthVertexShader.txt", "depthFragmentShader.txt");
+	overdrawShader = new Shader("depthVertexShader.txt", "overdrawFragmentShader.txt");
+	shaderWatcher->watch(depthShader);
+	shaderWatcher->watch(overdrawShader);
+	fragmentQuery = new GpuQuery(GL_SAMPLES_PASSED);
+
+	gbuffer = new GBuffer(width, height);
+	gbufferVariants = new ShaderVariants("indirectVertexShader.txt", "gbufferFragmentShader.txt", shaderWatcher);
+	deferredVariants = new ShaderVariants("deferredVertexShader.txt", "deferredFragmentShader.txt", shaderWatcher);
+	sceneTarget = new SceneTarget(width, height);
+	ssao = new ScreenSpaceAmbientOcclusion(width, height, shaderWatcher, profiler);
+	postProcess = new PostProcessChain(width, height, shaderWatcher, profiler);
+	taa = new TemporalAntiAliasing(width, height, shaderWatcher, profiler);
+	virtualTextures = new VirtualTextureSystem(VIRTUAL_TEXTURE_CACHE_SLOTS);
+	shaderWatcher->watch(virtualTextures->getFeedbackShader());
+
+	// Shared geometry storage for all static meshes (sizes in vertices / indices)
+	streamBuffer = new StreamBuffer(STREAM_FRAME_SIZE);
+	frameArena = new FrameArena(FRAME_ARENA_SIZE);
+	meshBuffer = new MeshBuffer(1 << 21, 1 << 22, streamBuffer);
 	
 	// Load teapots
 	for (int i = 0; i < 3; i++) {
-		Model* teapot = new Model("utah_teapot.obj", glm::vec3((7.5f * i) - 7.5f, 0.0, -20.0), shader);
+		Model* teapot = new Model("utah_teapot.obj", glm::vec3((7.5f * i) - 7.5f, 0.0, -20.0), shader, meshBuffer);
 		teapots.push_back(teapot);
 	}
 
 	// Load cubes
 	for (int i = 0; i < 3; i++) {
-		Model* cube = new Model("cube.obj", glm::vec3((7.5f * i) - 7.5f, 0.0, -20.0), shader);
+		Model* cube = new Model("cube.obj", glm::vec3((7.5f * i) - 7.5f, 0.0, -20.0), shader, meshBuffer);
 		cube->model = glm::scale(cube->model, glm::vec3(2.0f, 2.0f, 2.0f));
 		cubes.push_back(cube);
 	}
+
+	// Screen covering slabs listed back to front, the worst case for forward shading
+	for (int i = 0; i < OVERDRAW_LAYERS; i++) {
+		float distance = 80.0f - 3.0f * i;
+		Model* slab = new Model("cube.obj", glm::vec3(0.0f, 0.0f, -distance), shader, meshBuffer);
+		slab->model = glm::scale(slab->model, glm::vec3(distance * 0.8f, distance * 0.5f, 0.5f));
+		overdrawStack.push_back(slab);
+	}
 	
 	std::vector<std::string> faces = {
 		"textures/cubemaps/posx.jpg",
@@ -373,17 +1029,52 @@ void init()
 		"textures/cubemaps/posz.jpg",
 		"textures/cubemaps/negz.jpg"
 	};
-	skybox = new Skybox(faces);
-
-	// Load material textures using TextureFromFile from model.cpp
-	materialTextures[0].diffuse = TextureFromFile("textures/brick/diffuse.jpg", "");
-	materialTextures[0].normal = TextureFromFile("textures/brick/normal.jpg", "");
-
-	materialTextures[1].diffuse = TextureFromFile("textures/wicker/diffuse.jpg", "");
-	materialTextures[1].normal = TextureFromFile("textures/wicker/normal.png", "");
+	skybox = new Skybox(faces, 0.5f, threadPool);
+	ibl = new ImageBasedLighting(faces, threadPool);
+
+	// Material textures start with their small mips only, the rest streams in as the models come closer
+	textureStreamer = new TextureStreamer((size_t)textureBudget << 20);
+	materialTextures[0].diffuse = textureStreamer->load("textures/brick/diffuse.jpg");
+	materialTextures[0].normal = textureStreamer->load("textures/brick/normal.jpg");
+
+	materialTextures[1].diffuse = textureStreamer->load("textures/wicker/diffuse.jpg");
+	materialTextures[1].normal = textureStreamer->load("textures/wicker/normal.png");
+
+	materialTextures[2].diffuse = textureStreamer->load("textures/fabric/diffuse.jpg");
+	materialTextures[2].normal = textureStreamer->load("textures/fabric/normal.png");
+
+	// The same materials for the indirect path, matching the default Phong terms of simpleFragmentShader.txt
+	Material defaultMaterial;
+	defaultMaterial.Ka = glm::vec3(1.0f, 1.0f, 1.0f);
+	defaultMaterial.Kd = glm::vec3(1.0f, 1.0f, 1.0f);
+	defaultMaterial.Ks = glm::vec3(1.0f, 1.0f, 1.0f);
+	defaultMaterial.Ns = 10.0f;
+
+	materialLibrary = new MaterialLibrary(1024, 16);
+	materialIds[0] = materialLibrary->addMaterial("textures/brick/diffuse.jpg", "textures/brick/normal.jpg", defaultMaterial);
+	materialIds[1] = materialLibrary->addMaterial("textures/wicker/diffuse.jpg", "textures/wicker/normal.png", defaultMaterial);
+	materialIds[2] = materialLibrary->addMaterial("textures/fabric/diffuse.jpg", "textures/fabric/normal.png", defaultMaterial);
+
+	// All three are rough dielectrics under GGX, fabric the roughest
+	float roughnesses[3] = { 0.8f, 0.6f, 0.95f };
+	for (int i = 0; i < 3; i++) {
+		Material material = defaultMaterial;
+		material.roughness = roughnesses[i];
+		materialLibrary->setMaterial(materialIds[i], material);
+	}
 
-	materialTextures[2].diffuse = TextureFromFile("textures/fabric/diffuse.jpg", "");
-	materialTextures[2].normal = TextureFromFile("textures/fabric/normal.png", "");
+	// The parameters each file brings go into the library too, with the textures of the selected material.
+	// Copies of one file share their entries, so an edit in the GUI reaches all of them
+	std::vector<Model*>* modelLists[3] = { &teapots, &cubes, &overdrawStack };
+	for (auto* modelList : modelLists) {
+		if (modelList->empty()) {
+			continue;
+		}
+		(*modelList)[0]->registerMaterials(*materialLibrary, materialIds[currentMaterial]);
+		for (Model* model : *modelList) {
+			model->libraryMaterials = (*modelList)[0]->libraryMaterials;
+		}
+	}
 
 	// Debug: print texture IDs
 	std::cout << "Brick diffuse: " << materialTextures[0].diffuse << ", normal: " << materialTextures[0].normal << std::endl;
@@ -400,9 +1091,756 @@ void cleanup() {
 	ImGui_ImplGLUT_Shutdown();
 	ImGui::DestroyContext();
 
+	delete taa;
+	delete postProcess;
+	delete ssao;
+	delete sceneTarget;
+	delete ibl;
+	delete fragmentQuery;
+	delete overdrawShader;
+	delete depthShader;
+	delete deferredVariants;
+	delete gbufferVariants;
+	delete gbuffer;
+	delete shadowMap;
+	delete shadowDepthShader;
+	delete lightSource;
+	delete clusteredLighting;
+	delete virtualTextures;
+	delete textureStreamer;
+	delete threadPool;
+	delete shaderWatcher;
+	delete profiler;
+	delete materialLibrary;
+	delete meshBuffer;
+	delete streamBuffer;
+	delete frameArena;
+	delete sceneVariants;
 	delete shader;
 }
 
+#pragma region BENCHMARKS
+
+// Appends an axis aligned box with per-face normals and tangents, used to build distinct benchmark meshes
+void appendBox(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, glm::vec3 halfExtents) {
+	const glm::vec3 normals[6] = {
+		glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+		glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+	};
+	const glm::vec3 tangents[6] = {
+		glm::vec3(0, 0, -1), glm::vec3(0, 0, 1), glm::vec3(1, 0, 0),
+		glm::vec3(1, 0, 0), glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0)
+	};
+	const glm::vec2 corners[4] = { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) };
+
+	for (int face = 0; face < 6; face++) {
+		unsigned int base = (unsigned int)vertices.size();
+		glm::vec3 bitangent = glm::cross(normals[face], tangents[face]);
+		for (int c = 0; c < 4; c++) {
+			Vertex vertex;
+			vertex.Position = (normals[face] + tangents[face] * corners[c].x + bitangent * corners[c].y) * halfExtents;
+			vertex.Normal = normals[face];
+			vertex.TextureCoords = (corners[c] + glm::vec2(1.0f, 1.0f)) * 0.5f;
+			vertex.Tangent = tangents[face];
+			vertex.Bitangent = bitangent;
+			vertices.push_back(vertex);
+		}
+		unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int i = 0; i < 6; i++) {
+			indices.push_back(base + quad[i]);
+		}
+	}
+}
+
+// The per-Mesh::Draw runs sample the streamed material textures without requesting them, so they are made
+// fully resident to compare against the full size arrays of the indirect path
+void makeMaterialTexturesResident() {
+	for (int i = 0; i < 3; i++) {
+		textureStreamer->makeResident(materialTextures[i].diffuse);
+		textureStreamer->makeResident(materialTextures[i].normal);
+	}
+}
+
+// Compares CPU submission cost of the per-Mesh::Draw path against one glMultiDrawElementsIndirect
+void runSubmissionBenchmark() {
+	makeMaterialTexturesResident();
+	std::vector<Texture> textures(2);
+	textures[0].id = materialTextures[0].diffuse;
+	textures[0].slot = TEXTURE_DIFFUSE;
+	textures[1].id = materialTextures[0].normal;
+	textures[1].slot = TEXTURE_NORMAL;
+
+	MeshBuffer benchmarkBuffer(BENCHMARK_MESH_COUNT * 24, BENCHMARK_MESH_COUNT * 36);
+	std::vector<Mesh> benchmarkMeshes;
+	std::vector<glm::mat4> transforms;
+	benchmarkMeshes.reserve(BENCHMARK_MESH_COUNT);
+	transforms.reserve(BENCHMARK_MESH_COUNT);
+	Mesh::logSetup = false;
+
+	for (int i = 0; i < BENCHMARK_MESH_COUNT; i++) {
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		float size = 0.1f + 0.4f * (float)(i % 97) / 97.0f;
+		appendBox(vertices, indices, glm::vec3(size, size * 0.5f + 0.05f, size));
+		benchmarkMeshes.push_back(Mesh(std::move(vertices), std::move(indices), std::vector<Texture>(textures), shader, &benchmarkBuffer));
+
+		glm::vec3 position = glm::vec3((float)(i % 100) - 50.0f, (float)((i / 100) % 10) * 2.0f - 10.0f, -20.0f - (float)(i / 1000) * 2.0f);
+		transforms.push_back(glm::translate(glm::mat4(1.0f), position));
+	}
+	Mesh::logSetup = true;
+
+	// Same draw list written into a persistently mapped ring instead of glBufferSubData
+	StreamBuffer benchmarkStream(BENCHMARK_MESH_COUNT * (sizeof(DrawElementsIndirectCommand) + sizeof(DrawData) + 2 * sizeof(glm::mat4)) + 4096);
+
+	double byNameSeconds = 0.0;
+	double perMeshSeconds = 0.0;
+	double indirectSeconds = 0.0;
+	double streamedSeconds = 0.0;
+	double fenceWaitMilliseconds = 0.0;
+
+	for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		shader->use();
+		shader->setMat4("view", view);
+		shader->setMat4("proj", persp_proj);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < BENCHMARK_MESH_COUNT; i++) {
+			benchmarkMeshes[i].DrawByName(transforms[i]);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		byNameSeconds += std::chrono::duration<double>(end - start).count();
+		glFinish();
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < BENCHMARK_MESH_COUNT; i++) {
+			benchmarkMeshes[i].Draw(transforms[i]);
+		}
+		end = std::chrono::high_resolution_clock::now();
+		perMeshSeconds += std::chrono::duration<double>(end - start).count();
+		glFinish();
+
+		Shader* indirectShader = sceneVariants->get(getSceneFeatures());
+		indirectShader->use();
+		indirectShader->setMat4("view", view);
+		indirectShader->setMat4("proj", persp_proj);
+		indirectShader->setFloat("normalMapIntensity", normal);
+		start = std::chrono::high_resolution_clock::now();
+		benchmarkBuffer.beginFrame();
+		for (int i = 0; i < BENCHMARK_MESH_COUNT; i++) {
+			GLuint transformIndex = benchmarkBuffer.addTransform(transforms[i]);
+			benchmarkMeshes[i].Submit(benchmarkBuffer, transformIndex, 0);
+		}
+		benchmarkBuffer.submit();
+		end = std::chrono::high_resolution_clock::now();
+		indirectSeconds += std::chrono::duration<double>(end - start).count();
+		glFinish();
+
+		benchmarkBuffer.setStreamBuffer(&benchmarkStream);
+		start = std::chrono::high_resolution_clock::now();
+		benchmarkStream.beginFrame();
+		benchmarkBuffer.beginFrame();
+		for (int i = 0; i < BENCHMARK_MESH_COUNT; i++) {
+			GLuint transformIndex = benchmarkBuffer.addTransform(transforms[i]);
+			benchmarkMeshes[i].Submit(benchmarkBuffer, transformIndex, 0);
+		}
+		benchmarkBuffer.submit();
+		benchmarkStream.endFrame();
+		end = std::chrono::high_resolution_clock::now();
+		streamedSeconds += std::chrono::duration<double>(end - start).count();
+		fenceWaitMilliseconds += benchmarkStream.getFenceWaitMilliseconds();
+		benchmarkBuffer.setStreamBuffer(nullptr);
+		glFinish();
+
+		glutSwapBuffers();
+	}
+
+	std::cout << "Submission benchmark: " << BENCHMARK_MESH_COUNT << " meshes, " << BENCHMARK_FRAMES << " frames" << std::endl;
+	std::cout << "  Mesh::Draw, string slots:   " << byNameSeconds * 1000.0 / BENCHMARK_FRAMES << " ms/frame" << std::endl;
+	std::cout << "  Mesh::Draw per mesh:        " << perMeshSeconds * 1000.0 / BENCHMARK_FRAMES << " ms/frame" << std::endl;
+	std::cout << "  glMultiDrawElementsIndirect: " << indirectSeconds * 1000.0 / BENCHMARK_FRAMES << " ms/frame" << std::endl;
+	std::cout << "  MDI from the stream buffer:  " << streamedSeconds * 1000.0 / BENCHMARK_FRAMES << " ms/frame, "
+		<< benchmarkStream.getFrameBytes() / 1024 << " KB/frame, " << fenceWaitMilliseconds / BENCHMARK_FRAMES << " ms fence wait"
+		<< (benchmarkStream.isPersistent() ? "" : " (not mapped)") << std::endl;
+
+	for (Mesh& mesh : benchmarkMeshes) {
+		mesh.releaseGeometry();
+	}
+}
+
+// Frame time with one unique material per mesh: texture binds per Mesh::Draw against one material index per draw
+void runMaterialBenchmark() {
+	makeMaterialTexturesResident();
+	MeshBuffer benchmarkBuffer(BENCHMARK_MATERIAL_COUNT * 24, BENCHMARK_MATERIAL_COUNT * 36);
+	std::vector<Mesh> benchmarkMeshes;
+	std::vector<GLuint> benchmarkMaterials;
+	std::vector<glm::mat4> transforms;
+	benchmarkMeshes.reserve(BENCHMARK_MATERIAL_COUNT);
+
+	const char* diffusePaths[3] = { "textures/brick/diffuse.jpg", "textures/wicker/diffuse.jpg", "textures/fabric/diffuse.jpg" };
+	const char* normalPaths[3] = { "textures/brick/normal.jpg", "textures/wicker/normal.png", "textures/fabric/normal.png" };
+
+	Mesh::logSetup = false;
+	for (int i = 0; i < BENCHMARK_MATERIAL_COUNT; i++) {
+		// Each material gets its own tint on top of one of the three texture sets
+		int textureSet = i % 3;
+		Material material;
+		material.Ka = glm::vec3(1.0f, 1.0f, 1.0f);
+		material.Kd = glm::vec3((float)(i % 10) / 10.0f, (float)((i / 10) % 10) / 10.0f, (float)(i / 100) / 10.0f);
+		material.Ks = glm::vec3(1.0f, 1.0f, 1.0f);
+		material.Ns = 5.0f + (float)(i % 50);
+		benchmarkMaterials.push_back(materialLibrary->addMaterial(diffusePaths[textureSet], normalPaths[textureSet], material));
+
+		std::vector<Texture> textures(2);
+		textures[0].id = materialTextures[textureSet].diffuse;
+		textures[0].slot = TEXTURE_DIFFUSE;
+		textures[1].id = materialTextures[textureSet].normal;
+		textures[1].slot = TEXTURE_NORMAL;
+
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		appendBox(vertices, indices, glm::vec3(0.4f, 0.4f, 0.4f));
+		benchmarkMeshes.push_back(Mesh(std::move(vertices), std::move(indices), std::vector<Texture>(textures), shader, &benchmarkBuffer));
+
+		glm::vec3 position = glm::vec3((float)(i % 40) - 20.0f, (float)((i / 40) % 25) - 12.0f, -40.0f);
+		transforms.push_back(glm::translate(glm::mat4(1.0f), position));
+	}
+	Mesh::logSetup = true;
+
+	double perMeshSeconds = 0.0;
+	double indirectSeconds = 0.0;
+
+	for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glFinish();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		shader->use();
+		shader->setMat4("view", view);
+		shader->setMat4("proj", persp_proj);
+		for (int i = 0; i < BENCHMARK_MATERIAL_COUNT; i++) {
+			benchmarkMeshes[i].Draw(transforms[i]);
+		}
+		glFinish();
+		auto end = std::chrono::high_resolution_clock::now();
+		perMeshSeconds += std::chrono::duration<double>(end - start).count();
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glFinish();
+
+		start = std::chrono::high_resolution_clock::now();
+		Shader* indirectShader = sceneVariants->get(getSceneFeatures());
+		indirectShader->use();
+		indirectShader->setMat4("view", view);
+		indirectShader->setMat4("proj", persp_proj);
+		indirectShader->setFloat("normalMapIntensity", normal);
+		materialLibrary->bind();
+		benchmarkBuffer.beginFrame();
+		for (int i = 0; i < BENCHMARK_MATERIAL_COUNT; i++) {
+			GLuint transformIndex = benchmarkBuffer.addTransform(transforms[i]);
+			benchmarkMeshes[i].Submit(benchmarkBuffer, transformIndex, benchmarkMaterials[i]);
+		}
+		benchmarkBuffer.submit();
+		glFinish();
+		end = std::chrono::high_resolution_clock::now();
+		indirectSeconds += std::chrono::duration<double>(end - start).count();
+
+		glutSwapBuffers();
+	}
+
+	std::cout << "Material benchmark: " << BENCHMARK_MATERIAL_COUNT << " unique materials, " << BENCHMARK_FRAMES << " frames" << std::endl;
+	std::cout << "  Texture binds per Mesh::Draw: " << perMeshSeconds * 1000.0 / BENCHMARK_FRAMES << " ms/frame" << std::endl;
+	std::cout << "  Material table + arrays:      " << indirectSeconds * 1000.0 / BENCHMARK_FRAMES << " ms/frame" << std::endl;
+
+	for (Mesh& mesh : benchmarkMeshes) {
+		mesh.releaseGeometry();
+	}
+}
+
+// Renders the normal scene with count clustered lights and reports frame and binning time
+void runLightBenchmark(int count) {
+	multiDrawIndirect = true;
+	clusteredLights = true;
+	lightCount = count;
+	generateLights(lightCount);
+
+	// Warm up once so the variant compile is not part of the measurement
+	display();
+	glFinish();
+
+	double frameSeconds = 0.0;
+	double binningMilliseconds = 0.0;
+	for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		delta = 1.0f / 60.0f;
+		display();
+		glFinish();
+		frameSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		binningMilliseconds += clusteredLighting->getBinningMilliseconds();
+	}
+
+	std::cout << "Light benchmark: " << count << " lights, " << BENCHMARK_FRAMES << " frames, "
+		<< threadPool->getThreadCount() + 1 << " binning threads" << std::endl;
+	std::cout << "  Frame time: " << frameSeconds * 1000.0 / BENCHMARK_FRAMES << " ms" << std::endl;
+	std::cout << "  Binning:    " << binningMilliseconds / BENCHMARK_FRAMES << " ms" << std::endl;
+	std::cout << "  Light indices in last frame: " << clusteredLighting->getLightIndexCount() << std::endl;
+}
+
+// Forward against deferred on the overdraw stack with count clustered lights, frame and GPU scene time per path
+void runDeferredBenchmark(int count) {
+	multiDrawIndirect = true;
+	clusteredLights = true;
+	shape = 2;
+	lightCount = count;
+	generateLights(lightCount);
+
+	std::cout << "Deferred benchmark: " << OVERDRAW_LAYERS << " overdraw layers, " << count << " lights, " << BENCHMARK_FRAMES << " frames" << std::endl;
+	const char* names[2] = { "Forward: ", "Deferred:" };
+	for (int path = RENDER_FORWARD; path <= RENDER_DEFERRED; path++) {
+		renderPath = path;
+
+		// Warm up once so variant compiles and target allocation are not part of the measurement
+		display();
+		glFinish();
+
+		double frameSeconds = 0.0;
+		double sceneMilliseconds = 0.0;
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			delta = 1.0f / 60.0f;
+			display();
+			glFinish();
+			frameSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			sceneMilliseconds += profiler->getGpuMilliseconds("Scene");
+		}
+		std::cout << "  " << names[path] << " frame " << frameSeconds * 1000.0 / BENCHMARK_FRAMES << " ms, scene GPU "
+			<< sceneMilliseconds / BENCHMARK_FRAMES << " ms" << std::endl;
+	}
+}
+
+// Overdraw stack with the draws listed back to front, with and without sorting and the depth pre-pass
+void runOverdrawBenchmark() {
+	multiDrawIndirect = true;
+	shape = 2;
+	renderPath = RENDER_FORWARD;
+	overdrawView = false;
+
+	std::cout << "Overdraw benchmark: " << OVERDRAW_LAYERS << " layers, " << BENCHMARK_FRAMES << " frames" << std::endl;
+	const char* names[4] = { "Unsorted:            ", "Front-to-back:       ", "Pre-pass:            ", "Pre-pass + sorted:   " };
+	for (int mode = 0; mode < 4; mode++) {
+		frontToBack = (mode & 1) != 0;
+		depthPrepass = (mode & 2) != 0;
+
+		display();
+		glFinish();
+
+		double sceneMilliseconds = 0.0;
+		double fragments = 0.0;
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+			delta = 0.0f;
+			display();
+			glFinish();
+			sceneMilliseconds += profiler->getGpuMilliseconds("Scene");
+			fragments += (double)fragmentQuery->getResult();
+		}
+		std::cout << "  " << names[mode] << sceneMilliseconds / BENCHMARK_FRAMES << " ms GPU, "
+			<< fragments / BENCHMARK_FRAMES / ((double)width * height) << " shaded fragments per pixel" << std::endl;
+	}
+}
+
+// Cube map decode and mip generation, serial and on the pool, against reading the cached mip chain back
+void runSkyboxBenchmark() {
+	std::vector<std::string> faces = {
+		"textures/cubemaps/posx.jpg",
+		"textures/cubemaps/negx.jpg",
+		"textures/cubemaps/posy.jpg",
+		"textures/cubemaps/negy.jpg",
+		"textures/cubemaps/posz.jpg",
+		"textures/cubemaps/negz.jpg"
+	};
+
+	ThreadPool* pools[2] = { nullptr, threadPool };
+	double coldMilliseconds[2];
+	CubeMipChain chain;
+	bool decoded = false;
+	for (int i = 0; i < 2; i++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		decoded = Skybox::decodeFaces(faces, pools[i], chain);
+		if (decoded) {
+			Skybox::generateMips(pools[i], chain);
+		}
+		coldMilliseconds[i] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	std::string cachePath = Skybox::getCachePath(faces);
+	if (decoded) {
+		Skybox::saveCache(cachePath, chain);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	CubeMipChain cached;
+	bool loaded = Skybox::loadCache(cachePath, cached);
+	double cacheMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "Skybox benchmark: " << chain.size << "x" << chain.size << ", " << chain.levels << " levels" << std::endl;
+	std::cout << "  Decode + mips, 1 thread: " << (decoded ? "" : "FAILED ") << coldMilliseconds[0] << " ms" << std::endl;
+	std::cout << "  Decode + mips, " << threadPool->getThreadCount() + 1 << " threads: " << coldMilliseconds[1] << " ms" << std::endl;
+	std::cout << "  Cache load: " << (loaded ? "" : "MISSING ") << cacheMilliseconds << " ms" << std::endl;
+}
+
+// IBL precompute from the skybox faces without the cache, against reading the cached result back
+void runIBLBenchmark() {
+	std::vector<std::string> faces = {
+		"textures/cubemaps/posx.jpg",
+		"textures/cubemaps/negx.jpg",
+		"textures/cubemaps/posy.jpg",
+		"textures/cubemaps/negy.jpg",
+		"textures/cubemaps/posz.jpg",
+		"textures/cubemaps/negz.jpg"
+	};
+
+	IBLData data;
+	auto start = std::chrono::high_resolution_clock::now();
+	bool computed = ImageBasedLighting::compute(faces, threadPool, data);
+	double computeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	IBLData cached;
+	bool loaded = ImageBasedLighting::loadCache(ImageBasedLighting::getCachePath(faces), cached);
+	double cacheMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "IBL benchmark: " << threadPool->getThreadCount() + 1 << " threads" << std::endl;
+	std::cout << "  Precompute: " << (computed ? "" : "FAILED ") << computeMilliseconds << " ms" << std::endl;
+	std::cout << "  Cache load: " << (loaded ? "" : "MISSING ") << cacheMilliseconds << " ms" << std::endl;
+	if (computed) {
+		// Band 0 alone is the average irradiance / pi of the whole environment
+		glm::vec3 average = data.sh[0] * 0.282095f;
+		std::cout << "  Average ambient: " << average.x << ", " << average.y << ", " << average.z << std::endl;
+	}
+}
+
+// Box filters a (width * factor) x (height * factor) RGB image down to width x height
+static void downsampleColor(const std::vector<float>& source, int factor, int width, int height, std::vector<float>& result) {
+	result.assign((size_t)width * height * 3, 0.0f);
+	int sourceWidth = width * factor;
+	float scale = 1.0f / (factor * factor);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			for (int sy = 0; sy < factor; sy++) {
+				for (int sx = 0; sx < factor; sx++) {
+					size_t from = ((size_t)(y * factor + sy) * sourceWidth + (x * factor + sx)) * 3;
+					size_t to = ((size_t)y * width + x) * 3;
+					for (int c = 0; c < 3; c++) {
+						result[to + c] += source[from + c] * scale;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Root mean square difference with values clamped to [0, 1], roughly what is left after tone mapping
+static double colorError(const std::vector<float>& a, const std::vector<float>& b) {
+	double sum = 0.0;
+	for (size_t i = 0; i < a.size(); i++) {
+		double difference = glm::clamp(a[i], 0.0f, 1.0f) - glm::clamp(b[i], 0.0f, 1.0f);
+		sum += difference * difference;
+	}
+	return a.empty() ? 0.0 : sqrt(sum / a.size());
+}
+
+// Deterministic TAA check: one fixed view without animation, compared before the post chain against a
+// TAA_SUPERSAMPLE x TAA_SUPERSAMPLE supersampled render of the same view. Prints the error with no
+// anti-aliasing and after TAA has converged, and fails when TAA did not get closer to the reference
+bool runTAAReference() {
+	multiDrawIndirect = true;
+	shape = 0;
+	renderPath = RENDER_FORWARD;
+	overdrawView = false;
+	rotating = false;
+	dayCycle = false;
+	clusteredLights = false;
+	// The AO noise pattern depends on the resolution, keep it out of the comparison
+	ambientOcclusion = false;
+	delta = 0.0f;
+
+	int baseWidth = width;
+	int baseHeight = height;
+
+	temporalAA = false;
+	width = baseWidth * TAA_SUPERSAMPLE;
+	height = baseHeight * TAA_SUPERSAMPLE;
+	display();
+	glFinish();
+	std::vector<float> pixels;
+	sceneTarget->readColor(pixels);
+	std::vector<float> reference;
+	downsampleColor(pixels, TAA_SUPERSAMPLE, baseWidth, baseHeight, reference);
+	width = baseWidth;
+	height = baseHeight;
+
+	display();
+	glFinish();
+	std::vector<float> aliased;
+	sceneTarget->readColor(aliased);
+
+	temporalAA = true;
+	taa->reset();
+	for (int frame = 0; frame < TAA_CONVERGE_FRAMES; frame++) {
+		display();
+	}
+	glFinish();
+	std::vector<float> resolved;
+	sceneTarget->readColor(resolved);
+
+	double aliasedError = colorError(aliased, reference);
+	double resolvedError = colorError(resolved, reference);
+	std::cout << "TAA reference: " << baseWidth << "x" << baseHeight << " against " << TAA_SUPERSAMPLE << "x" << TAA_SUPERSAMPLE
+		<< " supersampling, " << TAA_CONVERGE_FRAMES << " frames" << std::endl;
+	std::cout << "  No AA RMSE: " << aliasedError << std::endl;
+	std::cout << "  TAA RMSE:   " << resolvedError << std::endl;
+	std::cout << "  " << (resolvedError < aliasedError ? "PASS" : "FAIL") << std::endl;
+	return resolvedError < aliasedError;
+}
+
+// Runs a scene file headless for its frame count along a fixed-timestep camera orbit and writes
+// <output>.csv (per frame) and <output>.json (summary, the input of --bench-compare)
+bool runSceneBenchmark(const std::string& path, const std::string& output) {
+	BenchmarkScene scene;
+	if (!scene.load(path)) {
+		return false;
+	}
+
+	const char* diffusePaths[3] = { "textures/brick/diffuse.jpg", "textures/wicker/diffuse.jpg", "textures/fabric/diffuse.jpg" };
+	const char* normalPaths[3] = { "textures/brick/normal.jpg", "textures/wicker/normal.png", "textures/fabric/normal.png" };
+	std::mt19937 random(scene.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<GLuint> sceneMaterials;
+	for (int i = 0; i < scene.materials; i++) {
+		Material material;
+		material.Ka = glm::vec3(1.0f, 1.0f, 1.0f);
+		material.Kd = glm::vec3(0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random));
+		material.Ks = glm::vec3(1.0f, 1.0f, 1.0f);
+		material.Ns = 5.0f + 60.0f * unit(random);
+		material.metallic = unit(random) < 0.25f ? 1.0f : 0.0f;
+		material.roughness = 0.2f + 0.8f * unit(random);
+		sceneMaterials.push_back(materialLibrary->addMaterial(diffusePaths[i % 3], normalPaths[i % 3], material));
+	}
+
+	// Square grid around the scene centre, every instance turned at random
+	Model* prototype = new Model(scene.model.c_str(), glm::vec3(0.0f, 0.0f, 0.0f), shader, meshBuffer);
+	int side = (int)ceil(sqrt((double)scene.instances));
+	for (int i = 0; i < scene.instances; i++) {
+		glm::vec3 position = sceneCenter + glm::vec3(((i % side) - (side - 1) * 0.5f) * scene.spacing, 0.0f, ((i / side) - (side - 1) * 0.5f) * scene.spacing);
+		glm::mat4 transform = glm::rotate(glm::translate(glm::mat4(1.0f), position), glm::radians(360.0f * unit(random)), glm::vec3(0.0f, 1.0f, 0.0f));
+		Model* instance = prototype->createInstance(transform, instancePool);
+		instance->libraryMaterial = sceneMaterials[i % sceneMaterials.size()];
+		sceneModels.push_back(instance);
+	}
+
+	multiDrawIndirect = true;
+	shape = 3;
+	renderPath = scene.deferred ? RENDER_DEFERRED : RENDER_FORWARD;
+	shadows = scene.shadows;
+	ambientOcclusion = scene.ambientOcclusion;
+	imageBasedLighting = scene.imageBasedLighting;
+	temporalAA = scene.temporalAA;
+	clusteredLights = scene.lights > 0;
+	lightCount = scene.lights;
+	generateLights(lightCount);
+	rotating = false;
+	dayCycle = false;
+	overdrawView = false;
+
+	// Fixed timestep, the camera is at the same place on the same frame of every run
+	const float step = 1.0f / 60.0f;
+	BenchmarkRecorder recorder;
+	for (int frame = -scene.warmupFrames; frame < scene.frames; frame++) {
+		float time = (frame + scene.warmupFrames) * step;
+		float angle = scene.orbitSeconds > 0.0f ? glm::radians(360.0f) * time / scene.orbitSeconds : 0.0f;
+		glm::vec3 eye = sceneCenter + glm::vec3(sin(angle) * scene.orbitRadius, scene.orbitHeight, cos(angle) * scene.orbitRadius);
+		view = glm::lookAt(eye, sceneCenter, glm::vec3(0.0f, 1.0f, 0.0f));
+		delta = step;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		display();
+		glFinish();
+		double cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (frame >= 0) {
+			// The profiler reports the GPU time of the frame before, which has finished by now
+			recorder.addFrame(cpuMilliseconds, profiler->getGpuMilliseconds("Frame"), meshBuffer->getDrawCount(), meshBuffer->getTriangleCount(), frameAllocations);
+		}
+	}
+	recorder.sampleMemory();
+
+	recorder.print(scene);
+	bool written = recorder.writeCSV(output + ".csv") && recorder.writeJSON(output + ".json", scene);
+	if (written) {
+		std::cout << "  Wrote " << output << ".csv and " << output << ".json" << std::endl;
+	}
+
+	for (Model* instance : sceneModels) {
+		instancePool.destroy(instance);
+	}
+	sceneModels.clear();
+	delete prototype;
+	return written;
+}
+
+// Flies the camera from far away up to the cubes on the per-Mesh::Draw path, which samples the streamed
+// textures, and prints how much of the full mip chains is resident on the way in. The second run has a budget
+// too small for the close-up, so it has to evict the finest levels of textures out of view to make room
+void runStreamingBenchmark() {
+	multiDrawIndirect = false;
+	shape = 1;
+	rotating = false;
+	dayCycle = false;
+	temporalAA = false;
+
+	GLuint diffuse = materialTextures[currentMaterial].diffuse;
+	size_t budgets[2] = { (size_t)TEXTURE_STREAMING_BUDGET << 20, textureStreamer->getFullBytes() / 4 };
+	std::cout << "Texture streaming: " << textureStreamer->getTextureCount() << " textures, "
+		<< textureStreamer->getFullBytes() / (1024.0 * 1024.0) << " MB with every level" << std::endl;
+	for (size_t budget : budgets) {
+		textureStreamer->setBudget(budget);
+		std::cout << "  Budget " << budget / (1024.0 * 1024.0) << " MB" << std::endl;
+
+		int settledFrame = -1;
+		for (int frame = 0; frame < STREAMING_FRAMES; frame++) {
+			// Most of the run closes in, the rest holds at the nearest point
+			float approach = glm::min((float)frame / (STREAMING_FRAMES * 0.75f), 1.0f);
+			float distance = glm::mix(400.0f, 6.0f, approach);
+			view = glm::lookAt(sceneCenter + glm::vec3(0.0f, 0.0f, distance), sceneCenter, glm::vec3(0.0f, 1.0f, 0.0f));
+			delta = 1.0f / 60.0f;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			display();
+			glFinish();
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			if (frame % 30 == 0 || frame == STREAMING_FRAMES - 1) {
+				std::cout << "    distance " << distance << ": " << textureStreamer->getResidentBytes() / (1024.0 * 1024.0)
+					<< " MB resident, diffuse mip " << textureStreamer->getResidentMip(diffuse) << " (wants "
+					<< textureStreamer->getWantedMip(diffuse) << "), " << milliseconds << " ms" << std::endl;
+			}
+			bool settled = textureStreamer->getResidentMip(diffuse) <= textureStreamer->getWantedMip(diffuse);
+			if (approach >= 1.0f && settledFrame < 0 && settled) {
+				settledFrame = frame - (int)(STREAMING_FRAMES * 0.75f);
+			}
+		}
+		if (settledFrame >= 0) {
+			std::cout << "    Settled " << settledFrame << " frames after arriving";
+		}
+		else {
+			std::cout << "    Did not reach the wanted mip";
+		}
+		std::cout << ", " << textureStreamer->getEvictions() << " evictions so far" << std::endl;
+	}
+}
+
+// Drives PageCache with the requests a camera gliding low over one 16K virtual texture would make, with no GL
+// or file reads, and checks its invariants every frame. Pages under the camera want mip 0 and each doubling of
+// the distance one mip coarser. A missing page arrives `latency` frames after it is requested, at most
+// MAX_UPLOADS_PER_FRAME a frame, and meanwhile its nearest resident ancestor is sampled, as in the real system.
+// Prints the hit rate, evictions and how many mips too coarse the sampled pages were for each cache size
+bool runPageCacheSimulation(int slots) {
+	const int mipCount = 8; // MAX_PAGES pages on a side down to one
+	const int latency = 4;
+	const float viewRadius = 3.0f; // in pages of the mip being drawn
+	std::vector<int> sizes = slots > 0 ? std::vector<int>{ slots } : std::vector<int>{ 64, 128, 256, 512, 1024 };
+
+	std::cout << "Page cache simulation: " << VIRTUAL_TEXTURE_SIMULATION_FRAMES << " frames over a "
+		<< VirtualTextureSystem::MAX_PAGES * VirtualTextureFile::PAGE_SIZE << " texture" << std::endl;
+	bool valid = true;
+	for (int size : sizes) {
+		PageCache cache(size);
+		unsigned int evicted;
+		unsigned int topKey = makePageKey(0, mipCount - 1, 0, 0);
+		int topSlot = cache.allocate(topKey, 1, evicted);
+		cache.pin(topSlot);
+
+		std::vector<std::pair<unsigned int, int>> reads; // page and the frame it arrives
+		std::unordered_set<unsigned int> pending;
+		std::vector<unsigned int> requests;
+		unsigned long long sampled = 0, fallbackMips = 0, dropped = 0;
+		for (int frame = 2; frame < VIRTUAL_TEXTURE_SIMULATION_FRAMES + 2; frame++) {
+			glm::vec2 camera = glm::vec2(64.0f + 48.0f * sin(frame * 0.004f), 64.0f + 48.0f * sin(frame * 0.0031f + 1.0f));
+
+			// Every page of mip m in the ring between the reach of mip m - 1 and its own
+			requests.clear();
+			for (int mip = 0; mip < mipCount; mip++) {
+				float scale = (float)(1 << mip);
+				float outer = viewRadius * scale;
+				float inner = mip > 0 ? outer * 0.5f : 0.0f;
+				int pages = VirtualTextureSystem::MAX_PAGES >> mip;
+				int x0 = std::max(0, (int)floor((camera.x - outer) / scale)), x1 = std::min(pages - 1, (int)floor((camera.x + outer) / scale));
+				int y0 = std::max(0, (int)floor((camera.y - outer) / scale)), y1 = std::min(pages - 1, (int)floor((camera.y + outer) / scale));
+				for (int y = y0; y <= y1; y++) {
+					for (int x = x0; x <= x1; x++) {
+						float distance = glm::length(glm::vec2((x + 0.5f) * scale, (y + 0.5f) * scale) - camera);
+						if (distance < outer && distance >= inner) {
+							requests.push_back(makePageKey(0, mip, x, y));
+						}
+					}
+				}
+			}
+			std::sort(requests.begin(), requests.end(), [](unsigned int a, unsigned int b) {
+				return pageKeyMip(a) != pageKeyMip(b) ? pageKeyMip(a) > pageKeyMip(b) : a < b;
+			});
+
+			for (unsigned int key : requests) {
+				sampled++;
+				if (cache.touch(key, frame) >= 0) {
+					continue;
+				}
+				if (pending.count(key) == 0 && (int)reads.size() < VirtualTextureSystem::MAX_PENDING_READS) {
+					pending.insert(key);
+					reads.push_back(std::make_pair(key, frame + latency));
+				}
+				for (unsigned int mip = pageKeyMip(key) + 1; mip < (unsigned int)mipCount; mip++) {
+					unsigned int shift = mip - pageKeyMip(key);
+					int slot = cache.find(makePageKey(0, mip, pageKeyX(key) >> shift, pageKeyY(key) >> shift));
+					if (slot >= 0) {
+						cache.use(slot, frame);
+						fallbackMips += shift;
+						break;
+					}
+				}
+			}
+
+			int uploads = 0;
+			for (size_t i = 0; i < reads.size() && uploads < VirtualTextureSystem::MAX_UPLOADS_PER_FRAME;) {
+				if (reads[i].second > frame) {
+					i++;
+					continue;
+				}
+				// Refused when every slot is pinned or in view, the page is asked for again next frame
+				if (cache.allocate(reads[i].first, frame, evicted) < 0) {
+					dropped++;
+				}
+				pending.erase(reads[i].first);
+				reads.erase(reads.begin() + i);
+				uploads++;
+			}
+
+			if (!cache.validate() || cache.find(topKey) != topSlot) {
+				std::cout << "  " << size << " slots: invariant broken on frame " << frame << std::endl;
+				valid = false;
+				break;
+			}
+		}
+
+		unsigned long long lookups = cache.getHits() + cache.getMisses();
+		std::cout << "  " << size << " slots (" << size * VirtualTextureFile::PAGE_BYTES / (1024 * 1024) << " MB): "
+			<< 100.0 * cache.getHits() / (lookups > 0 ? lookups : 1) << "% hits, " << cache.getEvictions() << " evictions, "
+			<< dropped << " uploads refused, " << (double)fallbackMips / (sampled > 0 ? sampled : 1) << " mips too coarse on average" << std::endl;
+	}
+	std::cout << "  " << (valid ? "PASS" : "FAIL") << std::endl;
+	return valid;
+}
+
+#pragma endregion BENCHMARKS
+
 int main(int argc, char** argv) {
 
 	// Set up the window
@@ -434,6 +1872,65 @@ int main(int argc, char** argv) {
 
 	init();
 
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--bench-submission") {
+			runSubmissionBenchmark();
+			return 0;
+		}
+		if (std::string(argv[i]) == "--bench-materials") {
+			runMaterialBenchmark();
+			return 0;
+		}
+		if (std::string(argv[i]) == "--bench-lights") {
+			runLightBenchmark(i + 1 < argc ? atoi(argv[i + 1]) : 4096);
+			return 0;
+		}
+		if (std::string(argv[i]) == "--bench-skybox") {
+			runSkyboxBenchmark();
+			return 0;
+		}
+		if (std::string(argv[i]) == "--bench-ibl") {
+			runIBLBenchmark();
+			return 0;
+		}
+		if (std::string(argv[i]) == "--bench-overdraw") {
+			runOverdrawBenchmark();
+			return 0;
+		}
+		if (std::string(argv[i]) == "--bench-deferred") {
+			runDeferredBenchmark(i + 1 < argc ? atoi(argv[i + 1]) : 1024);
+			return 0;
+		}
+		if (std::string(argv[i]) == "--bench-scene" && i + 1 < argc) {
+			return runSceneBenchmark(argv[i + 1], i + 2 < argc ? argv[i + 2] : "benchmark") ? 0 : 1;
+		}
+		if (std::string(argv[i]) == "--bench-compare" && i + 2 < argc) {
+			return BenchmarkRecorder::compare(argv[i + 1], argv[i + 2], i + 3 < argc ? atof(argv[i + 3]) : 5.0) ? 0 : 1;
+		}
+		if (std::string(argv[i]) == "--taa-reference") {
+			return runTAAReference() ? 0 : 1;
+		}
+		if (std::string(argv[i]) == "--bench-streaming") {
+			runStreamingBenchmark();
+			return 0;
+		}
+		if (std::string(argv[i]) == "--vt-simulate") {
+			return runPageCacheSimulation(i + 1 < argc ? atoi(argv[i + 1]) : 0) ? 0 : 1;
+		}
+		// Not a benchmark: streams the image as the diffuse texture of all three materials and carries on
+		if (std::string(argv[i]) == "--virtual-texture" && i + 1 < argc) {
+			int index = virtualTextures->addTexture(argv[++i]);
+			if (index >= 0) {
+				for (int material = 0; material < 3; material++) {
+					materialLibrary->setVirtualTexture(materialIds[material], index);
+				}
+				// The models' entries copy the textures of the selected material
+				updateModelTextures(currentMaterial);
+				virtualTexturing = true;
+			}
+		}
+	}
+
 	glutDisplayFunc(display);
 	glutIdleFunc(updateScene);
 	glutKeyboardFunc(keypress);
@@ -0,0 +1,179 @@
+#include "materiallibrary.h"
+
+// Standard library
+#include <string>
+#include <vector>
+#include <iostream>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes
+#include "stb_image.h"
+
+MaterialLibrary::MaterialLibrary(int layerSize, int maxLayers) {
+	this->layerSize = layerSize;
+	this->maxLayers = maxLayers;
+	this->layerCount = 0;
+	this->dirty = true;
+	this->mipmapsDirty = false;
+	this->materialCapacity = 0;
+
+	int levels = 1;
+	while ((layerSize >> levels) > 0) {
+		levels++;
+	}
+
+	GLuint arrays[2];
+	glGenTextures(2, arrays);
+	diffuseArray = arrays[0];
+	normalArray = arrays[1];
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i]);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, layerSize, layerSize, maxLayers);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenBuffers(1, &materialBuffer);
+	glGenFramebuffers(1, &readFBO);
+	glGenFramebuffers(1, &drawFBO);
+}
+
+MaterialLibrary::~MaterialLibrary() {
+	GLuint arrays[2] = { diffuseArray, normalArray };
+	glDeleteTextures(2, arrays);
+	glDeleteBuffers(1, &materialBuffer);
+	glDeleteFramebuffers(1, &readFBO);
+	glDeleteFramebuffers(1, &drawFBO);
+}
+
+GLuint MaterialLibrary::addMaterial(const std::string& diffusePath, const std::string& normalPath, const Material& material) {
+	MaterialData data;
+	GLint layer = loadLayer(diffusePath, normalPath);
+	data.layers = glm::ivec4(layer, layer, -1, 0);
+	materials.push_back(data);
+
+	GLuint index = (GLuint)materials.size() - 1;
+	setMaterial(index, material);
+	return index;
+}
+
+GLuint MaterialLibrary::addMaterial(const Material& material, GLuint textureSource) {
+	MaterialData data;
+	data.layers = materials[textureSource].layers;
+	materials.push_back(data);
+
+	GLuint index = (GLuint)materials.size() - 1;
+	setMaterial(index, material);
+	return index;
+}
+
+void MaterialLibrary::setMaterial(GLuint index, const Material& material) {
+	MaterialData& data = materials[index];
+	data.Ka = glm::vec4(material.Ka, material.occlusion);
+	data.Kd = glm::vec4(material.Kd, material.metallic);
+	data.Ks = glm::vec4(material.Ks, material.Ns);
+	data.emissive = glm::vec4(material.emissive, material.roughness);
+	dirty = true;
+}
+
+GLint MaterialLibrary::loadLayer(const std::string& diffusePath, const std::string& normalPath) {
+	// Materials that only differ in their parameters share the texture layer
+	std::string key = diffusePath + "|" + normalPath;
+	auto found = layerLookup.find(key);
+	if (found != layerLookup.end()) {
+		return found->second;
+	}
+	if (layerCount >= maxLayers) {
+		std::cerr << "MaterialLibrary: no free layer for " << diffusePath << ", using layer 0" << std::endl;
+		return 0;
+	}
+
+	GLint layer = layerCount++;
+	uploadLayer(diffuseArray, layer, diffusePath);
+	uploadLayer(normalArray, layer, normalPath);
+	layerLookup[key] = layer;
+	mipmapsDirty = true;
+	return layer;
+}
+
+bool MaterialLibrary::uploadLayer(GLuint arrayTexture, GLint layer, const std::string& path) {
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 4);
+	if (!data) {
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		return false;
+	}
+
+	GLuint source;
+	glGenTextures(1, &source);
+	glBindTexture(GL_TEXTURE_2D, source);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	stbi_image_free(data);
+
+	// Layers must all be layerSize x layerSize, so let the GPU rescale the image on the way in
+	GLint previousFramebuffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFBO);
+	glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, arrayTexture, 0, layer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, layerSize, layerSize, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glDeleteTextures(1, &source);
+	return true;
+}
+
+void MaterialLibrary::setMaterialData(GLuint index, const MaterialData& data) {
+	materials[index] = data;
+	dirty = true;
+}
+
+void MaterialLibrary::setTextures(GLuint index, GLuint source) {
+	materials[index].layers = materials[source].layers;
+	dirty = true;
+}
+
+void MaterialLibrary::setVirtualTexture(GLuint index, GLint virtualTexture) {
+	materials[index].layers.z = virtualTexture;
+	dirty = true;
+}
+
+void MaterialLibrary::bind() {
+	if (mipmapsDirty) {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, diffuseArray);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, normalArray);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		mipmapsDirty = false;
+	}
+
+	if (dirty && !materials.empty()) {
+		GLsizeiptr size = materials.size() * sizeof(MaterialData);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+		if (size > materialCapacity) {
+			materialCapacity = size;
+			glBufferData(GL_SHADER_STORAGE_BUFFER, materialCapacity, NULL, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, &materials[0]);
+		dirty = false;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + DIFFUSE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, diffuseArray);
+	glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, normalArray);
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, materialBuffer);
+}
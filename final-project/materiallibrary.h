@@ -0,0 +1,71 @@
+#pragma once
+
+// Standard library
+#include <map>
+#include <string>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "mesh.h"
+
+// GPU side material entry (std430), indexed per draw by DrawData::materialIndex
+struct MaterialData {
+	glm::vec4 Ka;       // w = occlusion
+	glm::vec4 Kd;       // rgb = diffuse / base color, w = metallic
+	glm::vec4 Ks;       // w = Ns
+	glm::vec4 emissive; // w = roughness
+	glm::ivec4 layers;  // x = diffuse layer, y = normal layer, z = virtual texture or -1
+};
+
+// Keeps every material texture in two GL_TEXTURE_2D_ARRAYs (diffuse and normal share a layer index)
+// and the material parameters in one SSBO, so switching material is an index instead of texture binds
+class MaterialLibrary {
+public:
+	// Texture units and SSBO binding used by indirectFragmentShader.txt
+	static constexpr GLuint DIFFUSE_UNIT = 0;
+	static constexpr GLuint NORMAL_UNIT = 1;
+	static constexpr GLuint MATERIAL_BINDING = 2;
+
+	GLuint diffuseArray;
+	GLuint normalArray;
+
+	MaterialLibrary(int layerSize, int maxLayers);
+	~MaterialLibrary();
+
+	GLuint addMaterial(const std::string& diffusePath, const std::string& normalPath, const Material& material);
+	// An entry with its own parameters that samples the textures of textureSource
+	GLuint addMaterial(const Material& material, GLuint textureSource);
+	void setMaterial(GLuint index, const Material& material);
+	void setMaterialData(GLuint index, const MaterialData& data);
+	// Points index at the textures (layers and virtual texture) of source, keeping its parameters
+	void setTextures(GLuint index, GLuint source);
+	// Diffuse from a VirtualTextureSystem texture instead of the array layer, -1 to go back to the layer.
+	// Only read by the VIRTUAL_TEXTURE shader variants
+	void setVirtualTexture(GLuint index, GLint virtualTexture);
+	const MaterialData& getMaterial(GLuint index) const { return materials[index]; }
+	size_t getMaterialCount() const { return materials.size(); }
+
+	void bind();
+
+private:
+	int layerSize;
+	int maxLayers;
+	int layerCount;
+	bool dirty;
+	bool mipmapsDirty;
+
+	GLuint materialBuffer;
+	GLsizeiptr materialCapacity;
+	GLuint readFBO, drawFBO;
+
+	std::vector<MaterialData> materials;
+	std::map<std::string, GLint> layerLookup;
+
+	GLint loadLayer(const std::string& diffusePath, const std::string& normalPath);
+	bool uploadLayer(GLuint arrayTexture, GLint layer, const std::string& path);
+};
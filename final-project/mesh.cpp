@@ -29,24 +29,98 @@ namespace std {
 
 using namespace std;
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, Shader* shader) {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+Mesh::Mesh(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, std::vector<Texture>&& textures, Shader* shader, MeshBuffer* meshBuffer, GLuint materialIndex) {
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
+	this->indexCount = (GLsizei)this->indices.size();
 	this->shader = shader;
 	this->shaderProgramID = shader->ID;
+	this->materialIndex = materialIndex;
+	resolveBindings();
     setupMesh();
+
+	// Static geometry is also suballocated into the shared buffer for multi-draw indirect
+	if (meshBuffer != nullptr) {
+		this->allocation = meshBuffer->upload(this->vertices, this->indices);
+	}
+}
+
+Mesh Mesh::shareGeometry() const {
+	Mesh mesh;
+	mesh.textures = textures;
+	mesh.resolveBindings();
+	mesh.allocation = allocation;
+	mesh.materialIndex = materialIndex;
+	mesh.VAO = VAO;
+	mesh.VBO = VBO;
+	mesh.EBO = EBO;
+	mesh.indexCount = indexCount;
+	mesh.shaderProgramID = shaderProgramID;
+	mesh.shader = shader;
+	return mesh;
+}
+
+bool Mesh::logSetup = true;
+
+void Mesh::releaseGeometry() {
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	VAO = VBO = EBO = 0;
+}
+
+const char* const Mesh::SAMPLER_NAMES[TEXTURE_SLOT_COUNT] = { "ourTexture", "normalMap", "specularMap" };
+
+void Mesh::resolveBindings() {
+	bindingCount = 0;
+	for (const Texture& texture : textures) {
+		// A later texture for the same slot replaces the earlier one, only one can be sampled
+		unsigned int i = 0;
+		while (i < bindingCount && bindings[i].unit != texture.slot) {
+			i++;
+		}
+		if (i == bindingCount) {
+			if (bindingCount == TEXTURE_SLOT_COUNT) {
+				continue;
+			}
+			bindingCount++;
+		}
+		bindings[i].unit = texture.slot;
+		bindings[i].id = texture.id;
+	}
+}
+
+void Mesh::bindSamplers(Shader* shader) {
+	for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+		shader->setSampler(SAMPLER_NAMES[slot], slot);
+	}
 }
 
 void Mesh::Draw(glm::mat4 model) {
-	Material material;
+	// Samplers already point at their slot's unit, so this is only binds
+	for (unsigned int i = 0; i < bindingCount; i++) {
+		glActiveTexture(GL_TEXTURE0 + bindings[i].unit);
+		glBindTexture(GL_TEXTURE_2D, bindings[i].id);
+	}
+
+	// Read from the shader each time, the location changes when the shader is hot reloaded
+	glUniformMatrix4fv(shader->modelLocation, 1, GL_FALSE, glm::value_ptr(model));
+	glBindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawByName(glm::mat4 model) {
+	const char* typeNames[TEXTURE_SLOT_COUNT] = { "texture_diffuse", "texture_normal", "texture_specular" };
 	for (unsigned int i = 0; i < textures.size(); i++) {
 		glActiveTexture(GL_TEXTURE0 + i);
-		string name = textures[i].type;
+		std::string name = typeNames[textures[i].slot];
 		if (name == "texture_diffuse") {
 			glBindTexture(GL_TEXTURE_2D, textures[i].id);
 			shader->setInt("ourTexture", 0);
-			material = textures[i].material;
 		}
 		else if (name == "texture_normal") {
 			glBindTexture(GL_TEXTURE_2D, textures[i].id);
@@ -54,25 +128,34 @@ void Mesh::Draw(glm::mat4 model) {
 		}
 	}
 
-	int matrix_location = glGetUniformLocation(shaderProgramID, "model");
+	int matrix_location = glGetUniformLocation(shader->ID, "model");
 	glUniformMatrix4fv(matrix_location, 1, GL_FALSE, glm::value_ptr(model));
 	glBindVertexArray(VAO);
-	glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
 	glBindVertexArray(0);
 
 	glActiveTexture(GL_TEXTURE0);
 }
+
+void Mesh::Submit(MeshBuffer& meshBuffer, GLuint transformIndex, GLuint materialIndex) {
+	meshBuffer.addDraw(allocation, transformIndex, materialIndex);
+}
     
 void Mesh::setupMesh() {
 
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
 
 	glBindVertexArray(VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
+	// Part of the VAO's state, so Draw only binds the VAO
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+
 	GLuint loc1 = glGetAttribLocation(shaderProgramID, "vertex_position");
 	GLuint loc2 = glGetAttribLocation(shaderProgramID, "vertex_normal");
 	GLuint loc3 = glGetAttribLocation(shaderProgramID, "vertex_texture");
@@ -95,5 +178,7 @@ void Mesh::setupMesh() {
 	glVertexAttribPointer(loc5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
 	glBindVertexArray(0);
-	std::cout << "Mesh setup" << "\n";
+	if (logSetup) {
+		std::cout << "Mesh setup" << "\n";
+	}
 }
\ No newline at end of file
@@ -12,6 +12,7 @@ typedef unsigned int GLuint;
 #include <glm/gtc/type_ptr.hpp>
 
 #include "shader.h"
+#include "meshbuffer.h"
 
 struct Vertex {
     glm::vec3 Position;
@@ -22,17 +23,41 @@ struct Vertex {
 };
 
 struct Material {
-	glm::vec3 Kd; // Diffuse
+	glm::vec3 Kd; // Diffuse, also the base color of the metallic-roughness model
 	glm::vec3 Ks; // Specular
 	glm::vec3 Ka; // Ambient
 	float Ns; // Specular Exponent
+
+	// Metallic-roughness terms read by the GGX lighting model
+	float metallic = 0.0f;
+	float roughness = 0.5f;
+	glm::vec3 emissive = glm::vec3(0.0f, 0.0f, 0.0f);
+	float occlusion = 1.0f;
+
+	// UV units per model space unit over the meshes using this material, worked out at import
+	float uvDensity = 1.0f;
+};
+
+// What a texture is used for. The value is also the texture unit it is bound to, the sampler uniforms are
+// pointed at these units once when a program links (see Mesh::bindSamplers)
+enum TextureSlot : unsigned char {
+	TEXTURE_DIFFUSE = 0,
+	TEXTURE_NORMAL = 1,
+	TEXTURE_SPECULAR = 2,
+	TEXTURE_SLOT_COUNT
 };
 
+// The file a texture came from is only needed to share it between meshes while loading, so it lives in
+// Model's cache rather than in every copy
 struct Texture {
- unsigned int id;
-    std::string type;
-	aiString path;
-	Material material;
+	unsigned int id;
+	TextureSlot slot;
+};
+
+// One glBindTexture of Mesh::Draw
+struct TextureBinding {
+	GLuint unit;
+	GLuint id;
 };
 
 
@@ -41,14 +66,48 @@ public:
 	std::vector<Vertex>       vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Texture>      textures;
+	MeshAllocation            allocation;
+	GLuint                    materialIndex; // into the owning Model's material table
 	
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, Shader* shader);
+	// Takes the geometry over, pass the vectors with std::move
+	Mesh(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, std::vector<Texture>&& textures, Shader* shader, MeshBuffer* meshBuffer = nullptr, GLuint materialIndex = 0);
+
+	// Geometry is owned by exactly one Mesh, it is moved but never copied
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
+
+	// Another mesh drawing the same GL geometry, without the CPU side vertices and indices
+	Mesh shareGeometry() const;
+
+	// Rebuilds the binding table from textures, call it after changing them
+	void resolveBindings();
+
+	// Frees the VAO and buffers. Only for the mesh that created them, not for shareGeometry() copies
+	void releaseGeometry();
+
+	// Prints a line per mesh set up, the benchmarks turn it off while building thousands of them
+	static bool logSetup;
+
+	// Sampler uniform read from each slot by the per-mesh shader
+	static const char* const SAMPLER_NAMES[TEXTURE_SLOT_COUNT];
+	// Registers SAMPLER_NAMES with shader so they are set at link time instead of on every draw
+	static void bindSamplers(Shader* shader);
 
 	void Draw(glm::mat4 model);
+	// Draw as it was before the binding table: each texture's type compared as a string and its sampler uniform
+	// looked up and set on every call. Only kept as the baseline of the submission benchmark
+	void DrawByName(glm::mat4 model);
+	void Submit(MeshBuffer& meshBuffer, GLuint transformIndex, GLuint materialIndex);
 private:
 	unsigned int VAO, VBO, EBO;
+	GLsizei indexCount;
+	TextureBinding bindings[TEXTURE_SLOT_COUNT]; // at most one texture per slot, built by resolveBindings()
+	unsigned int bindingCount = 0;
 	GLuint shaderProgramID;
 	Shader* shader;
 
+	Mesh() {}
 	void setupMesh();
 };
\ No newline at end of file
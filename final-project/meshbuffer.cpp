@@ -0,0 +1,297 @@
+#include "meshbuffer.h"
+
+// Standard library
+#include <vector>
+#include <iostream>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes
+#include "mesh.h"
+
+OffsetAllocator::OffsetAllocator(GLuint capacity) {
+	this->freeSpace = capacity;
+	freeRanges[0] = capacity;
+}
+
+GLuint OffsetAllocator::allocate(GLuint size) {
+	if (size == 0) {
+		return INVALID_OFFSET;
+	}
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+		if (it->second < size) {
+			continue;
+		}
+		GLuint offset = it->first;
+		GLuint remaining = it->second - size;
+		freeRanges.erase(it);
+		if (remaining > 0) {
+			freeRanges[offset + size] = remaining;
+		}
+		freeSpace -= size;
+		return offset;
+	}
+	return INVALID_OFFSET;
+}
+
+void OffsetAllocator::release(GLuint offset, GLuint size) {
+	if (size == 0) {
+		return;
+	}
+	auto it = freeRanges.emplace(offset, size).first;
+	freeSpace += size;
+
+	// Merge with the following range
+	auto next = std::next(it);
+	if (next != freeRanges.end() && it->first + it->second == next->first) {
+		it->second += next->second;
+		freeRanges.erase(next);
+	}
+
+	// Merge with the preceding range
+	if (it != freeRanges.begin()) {
+		auto prev = std::prev(it);
+		if (prev->first + prev->second == it->first) {
+			prev->second += it->second;
+			freeRanges.erase(it);
+		}
+	}
+}
+
+MeshBuffer::MeshBuffer(GLuint maxVertices, GLuint maxIndices, StreamBuffer* streamBuffer)
+	: vertexAllocator(maxVertices), indexAllocator(maxIndices) {
+	this->streamBuffer = streamBuffer;
+	this->streamed = false;
+
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)maxVertices * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+
+	// Same vertex indices as VBO, tightly packed so depth passes fetch 12 bytes per vertex instead of 56
+	glGenBuffers(1, &positionVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)maxVertices * sizeof(glm::vec3), NULL, GL_STATIC_DRAW);
+
+	// Element buffer binding is VAO state, so allocate it through the copy target instead
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)maxIndices * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &commandBuffer);
+	glGenBuffers(1, &drawDataBuffer);
+	glGenBuffers(1, &transformBuffer);
+	glGenBuffers(1, &previousTransformBuffer);
+	commandCapacity = drawDataCapacity = transformCapacity = previousTransformCapacity = 0;
+	uploaded = false;
+
+	setupVAO();
+	setupDepthVAO();
+}
+
+MeshBuffer::~MeshBuffer() {
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteVertexArrays(1, &depthVAO);
+	unsigned int buffers[7] = { VBO, EBO, positionVBO, commandBuffer, drawDataBuffer, transformBuffer, previousTransformBuffer };
+	glDeleteBuffers(7, buffers);
+}
+
+void MeshBuffer::setupVAO() {
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+	// Fixed locations, see the layout qualifiers in indirectVertexShader.txt
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Position));
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TextureCoords));
+
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+
+	glBindVertexArray(0);
+}
+
+void MeshBuffer::setupDepthVAO() {
+	glGenVertexArrays(1, &depthVAO);
+	glBindVertexArray(depthVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+	glBindVertexArray(0);
+}
+
+MeshAllocation MeshBuffer::upload(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+	MeshAllocation allocation;
+
+	GLuint firstVertex = vertexAllocator.allocate((GLuint)vertices.size());
+	if (firstVertex == OffsetAllocator::INVALID_OFFSET) {
+		std::cerr << "MeshBuffer: out of vertex space for " << vertices.size() << " vertices" << std::endl;
+		return allocation;
+	}
+	GLuint firstIndex = indexAllocator.allocate((GLuint)indices.size());
+	if (firstIndex == OffsetAllocator::INVALID_OFFSET) {
+		std::cerr << "MeshBuffer: out of index space for " << indices.size() << " indices" << std::endl;
+		vertexAllocator.release(firstVertex, (GLuint)vertices.size());
+		return allocation;
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstVertex * sizeof(Vertex), vertices.size() * sizeof(Vertex), &vertices[0]);
+
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		positions[i] = vertices[i].Position;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, positionVBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstVertex * sizeof(glm::vec3), positions.size() * sizeof(glm::vec3), &positions[0]);
+
+	// Indices stay relative to the mesh, the draw command supplies firstVertex as baseVertex
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * sizeof(unsigned int), indices.size() * sizeof(unsigned int), &indices[0]);
+
+	allocation.firstVertex = firstVertex;
+	allocation.vertexCount = (GLuint)vertices.size();
+	allocation.firstIndex = firstIndex;
+	allocation.indexCount = (GLuint)indices.size();
+	allocation.valid = true;
+	return allocation;
+}
+
+void MeshBuffer::release(MeshAllocation& allocation) {
+	if (!allocation.valid) {
+		return;
+	}
+	vertexAllocator.release(allocation.firstVertex, allocation.vertexCount);
+	indexAllocator.release(allocation.firstIndex, allocation.indexCount);
+	allocation.valid = false;
+}
+
+void MeshBuffer::beginFrame() {
+	commands.clear();
+	drawData.clear();
+	transforms.clear();
+	previousTransforms.clear();
+	uploaded = false;
+}
+
+GLuint MeshBuffer::addTransform(const glm::mat4& model, const glm::mat4& previousModel) {
+	transforms.push_back(model);
+	previousTransforms.push_back(previousModel);
+	uploaded = false;
+	return (GLuint)transforms.size() - 1;
+}
+
+void MeshBuffer::addDraw(const MeshAllocation& allocation, GLuint transformIndex, GLuint materialIndex) {
+	if (!allocation.valid) {
+		return;
+	}
+	DrawElementsIndirectCommand command;
+	command.count = allocation.indexCount;
+	command.instanceCount = 1;
+	command.firstIndex = allocation.firstIndex;
+	command.baseVertex = (GLint)allocation.firstVertex;
+	command.baseInstance = 0;
+	commands.push_back(command);
+
+	DrawData data;
+	data.transformIndex = transformIndex;
+	data.materialIndex = materialIndex;
+	data.padding[0] = data.padding[1] = 0;
+	drawData.push_back(data);
+	uploaded = false;
+}
+
+size_t MeshBuffer::getTriangleCount() const {
+	size_t triangles = 0;
+	for (const DrawElementsIndirectCommand& command : commands) {
+		triangles += command.count / 3;
+	}
+	return triangles;
+}
+
+void MeshBuffer::uploadStream(GLenum target, unsigned int buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size) {
+	glBindBuffer(target, buffer);
+	if (size > capacity) {
+		// Grow geometrically so the store is only reallocated a handful of times
+		capacity = (size > capacity * 2) ? size : capacity * 2;
+		glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+	}
+	glBufferSubData(target, 0, size, data);
+}
+
+bool MeshBuffer::uploadToStreamBuffer() {
+	if (streamBuffer == nullptr) {
+		return false;
+	}
+	GLsizeiptr alignment = streamBuffer->getStorageAlignment();
+	const void* data[4] = { &commands[0], &drawData[0], &transforms[0], &previousTransforms[0] };
+	GLsizeiptr sizes[4] = { (GLsizeiptr)(commands.size() * sizeof(DrawElementsIndirectCommand)), (GLsizeiptr)(drawData.size() * sizeof(DrawData)),
+		(GLsizeiptr)(transforms.size() * sizeof(glm::mat4)), (GLsizeiptr)(previousTransforms.size() * sizeof(glm::mat4)) };
+	// Indirect commands only need to be 4 byte aligned
+	GLsizeiptr alignments[4] = { 4, alignment, alignment, alignment };
+	StreamRange ranges[4];
+	if (!streamBuffer->uploadAll(data, sizes, alignments, ranges, 4)) {
+		return false;
+	}
+	commandRange = ranges[0];
+	drawDataRange = ranges[1];
+	transformRange = ranges[2];
+	previousTransformRange = ranges[3];
+	return true;
+}
+
+void MeshBuffer::submit(bool positionsOnly) {
+	if (commands.empty()) {
+		return;
+	}
+	if (!uploaded) {
+		// When the four blocks don't all fit in this frame's stream region, none of them go there and this list
+		// is uploaded to the buffers of our own instead
+		streamed = uploadToStreamBuffer();
+		if (!streamed) {
+			uploadStream(GL_DRAW_INDIRECT_BUFFER, commandBuffer, commandCapacity, &commands[0], commands.size() * sizeof(DrawElementsIndirectCommand));
+			uploadStream(GL_SHADER_STORAGE_BUFFER, drawDataBuffer, drawDataCapacity, &drawData[0], drawData.size() * sizeof(DrawData));
+			uploadStream(GL_SHADER_STORAGE_BUFFER, transformBuffer, transformCapacity, &transforms[0], transforms.size() * sizeof(glm::mat4));
+			uploadStream(GL_SHADER_STORAGE_BUFFER, previousTransformBuffer, previousTransformCapacity, &previousTransforms[0], previousTransforms.size() * sizeof(glm::mat4));
+		}
+		uploaded = true;
+	}
+
+	GLintptr commandOffset = 0;
+	if (streamed) {
+		GLuint stream = streamBuffer->getBuffer();
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, stream, drawDataRange.offset, drawDataRange.size);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, TRANSFORM_BINDING, stream, transformRange.offset, transformRange.size);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, PREVIOUS_TRANSFORM_BINDING, stream, previousTransformRange.offset, previousTransformRange.size);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream);
+		commandOffset = commandRange.offset;
+	}
+	else {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_BINDING, transformBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PREVIOUS_TRANSFORM_BINDING, previousTransformBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	}
+
+	glBindVertexArray(positionsOnly ? depthVAO : VAO);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandOffset, (GLsizei)commands.size(), 0);
+	glBindVertexArray(0);
+}
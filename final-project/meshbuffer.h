@@ -0,0 +1,113 @@
+#pragma once
+
+// Standard library
+#include <map>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "streambuffer.h"
+
+struct Vertex;
+
+// Layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Per-draw data read in the vertex shader through gl_DrawIDARB (std430, 16 byte aligned)
+struct DrawData {
+	GLuint transformIndex;
+	GLuint materialIndex;
+	GLuint padding[2];
+};
+
+// Where a mesh lives inside the shared vertex and index buffers
+struct MeshAllocation {
+	GLuint firstVertex = 0;
+	GLuint vertexCount = 0;
+	GLuint firstIndex = 0;
+	GLuint indexCount = 0;
+	bool valid = false;
+};
+
+// First-fit range allocator over [0, capacity), freed ranges are merged with their neighbours
+class OffsetAllocator {
+public:
+	static constexpr GLuint INVALID_OFFSET = 0xFFFFFFFFu;
+
+	OffsetAllocator(GLuint capacity);
+	GLuint allocate(GLuint size);
+	void release(GLuint offset, GLuint size);
+	GLuint getFreeSpace() const { return freeSpace; }
+
+private:
+	std::map<GLuint, GLuint> freeRanges; // offset -> size
+	GLuint freeSpace;
+};
+
+class MeshBuffer {
+public:
+	// Binding points of the shader storage blocks in indirectVertexShader.txt
+	static constexpr GLuint DRAW_DATA_BINDING = 0;
+	static constexpr GLuint TRANSFORM_BINDING = 1;
+	// Last frame's model matrices, same indexing as the transforms (velocityVertexShader.txt)
+	static constexpr GLuint PREVIOUS_TRANSFORM_BINDING = 8;
+
+	unsigned int VAO;
+	// Positions only, for depth passes that don't need the rest of the vertex
+	unsigned int depthVAO;
+
+	// With a stream buffer the per-frame streams are written into it and bound by offset, otherwise they
+	// go through buffers of their own with glBufferSubData
+	MeshBuffer(GLuint maxVertices, GLuint maxIndices, StreamBuffer* streamBuffer = nullptr);
+	~MeshBuffer();
+
+	MeshAllocation upload(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+	void release(MeshAllocation& allocation);
+
+	void beginFrame();
+	GLuint addTransform(const glm::mat4& model) { return addTransform(model, model); }
+	GLuint addTransform(const glm::mat4& model, const glm::mat4& previousModel);
+	void addDraw(const MeshAllocation& allocation, GLuint transformIndex, GLuint materialIndex);
+	// Draws everything added since beginFrame(). Submitting again in the same frame reuses the uploaded streams
+	void submit(bool positionsOnly = false);
+
+	void setStreamBuffer(StreamBuffer* streamBuffer) { this->streamBuffer = streamBuffer; uploaded = false; }
+
+	size_t getDrawCount() const { return commands.size(); }
+	size_t getTriangleCount() const;
+
+private:
+	unsigned int VBO, EBO;
+	unsigned int positionVBO;
+	unsigned int commandBuffer, drawDataBuffer, transformBuffer, previousTransformBuffer;
+	GLsizeiptr commandCapacity, drawDataCapacity, transformCapacity, previousTransformCapacity;
+	bool uploaded;
+
+	StreamBuffer* streamBuffer;
+	// Set when this frame's streams live in streamBuffer
+	bool streamed;
+	StreamRange commandRange, drawDataRange, transformRange, previousTransformRange;
+
+	OffsetAllocator vertexAllocator;
+	OffsetAllocator indexAllocator;
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<DrawData> drawData;
+	std::vector<glm::mat4> transforms;
+	std::vector<glm::mat4> previousTransforms;
+
+	void setupVAO();
+	void setupDepthVAO();
+	void uploadStream(GLenum target, unsigned int buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size);
+	bool uploadToStreamBuffer();
+};
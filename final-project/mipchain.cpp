@@ -0,0 +1,128 @@
+#include "mipchain.h"
+
+// Standard library
+#include <iostream>
+
+// Windows specific
+#include <windows.h>
+
+// Project includes
+#include "stb_image.h"
+
+MipChainFile::MipChainFile() {
+	this->file = nullptr;
+	this->width = 0;
+	this->height = 0;
+	this->mipCount = 0;
+	levelOffset[0] = 0;
+}
+
+MipChainFile::~MipChainFile() {
+	if (file != nullptr) {
+		fclose(file);
+	}
+}
+
+bool MipChainFile::build(const std::string& imagePath, const std::string& outPath) {
+	int imageWidth, imageHeight, nrComponents;
+	unsigned char* pixels = stbi_load(imagePath.c_str(), &imageWidth, &imageHeight, &nrComponents, 4);
+	if (pixels == NULL) {
+		std::cerr << "Texture failed to load at path: " << imagePath << std::endl;
+		return false;
+	}
+
+	CreateDirectoryA("texturecache", NULL);
+	FILE* fp;
+	fopen_s(&fp, outPath.c_str(), "wb");
+	if (fp == NULL) {
+		std::cerr << "Could not write mip chain " << outPath << std::endl;
+		stbi_image_free(pixels);
+		return false;
+	}
+
+	MipChainHeader header;
+	header.magic = MIP_CHAIN_MAGIC;
+	header.width = imageWidth;
+	header.height = imageHeight;
+	header.mipCount = 1;
+	while (header.mipCount < MAX_MIPS && ((imageWidth >> header.mipCount) > 0 || (imageHeight >> header.mipCount) > 0)) {
+		header.mipCount++;
+	}
+	fwrite(&header, sizeof(header), 1, fp);
+
+	std::vector<unsigned char> level(pixels, pixels + 4 * (size_t)imageWidth * imageHeight);
+	stbi_image_free(pixels);
+	int levelWidth = imageWidth;
+	int levelHeight = imageHeight;
+	for (int mip = 0; mip < header.mipCount; mip++) {
+		fwrite(&level[0], 1, level.size(), fp);
+		if (mip + 1 < header.mipCount) {
+			std::vector<unsigned char> next;
+			downsample(level, levelWidth, levelHeight, next);
+			level.swap(next);
+			levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+			levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+void MipChainFile::downsample(const std::vector<unsigned char>& level, int width, int height, std::vector<unsigned char>& next) {
+	int nextWidth = width > 1 ? width / 2 : 1;
+	int nextHeight = height > 1 ? height / 2 : 1;
+	next.resize(4 * (size_t)nextWidth * nextHeight);
+	for (int y = 0; y < nextHeight; y++) {
+		int y0 = 2 * y < height ? 2 * y : height - 1;
+		int y1 = 2 * y + 1 < height ? 2 * y + 1 : height - 1;
+		for (int x = 0; x < nextWidth; x++) {
+			int x0 = 2 * x < width ? 2 * x : width - 1;
+			int x1 = 2 * x + 1 < width ? 2 * x + 1 : width - 1;
+			for (int c = 0; c < 4; c++) {
+				int sum = level[4 * ((size_t)y0 * width + x0) + c] + level[4 * ((size_t)y0 * width + x1) + c] +
+					level[4 * ((size_t)y1 * width + x0) + c] + level[4 * ((size_t)y1 * width + x1) + c];
+				next[4 * ((size_t)y * nextWidth + x) + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+bool MipChainFile::open(const std::string& path) {
+	fopen_s(&file, path.c_str(), "rb");
+	if (file == NULL) {
+		file = nullptr;
+		return false;
+	}
+	MipChainHeader header;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == MIP_CHAIN_MAGIC &&
+		header.width > 0 && header.height > 0 && header.mipCount > 0 && header.mipCount <= MAX_MIPS;
+	if (!valid) {
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+	width = header.width;
+	height = header.height;
+	mipCount = header.mipCount;
+	for (int mip = 0; mip < mipCount; mip++) {
+		levelOffset[mip + 1] = levelOffset[mip] + (long long)getLevelBytes(mip);
+	}
+
+	// A build that was cut short leaves a file without all of its levels
+	_fseeki64(file, 0, SEEK_END);
+	if (_ftelli64(file) < (long long)sizeof(header) + levelOffset[mipCount]) {
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool MipChainFile::readLevel(int mip, unsigned char* out) {
+	if (file == nullptr || mip < 0 || mip >= mipCount) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(fileMutex);
+	_fseeki64(file, sizeof(MipChainHeader) + levelOffset[mip], SEEK_SET);
+	return fread(out, 1, getLevelBytes(mip), file) == getLevelBytes(mip);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdio.h>
+
+// A texture with its whole mip chain computed ahead of time, so any one level can be read on its own
+//   header  MipChainHeader
+//   levels  mip 0 down to 1x1, each tightly packed RGBA8
+class MipChainFile {
+public:
+	static constexpr int MAX_MIPS = 16;
+
+	MipChainFile();
+	~MipChainFile();
+
+	// Decodes the image and writes every level to outPath
+	static bool build(const std::string& imagePath, const std::string& outPath);
+	// Box filters level (width x height RGBA8) into next, at half the size rounded down but at least 1
+	static void downsample(const std::vector<unsigned char>& level, int width, int height, std::vector<unsigned char>& next);
+
+	bool open(const std::string& path);
+	// getLevelBytes(mip) into out, safe to call from several threads
+	bool readLevel(int mip, unsigned char* out);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getMipCount() const { return mipCount; }
+	int getLevelWidth(int mip) const { return (width >> mip) > 0 ? width >> mip : 1; }
+	int getLevelHeight(int mip) const { return (height >> mip) > 0 ? height >> mip : 1; }
+	size_t getLevelBytes(int mip) const { return 4 * (size_t)getLevelWidth(mip) * getLevelHeight(mip); }
+
+	MipChainFile(const MipChainFile&) = delete;
+	MipChainFile& operator=(const MipChainFile&) = delete;
+
+private:
+	struct MipChainHeader {
+		unsigned int magic;
+		int width;
+		int height;
+		int mipCount;
+	};
+	static constexpr unsigned int MIP_CHAIN_MAGIC = 0x5350494D; // "MIPS"
+
+	FILE* file;
+	std::mutex fileMutex;
+	int width, height, mipCount;
+	long long levelOffset[MAX_MIPS + 1]; // byte offset of each level after the header
+};
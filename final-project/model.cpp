@@ -25,47 +25,73 @@ namespace std {
 // Project includes
 #include "shader.h"
 #include "mesh.h"
+#include "texturestreamer.h"
+#include "materiallibrary.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 using namespace std;
 
-std::vector<Texture> Model::textures_loaded;
+std::vector<Model::LoadedTexture> Model::textures_loaded;
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
 
-Model::Model(const char* path, glm::vec3 position, Shader* shader) {
+Model::Model(const char* path, glm::vec3 position, Shader* shader, MeshBuffer* meshBuffer) {
+	this->boundsCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+	this->boundsRadius = 0.0f;
 	this->shaderProgramID = shaderProgramID;
 	this->model = glm::mat4(1.0f);
 	this->model[3][0] = position.x;
 	this->model[3][1] = position.y;
 	this->model[3][2] = position.z;
+	this->previousModel = this->model;
 	this->shader = shader;
+	this->meshBuffer = meshBuffer;
 	loadModel(path);
 }
 
+Model::Model(const Model& prototype, const glm::mat4& transform) {
+	this->model = transform;
+	this->previousModel = transform;
+	this->materials = prototype.materials;
+	this->libraryMaterials = prototype.libraryMaterials;
+	this->libraryMaterial = prototype.libraryMaterial;
+	this->boundsCenter = prototype.boundsCenter;
+	this->boundsRadius = prototype.boundsRadius;
+	this->shaderProgramID = prototype.shaderProgramID;
+	this->shader = prototype.shader;
+	this->meshBuffer = prototype.meshBuffer;
+	this->meshes.reserve(prototype.meshes.size());
+	for (const Mesh& mesh : prototype.meshes) {
+		this->meshes.push_back(mesh.shareGeometry());
+	}
+}
+
 void Model::Draw() {
 	for (int i = 0; i < meshes.size(); i++) {
 		meshes[i].Draw(model);
 	}
 }
 
-void Model::changeMeshMaterials() {
+void Model::Submit(MeshBuffer& meshBuffer, GLuint fallbackMaterial) {
+	// All meshes of the model share one transform entry
+	GLuint transformIndex = meshBuffer.addTransform(model, previousModel);
 	for (int i = 0; i < meshes.size(); i++) {
-		for (int j = 0; j < meshes[i].textures.size(); j++) {
-			if (glm::length(material.Ka) != 0) {
-				meshes[i].textures[j].material.Ka = material.Ka;
-			}
-			if (glm::length(material.Kd) != 0) {
-				meshes[i].textures[j].material.Kd = material.Kd;
-			}
-			if (glm::length(material.Ks) != 0) {
-				meshes[i].textures[j].material.Ks = material.Ks;
-			}
-			if (material.Ns != 0) {
-				meshes[i].textures[j].material.Ns = material.Ns;
-			}
+		GLuint material = fallbackMaterial;
+		if (libraryMaterial != NO_LIBRARY_MATERIAL) {
+			material = libraryMaterial;
+		}
+		else if (meshes[i].materialIndex < libraryMaterials.size()) {
+			material = libraryMaterials[meshes[i].materialIndex];
 		}
+		meshes[i].Submit(meshBuffer, transformIndex, material);
+	}
+}
+
+void Model::registerMaterials(MaterialLibrary& library, GLuint textureSource) {
+	libraryMaterials.clear();
+	for (const Material& material : materials) {
+		libraryMaterials.push_back(library.addMaterial(material, textureSource));
 	}
 }
 
@@ -92,11 +118,88 @@ void Model::loadModel(const char* file_name) {
 	}
 
 	directory = std::string(file_name).substr(0, std::string(file_name).find_last_of('\\/'));
+	meshes.reserve(scene->mNumMeshes);
+	materials.reserve(scene->mNumMaterials);
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+		materials.push_back(loadMaterial(scene->mMaterials[i]));
+	}
 	processNode(scene->mRootNode, scene);
+	computeBounds();
+	computeTexelDensity();
 
 	aiReleaseImport(scene);
 }
 
+void Model::computeBounds() {
+	glm::vec3 minimum = glm::vec3(1e30f, 1e30f, 1e30f);
+	glm::vec3 maximum = glm::vec3(-1e30f, -1e30f, -1e30f);
+	for (const Mesh& mesh : meshes) {
+		for (const Vertex& vertex : mesh.vertices) {
+			minimum = glm::min(minimum, vertex.Position);
+			maximum = glm::max(maximum, vertex.Position);
+		}
+	}
+	if (meshes.empty()) {
+		minimum = maximum = glm::vec3(0.0f, 0.0f, 0.0f);
+	}
+	boundsCenter = (minimum + maximum) * 0.5f;
+	boundsRadius = glm::length(maximum - minimum) * 0.5f;
+}
+
+// Ratio of UV area to surface area of all triangles with the material, as a length
+void Model::computeTexelDensity() {
+	std::vector<float> surfaceArea(materials.size(), 0.0f);
+	std::vector<float> uvArea(materials.size(), 0.0f);
+	for (const Mesh& mesh : meshes) {
+		if (mesh.materialIndex >= materials.size()) {
+			continue;
+		}
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			const Vertex& a = mesh.vertices[mesh.indices[i]];
+			const Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+			const Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+			surfaceArea[mesh.materialIndex] += 0.5f * glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+			glm::vec2 u = b.TextureCoords - a.TextureCoords;
+			glm::vec2 v = c.TextureCoords - a.TextureCoords;
+			uvArea[mesh.materialIndex] += 0.5f * fabs(u.x * v.y - u.y * v.x);
+		}
+	}
+	for (size_t i = 0; i < materials.size(); i++) {
+		if (surfaceArea[i] > 0.0f) {
+			materials[i].uvDensity = sqrt(uvArea[i] / surfaceArea[i]);
+		}
+	}
+}
+
+void Model::requestTextures(TextureStreamer& streamer, const glm::mat4& view, const glm::mat4& proj, int viewportHeight) const {
+	glm::vec3 center;
+	float radius;
+	getWorldBounds(center, radius);
+	// The nearest point of the bounds sets the level for the whole model
+	float distance = glm::max(-(view * glm::vec4(center, 1.0f)).z - radius, 0.1f);
+	float scale = boundsRadius > 0.0f ? radius / boundsRadius : 1.0f;
+	// World space size of one pixel at that distance
+	float pixelSize = 2.0f * distance / (proj[1][1] * (float)viewportHeight);
+
+	for (const Mesh& mesh : meshes) {
+		float uvDensity = mesh.materialIndex < materials.size() ? materials[mesh.materialIndex].uvDensity : 1.0f;
+		for (const Texture& texture : mesh.textures) {
+			streamer.request(texture.id, uvDensity * pixelSize / scale);
+		}
+	}
+}
+
+void Model::getWorldBounds(glm::vec3& center, float& radius) const {
+	center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+	// Conservative for non-uniform scale: use the largest axis scale
+	float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	radius = boundsRadius * scale;
+}
+
+Model* Model::createInstance(const glm::mat4& transform, Pool<Model>& pool) const {
+	return pool.create(*this, transform);
+}
+
 void Model::processNode(aiNode* node, const aiScene* scene) {
 		
 	for (unsigned int m_i = 0; m_i < node->mNumMeshes; m_i++) {
@@ -113,9 +216,12 @@ void Model::processNode(aiNode* node, const aiScene* scene) {
 
 Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
 		
+	// Built once at their final size and moved into the Mesh, never copied
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
+	vertices.reserve(mesh->mNumVertices);
+	indices.reserve((size_t)mesh->mNumFaces * 3);
 
 	for (unsigned int v_i = 0; v_i < mesh->mNumVertices; v_i++) {
 		Vertex vertex;
@@ -153,79 +259,93 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
 		}
 	}
 
-	if (mesh->mMaterialIndex >= 0) {
-		Material textureMaterial;
-		aiColor3D color;
-
+	if (mesh->mMaterialIndex < materials.size()) {
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-		// Extract ambient, diffuse, and specular colors from the mtl file
-		if (AI_SUCCESS == material->Get(AI_MATKEY_COLOR_AMBIENT, color)) {
-			textureMaterial.Ka = glm::vec3(color.r, color.g, color.b);
-		}
-		else {
-			textureMaterial.Ka = glm::vec3(1.0f, 1.0f, 1.0f);
-		}
+		loadMaterialTextures(material, aiTextureType_DIFFUSE, TEXTURE_DIFFUSE, textures);
+		loadMaterialTextures(material, aiTextureType_SPECULAR, TEXTURE_SPECULAR, textures);
 
-		if (AI_SUCCESS == material->Get(AI_MATKEY_COLOR_DIFFUSE, color)) {
-			textureMaterial.Kd = glm::vec3(color.r, color.g, color.b);
-		}
-		else {
-			textureMaterial.Kd = glm::vec3(0.8f, 0.8f, 0.8f);
+		size_t beforeNormals = textures.size();
+		loadMaterialTextures(material, aiTextureType_NORMALS, TEXTURE_NORMAL, textures);
+		if (textures.size() == beforeNormals) {
+			loadMaterialTextures(material, aiTextureType_HEIGHT, TEXTURE_NORMAL, textures);
 		}
+	}
+	else {
+		std::cout << "NO MATERIAL INFO";
+	}
+	std::cout << "Faces done" << "\n";
 
-		if (AI_SUCCESS == material->Get(AI_MATKEY_COLOR_SPECULAR, color)) {
-			textureMaterial.Ks = glm::vec3(color.r, color.g, color.b);
-		}
-		else {
-			textureMaterial.Ks = glm::vec3(0.1f, 0.1f, 0.1f);
-		}
-		float shininess;
-		if (AI_SUCCESS == material->Get(AI_MATKEY_SHININESS, shininess)) {
-			textureMaterial.Ns = shininess;
-		}
-		else {
-			textureMaterial.Ns = 40.0f;
-		}
-		std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		for (Texture& a : diffuseMaps) {
-			a.material = textureMaterial;
-		}
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+	return Mesh(std::move(vertices), std::move(indices), std::move(textures), shader, meshBuffer, mesh->mMaterialIndex < materials.size() ? mesh->mMaterialIndex : 0);
+}
 
-		std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		for (Texture& a : specularMaps) {
-			a.material = textureMaterial;
-		}
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+Material Model::loadMaterial(aiMaterial* material) {
+	Material result;
+	aiColor3D color;
 
-		std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
-		if (normalMaps.empty()) {
-			normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-		}
-		for (Texture& a : normalMaps) {
-			a.material = textureMaterial;
-		}
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+	// Extract ambient, diffuse, and specular colors from the mtl file
+	if (AI_SUCCESS == material->Get(AI_MATKEY_COLOR_AMBIENT, color)) {
+		result.Ka = glm::vec3(color.r, color.g, color.b);
 	}
 	else {
-		std::cout << "NO MATERIAL INFO";
+		result.Ka = glm::vec3(1.0f, 1.0f, 1.0f);
 	}
-	std::cout << "Faces done" << "\n";
 
-	return Mesh(vertices, indices, textures, shader);
+	if (AI_SUCCESS == material->Get(AI_MATKEY_COLOR_DIFFUSE, color)) {
+		result.Kd = glm::vec3(color.r, color.g, color.b);
+	}
+	else {
+		result.Kd = glm::vec3(0.8f, 0.8f, 0.8f);
+	}
+
+	if (AI_SUCCESS == material->Get(AI_MATKEY_COLOR_SPECULAR, color)) {
+		result.Ks = glm::vec3(color.r, color.g, color.b);
+	}
+	else {
+		result.Ks = glm::vec3(0.1f, 0.1f, 0.1f);
+	}
+	float shininess;
+	if (AI_SUCCESS == material->Get(AI_MATKEY_SHININESS, shininess)) {
+		result.Ns = shininess;
+	}
+	else {
+		result.Ns = 40.0f;
+	}
+
+	// Metallic-roughness terms: glTF has them directly and assimp maps the MTL PBR extension (Pm, Pr, Ke)
+	// onto the same keys. Files without them get a dielectric with the roughness matching Ns
+	aiColor4D baseColor;
+	if (AI_SUCCESS == material->Get(AI_MATKEY_BASE_COLOR, baseColor)) {
+		result.Kd = glm::vec3(baseColor.r, baseColor.g, baseColor.b);
+	}
+	float metallic;
+	if (AI_SUCCESS == material->Get(AI_MATKEY_METALLIC_FACTOR, metallic)) {
+		result.metallic = metallic;
+	}
+	float roughness;
+	if (AI_SUCCESS == material->Get(AI_MATKEY_ROUGHNESS_FACTOR, roughness)) {
+		result.roughness = roughness;
+	}
+	else {
+		result.roughness = glm::clamp(sqrt(2.0f / (result.Ns + 2.0f)), 0.0f, 1.0f);
+	}
+	if (AI_SUCCESS == material->Get(AI_MATKEY_COLOR_EMISSIVE, color)) {
+		result.emissive = glm::vec3(color.r, color.g, color.b);
+	}
+	return result;
 }
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
-	std::vector<Texture> textures;
+void Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureSlot slot, std::vector<Texture>& textures) {
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
 		aiString str;
 		mat->GetTexture(type, i, &str);
 		bool skip = false;
 		for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-			std::cout << textures_loaded[j].path.C_Str() << ", " << str.C_Str() << std::endl;
-			if (std::strcmp(textures_loaded[j].path.C_Str(), str.C_Str()) == 0) {
-				textures.push_back(textures_loaded[j]);
+			std::cout << textures_loaded[j].path << ", " << str.C_Str() << std::endl;
+			if (textures_loaded[j].path == str.C_Str()) {
+				Texture texture = textures_loaded[j].texture;
+				texture.slot = slot;
+				textures.push_back(texture);
 				skip = true;
 				break;
 			}
@@ -233,13 +353,15 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType
 		if (!skip) {
 			Texture texture;
 			texture.id = TextureFromFile(str.C_Str(), directory);
-			texture.type = typeName;
-			texture.path = str;
+			texture.slot = slot;
 			textures.push_back(texture);
-			textures_loaded.push_back(texture);
+
+			LoadedTexture loaded;
+			loaded.path = str.C_Str();
+			loaded.texture = texture;
+			textures_loaded.push_back(loaded);
 		}
 	}
-	return textures;
 }
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma) {
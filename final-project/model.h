@@ -17,6 +17,8 @@ struct aiScene;
 struct aiMesh;
 struct aiMaterial;
 enum aiTextureType;
+class TextureStreamer;
+class MaterialLibrary;
 
 // Only needed for declarations
 typedef unsigned int GLuint;
@@ -24,27 +26,66 @@ typedef unsigned int GLuint;
 // Project includes - needed for definitions
 #include "mesh.h"  // Added for Texture struct
 #include "shader.h"
+#include "allocator.h"
 
 class Model {
 public:
 	glm::mat4 model;
-	Material material;
+	// model as it was drawn last frame, for motion vectors
+	glm::mat4 previousModel;
 	std::vector<Mesh> meshes;
 
-	Model(const char* path, glm::vec3 position, Shader* shader);
+	// One entry per material in the file, meshes refer to it by Mesh::materialIndex
+	std::vector<Material> materials;
+
+	// Material library entry of each of materials, filled by registerMaterials()
+	std::vector<GLuint> libraryMaterials;
+	// Overrides libraryMaterials for every mesh when set
+	static constexpr GLuint NO_LIBRARY_MATERIAL = 0xFFFFFFFFu;
+	GLuint libraryMaterial = NO_LIBRARY_MATERIAL;
+
+	// Bounding sphere of all meshes in model space
+	glm::vec3 boundsCenter;
+	float boundsRadius;
+
+	Model(const char* path, glm::vec3 position, Shader* shader, MeshBuffer* meshBuffer = nullptr);
 	void Draw();
+	// Each mesh with the library entry of its material, fallbackMaterial when the model has none registered
+	void Submit(MeshBuffer& meshBuffer, GLuint fallbackMaterial);
 	void translate(glm::vec3 offset);
 	void rotate(glm::vec3 offset);
-	void changeMeshMaterials();
+	// Adds an entry per material to library, with the parameters from the file and the textures of textureSource
+	void registerMaterials(MaterialLibrary& library, GLuint textureSource);
+	void getWorldBounds(glm::vec3& center, float& radius) const;
+	// Tells streamer how finely each mesh's textures are seen from view, from the material's UV density and
+	// the distance to the bounding sphere
+	void requestTextures(TextureStreamer& streamer, const glm::mat4& view, const glm::mat4& proj, int viewportHeight) const;
+	// Another placement of the same geometry, created in pool. The instance keeps no CPU side vertices and
+	// must not outlive this model; release it with pool.destroy()
+	Model* createInstance(const glm::mat4& transform, Pool<Model>& pool) const;
+	// Call once the frame is drawn so the next frame's motion is relative to this one
+	void endFrame() { previousModel = model; }
 
 private:
-	
+	friend class Pool<Model>;
+
+	// Textures loaded so far, by the path in the material, so meshes naming the same file share one
+	struct LoadedTexture {
+		std::string path;
+		Texture texture;
+	};
+
 	std::string directory;
-	static std::vector<Texture> textures_loaded;
+	static std::vector<LoadedTexture> textures_loaded;
 	GLuint shaderProgramID;
 	Shader* shader;
+	MeshBuffer* meshBuffer;
+	Model(const Model& prototype, const glm::mat4& transform);
 	void loadModel(const char* file_name);
 	void processNode(aiNode* node, const aiScene* scene);
+	void computeBounds();
+	void computeTexelDensity();
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-	std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+	Material loadMaterial(aiMaterial* material);
+	void loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureSlot slot, std::vector<Texture>& textures);
 };
\ No newline at end of file
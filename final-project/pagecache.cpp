@@ -0,0 +1,129 @@
+#include "pagecache.h"
+
+PageCache::PageCache(int slotCount) {
+	this->head = -1;
+	this->tail = -1;
+	this->hits = 0;
+	this->misses = 0;
+	this->evictions = 0;
+
+	// Every slot starts empty on the LRU list, so the free ones are handed out before anything is evicted
+	slots.resize(slotCount);
+	lookup.reserve(slotCount);
+	for (int i = 0; i < slotCount; i++) {
+		slots[i].key = INVALID_KEY;
+		slots[i].lastUsed = 0;
+		slots[i].pinned = false;
+		slots[i].previous = slots[i].next = -1;
+		pushFront(i);
+	}
+}
+
+int PageCache::find(unsigned int key) const {
+	auto found = lookup.find(key);
+	return found != lookup.end() ? found->second : -1;
+}
+
+int PageCache::touch(unsigned int key, unsigned long long frame) {
+	int slot = find(key);
+	if (slot < 0) {
+		misses++;
+		return -1;
+	}
+	hits++;
+	use(slot, frame);
+	return slot;
+}
+
+void PageCache::use(int slot, unsigned long long frame) {
+	slots[slot].lastUsed = frame;
+	if (!slots[slot].pinned) {
+		unlink(slot);
+		pushFront(slot);
+	}
+}
+
+int PageCache::allocate(unsigned int key, unsigned long long frame, unsigned int& evicted) {
+	evicted = INVALID_KEY;
+	int slot = tail;
+	if (slot < 0 || (slots[slot].key != INVALID_KEY && slots[slot].lastUsed == frame)) {
+		return -1;
+	}
+
+	if (slots[slot].key != INVALID_KEY) {
+		evicted = slots[slot].key;
+		lookup.erase(evicted);
+		evictions++;
+	}
+	slots[slot].key = key;
+	slots[slot].lastUsed = frame;
+	lookup[key] = slot;
+	unlink(slot);
+	pushFront(slot);
+	return slot;
+}
+
+void PageCache::pin(int slot) {
+	if (slot < 0 || slots[slot].pinned) {
+		return;
+	}
+	unlink(slot);
+	slots[slot].pinned = true;
+}
+
+bool PageCache::validate() const {
+	for (const auto& entry : lookup) {
+		if (entry.second < 0 || entry.second >= (int)slots.size() || slots[entry.second].key != entry.first) {
+			return false;
+		}
+	}
+
+	// The list runs from most to least recently used and holds every unpinned slot exactly once
+	int listed = 0;
+	unsigned long long previousUse = ~0ull;
+	for (int slot = head; slot >= 0; slot = slots[slot].next) {
+		if (slots[slot].pinned || ++listed > (int)slots.size()) {
+			return false;
+		}
+		// Empty slots sit at the back with lastUsed 0, so the order holds for them too
+		if (slots[slot].lastUsed > previousUse) {
+			return false;
+		}
+		previousUse = slots[slot].lastUsed;
+	}
+	int unpinned = 0;
+	for (const Slot& slot : slots) {
+		unpinned += slot.pinned ? 0 : 1;
+	}
+	return listed == unpinned;
+}
+
+void PageCache::unlink(int slot) {
+	Slot& entry = slots[slot];
+	if (entry.previous >= 0) {
+		slots[entry.previous].next = entry.next;
+	}
+	else {
+		head = entry.next;
+	}
+	if (entry.next >= 0) {
+		slots[entry.next].previous = entry.previous;
+	}
+	else {
+		tail = entry.previous;
+	}
+	entry.previous = entry.next = -1;
+}
+
+void PageCache::pushFront(int slot) {
+	Slot& entry = slots[slot];
+	entry.previous = -1;
+	entry.next = head;
+	if (head >= 0) {
+		slots[head].previous = slot;
+	}
+	head = slot;
+	if (tail < 0) {
+		tail = slot;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Standard library
+#include <vector>
+#include <unordered_map>
+
+// One page of one virtual texture: x in bits 0-9, y in 10-19, mip in 20-23, texture in 24-31
+inline unsigned int makePageKey(unsigned int texture, unsigned int mip, unsigned int x, unsigned int y) {
+	return (texture << 24) | (mip << 20) | (y << 10) | x;
+}
+inline unsigned int pageKeyTexture(unsigned int key) { return key >> 24; }
+inline unsigned int pageKeyMip(unsigned int key) { return (key >> 20) & 0xF; }
+inline unsigned int pageKeyY(unsigned int key) { return (key >> 10) & 0x3FF; }
+inline unsigned int pageKeyX(unsigned int key) { return key & 0x3FF; }
+
+// Which page sits in which slot of the physical page cache, and which one to replace next. Least recently
+// used pages are evicted first, but never one that was used in the current frame (that would only swap two
+// visible pages back and forth) and never a pinned one, so the coarsest mip of every texture stays resident
+// for the shader to fall back on. Plain CPU bookkeeping with no GL, so it can be simulated on its own
+class PageCache {
+public:
+	static constexpr unsigned int INVALID_KEY = 0xFFFFFFFFu;
+
+	PageCache(int slotCount);
+
+	// Slot holding key, or -1. touch() also marks it as used in frame
+	int find(unsigned int key) const;
+	int touch(unsigned int key, unsigned long long frame);
+	// Marks a slot as used without counting a hit, for pages that are sampled in place of a missing one
+	void use(int slot, unsigned long long frame);
+
+	// Slot for a page about to be uploaded, replacing the least recently used one; evicted receives the page
+	// that was there, or INVALID_KEY. -1 when every slot is pinned or in use this frame
+	int allocate(unsigned int key, unsigned long long frame, unsigned int& evicted);
+	// Pinned slots are never evicted
+	void pin(int slot);
+
+	int getSlotCount() const { return (int)slots.size(); }
+	int getResidentCount() const { return (int)lookup.size(); }
+	unsigned long long getHits() const { return hits; }
+	unsigned long long getMisses() const { return misses; }
+	unsigned long long getEvictions() const { return evictions; }
+	// Checks the lookup against the slots and the LRU list, for the simulation
+	bool validate() const;
+
+private:
+	struct Slot {
+		unsigned int key;
+		unsigned long long lastUsed;
+		int previous, next; // LRU list, head is the most recently used
+		bool pinned;
+	};
+
+	std::vector<Slot> slots;
+	std::unordered_map<unsigned int, int> lookup;
+	int head, tail;
+
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+
+	void unlink(int slot);
+	void pushFront(int slot);
+};
@@ -0,0 +1,206 @@
+#include "postprocess.h"
+
+// Standard library
+#include <iostream>
+#include <math.h>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+PostProcessChain::PostProcessChain(int width, int height, ShaderWatcher* watcher, Profiler* profiler) {
+	this->profiler = profiler;
+	this->width = width;
+	this->height = height;
+
+	downsampleShader = new Shader("deferredVertexShader.txt", "bloomDownsampleFragmentShader.txt");
+	upsampleShader = new Shader("deferredVertexShader.txt", "bloomUpsampleFragmentShader.txt");
+	toneMapShader = new Shader("deferredVertexShader.txt", "toneMapFragmentShader.txt");
+	if (watcher != nullptr) {
+		watcher->watch(downsampleShader);
+		watcher->watch(upsampleShader);
+		watcher->watch(toneMapShader);
+	}
+	histogramShader = new ComputeShader("histogramComputeShader.txt");
+	exposureShader = new ComputeShader("exposureComputeShader.txt");
+
+	glGenFramebuffers(1, &framebuffer);
+	glGenVertexArrays(1, &emptyVAO);
+
+	// The histogram starts cleared and the exposure shader clears it again after reading it
+	GLuint zeroes[HISTOGRAM_BINS] = { 0 };
+	glGenBuffers(1, &histogramBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, histogramBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zeroes), zeroes, GL_DYNAMIC_COPY);
+
+	// (adapted luminance, exposure), starting at mid grey so the first frames are not blown out
+	float exposure[2] = { 0.18f, 1.0f };
+	glGenBuffers(1, &exposureBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, exposureBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(exposure), exposure, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	createTargets();
+}
+
+PostProcessChain::~PostProcessChain() {
+	deleteTargets();
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteVertexArrays(1, &emptyVAO);
+	GLuint buffers[2] = { histogramBuffer, exposureBuffer };
+	glDeleteBuffers(2, buffers);
+	delete downsampleShader;
+	delete upsampleShader;
+	delete toneMapShader;
+	delete histogramShader;
+	delete exposureShader;
+}
+
+const char* PostProcessChain::getPassName(int pass) {
+	static const char* names[POST_PASS_COUNT] = { "Bloom", "Auto exposure", "Tone map" };
+	return names[pass];
+}
+
+void PostProcessChain::createTargets() {
+	// Level 0 is half resolution, every level after it half of the one before
+	glGenTextures(BLOOM_LEVELS, bloomTextures);
+	int levelWidth = width, levelHeight = height;
+	for (int i = 0; i < BLOOM_LEVELS; i++) {
+		levelWidth = levelWidth / 2 > 1 ? levelWidth / 2 : 1;
+		levelHeight = levelHeight / 2 > 1 ? levelHeight / 2 : 1;
+		bloomWidths[i] = levelWidth;
+		bloomHeights[i] = levelHeight;
+
+		glBindTexture(GL_TEXTURE_2D, bloomTextures[i]);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_R11F_G11F_B10F, levelWidth, levelHeight);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void PostProcessChain::deleteTargets() {
+	glDeleteTextures(BLOOM_LEVELS, bloomTextures);
+}
+
+void PostProcessChain::resize(int width, int height) {
+	if (width == this->width && height == this->height) {
+		return;
+	}
+	this->width = width;
+	this->height = height;
+	deleteTargets();
+	createTargets();
+}
+
+void PostProcessChain::drawFullscreen() {
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+}
+
+void PostProcessChain::render(SceneTarget& scene, float deltaTime) {
+	resize(scene.getWidth(), scene.getHeight());
+	ProfileScope scope(profiler, "Post processing");
+	glDisable(GL_DEPTH_TEST);
+
+	if (enabled[POST_BLOOM]) {
+		ProfileScope passScope(profiler, getPassName(POST_BLOOM));
+		renderBloom(scene);
+	}
+	if (enabled[POST_AUTO_EXPOSURE] && histogramShader->isValid() && exposureShader->isValid()) {
+		ProfileScope passScope(profiler, getPassName(POST_AUTO_EXPOSURE));
+		renderAutoExposure(scene, deltaTime);
+	}
+	if (enabled[POST_TONE_MAP]) {
+		ProfileScope passScope(profiler, getPassName(POST_TONE_MAP));
+		renderToneMap(scene);
+	}
+	else {
+		scene.blitToScreen();
+	}
+
+	glEnable(GL_DEPTH_TEST);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void PostProcessChain::renderBloom(SceneTarget& scene) {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	// Down the pyramid, the first step also keeps only what is above the threshold
+	downsampleShader->use();
+	downsampleShader->setFloat("threshold", bloomThreshold);
+	downsampleShader->setFloat("knee", bloomKnee);
+	glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+	for (int i = 0; i < BLOOM_LEVELS; i++) {
+		int sourceWidth = i == 0 ? scene.getWidth() : bloomWidths[i - 1];
+		int sourceHeight = i == 0 ? scene.getHeight() : bloomHeights[i - 1];
+		glBindTexture(GL_TEXTURE_2D, i == 0 ? scene.getColorTexture() : bloomTextures[i - 1]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTextures[i], 0);
+		glViewport(0, 0, bloomWidths[i], bloomHeights[i]);
+		downsampleShader->setBool("firstLevel", i == 0);
+		glUniform2f(glGetUniformLocation(downsampleShader->ID, "sourceTexel"), 1.0f / sourceWidth, 1.0f / sourceHeight);
+		glUniform2f(glGetUniformLocation(downsampleShader->ID, "outputTexel"), 1.0f / bloomWidths[i], 1.0f / bloomHeights[i]);
+		drawFullscreen();
+	}
+
+	// Back up, each level blurred and added onto the next larger one
+	upsampleShader->use();
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	for (int i = BLOOM_LEVELS - 1; i > 0; i--) {
+		glBindTexture(GL_TEXTURE_2D, bloomTextures[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTextures[i - 1], 0);
+		glViewport(0, 0, bloomWidths[i - 1], bloomHeights[i - 1]);
+		glUniform2f(glGetUniformLocation(upsampleShader->ID, "sourceTexel"), 1.0f / bloomWidths[i], 1.0f / bloomHeights[i]);
+		glUniform2f(glGetUniformLocation(upsampleShader->ID, "outputTexel"), 1.0f / bloomWidths[i - 1], 1.0f / bloomHeights[i - 1]);
+		drawFullscreen();
+	}
+	glDisable(GL_BLEND);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PostProcessChain::renderAutoExposure(SceneTarget& scene, float deltaTime) {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HISTOGRAM_BINDING, histogramBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EXPOSURE_BINDING, exposureBuffer);
+	glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, scene.getColorTexture());
+
+	float range = maxLogLuminance - minLogLuminance;
+	histogramShader->use();
+	histogramShader->setFloat("minLogLuminance", minLogLuminance);
+	histogramShader->setFloat("inverseLogLuminanceRange", 1.0f / range);
+	histogramShader->dispatch((scene.getWidth() + 15) / 16, (scene.getHeight() + 15) / 16);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// Exponential ease, frame rate independent
+	exposureShader->use();
+	exposureShader->setFloat("minLogLuminance", minLogLuminance);
+	exposureShader->setFloat("logLuminanceRange", range);
+	exposureShader->setFloat("pixelCount", (float)scene.getWidth() * scene.getHeight());
+	exposureShader->setFloat("adaptation", 1.0f - expf(-deltaTime * adaptationSpeed));
+	exposureShader->setFloat("exposureCompensation", exposureCompensation);
+	exposureShader->dispatch(1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void PostProcessChain::renderToneMap(SceneTarget& scene) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, scene.getWidth(), scene.getHeight());
+
+	toneMapShader->use();
+	glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, scene.getColorTexture());
+	glActiveTexture(GL_TEXTURE0 + BLOOM_UNIT);
+	glBindTexture(GL_TEXTURE_2D, bloomTextures[0]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EXPOSURE_BINDING, exposureBuffer);
+
+	toneMapShader->setBool("bloomEnabled", enabled[POST_BLOOM]);
+	toneMapShader->setFloat("bloomIntensity", bloomIntensity);
+	toneMapShader->setBool("autoExposure", enabled[POST_AUTO_EXPOSURE] && histogramShader->isValid() && exposureShader->isValid());
+	toneMapShader->setFloat("manualExposure", manualExposure * powf(2.0f, exposureCompensation));
+	toneMapShader->setInt("toneMapOperator", toneMapOperator);
+	drawFullscreen();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "shaderwatcher.h"
+#include "computeshader.h"
+#include "scenetarget.h"
+#include "profiler.h"
+
+// Passes of the chain in the order they run, each can be switched off on its own
+enum PostPass {
+	POST_BLOOM = 0,
+	POST_AUTO_EXPOSURE = 1,
+	POST_TONE_MAP = 2,
+	POST_PASS_COUNT = 3
+};
+
+enum ToneMapOperator {
+	TONE_MAP_ACES = 0,
+	TONE_MAP_FILMIC = 1
+};
+
+// Resolves the HDR SceneTarget into the default framebuffer:
+//   bloom          dual filter pyramid, thresholded downsample then tent upsample added back up the chain
+//   auto exposure  compute histogram of log luminance, averaged and eased towards on the GPU, no readback
+//   tone map       exposure, bloom composite and ACES or filmic curve in one fullscreen pass
+// With the tone map pass off the HDR colour is copied out clamped
+class PostProcessChain {
+public:
+	static constexpr int BLOOM_LEVELS = 6;
+
+	// Texture units of the fullscreen passes and SSBOs of the exposure compute shaders
+	static constexpr GLuint SOURCE_UNIT = 0;
+	static constexpr GLuint BLOOM_UNIT = 1;
+	static constexpr GLuint HISTOGRAM_BINDING = 6;
+	static constexpr GLuint EXPOSURE_BINDING = 7;
+	static constexpr int HISTOGRAM_BINS = 256;
+
+	bool enabled[POST_PASS_COUNT] = { true, true, true };
+	int toneMapOperator = TONE_MAP_ACES;
+
+	float bloomThreshold = 1.0f;
+	float bloomKnee = 0.5f;
+	float bloomIntensity = 0.3f;
+
+	// Exposure is key / average luminance, shifted by compensation stops
+	float exposureCompensation = 0.0f;
+	float manualExposure = 1.0f;
+	float adaptationSpeed = 1.5f;
+	float minLogLuminance = -8.0f;
+	float maxLogLuminance = 4.0f;
+
+	PostProcessChain(int width, int height, ShaderWatcher* watcher = nullptr, Profiler* profiler = nullptr);
+	~PostProcessChain();
+
+	// Reallocates the bloom pyramid when the window size changed
+	void resize(int width, int height);
+
+	// Runs the enabled passes and leaves the default framebuffer bound
+	void render(SceneTarget& scene, float deltaTime);
+
+	static const char* getPassName(int pass);
+	double getPassMilliseconds(int pass) const { return profiler != nullptr ? profiler->getGpuMilliseconds(getPassName(pass)) : 0.0; }
+
+private:
+	int width, height;
+	GLuint framebuffer;
+	GLuint bloomTextures[BLOOM_LEVELS];
+	int bloomWidths[BLOOM_LEVELS], bloomHeights[BLOOM_LEVELS];
+	GLuint histogramBuffer, exposureBuffer;
+	GLuint emptyVAO;
+
+	Shader* downsampleShader;
+	Shader* upsampleShader;
+	Shader* toneMapShader;
+	ComputeShader* histogramShader;
+	ComputeShader* exposureShader;
+
+	Profiler* profiler;
+
+	void createTargets();
+	void deleteTargets();
+	void drawFullscreen();
+
+	void renderBloom(SceneTarget& scene);
+	void renderAutoExposure(SceneTarget& scene, float deltaTime);
+	void renderToneMap(SceneTarget& scene);
+};
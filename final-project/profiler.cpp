@@ -0,0 +1,256 @@
+#include "profiler.h"
+
+// Standard library
+#include <iostream>
+#include <stdio.h>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+// Project includes
+#include "imgui.h"
+
+Profiler::Profiler() {
+	this->epoch = std::chrono::high_resolution_clock::now();
+	this->current = 0;
+	this->inFrame = false;
+	this->droppedFrames = 0;
+	this->captureFrames = 0;
+	for (int i = 0; i < FRAME_COUNT; i++) {
+		frames[i].pending = false;
+		frames[i].cpuStart = 0.0;
+		frames[i].gpuStart = 0;
+	}
+}
+
+Profiler::~Profiler() {
+	for (int i = 0; i < FRAME_COUNT; i++) {
+		if (!frames[i].queries.empty()) {
+			glDeleteQueries((GLsizei)frames[i].queries.size(), &frames[i].queries[0]);
+		}
+	}
+}
+
+double Profiler::now() const {
+	return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - epoch).count();
+}
+
+void Profiler::beginFrame() {
+	collect();
+
+	current = (current + 1) % FRAME_COUNT;
+	Frame& frame = frames[current];
+	if (frame.pending) {
+		// The GPU is more than FRAME_COUNT frames behind, reuse the queries and lose that frame
+		frame.pending = false;
+		droppedFrames++;
+	}
+	frame.markers.clear();
+	frame.cpuStart = now();
+	glGetInteger64v(GL_TIMESTAMP, &frame.gpuStart);
+
+	stack.clear();
+	inFrame = true;
+	begin("Frame");
+}
+
+void Profiler::endFrame() {
+	if (!inFrame) {
+		return;
+	}
+	while (!stack.empty()) {
+		end(stack.back());
+	}
+	frames[current].pending = true;
+	inFrame = false;
+}
+
+int Profiler::begin(const char* name) {
+	if (!inFrame) {
+		return -1;
+	}
+	Frame& frame = frames[current];
+	int marker = (int)frame.markers.size();
+	if (frame.queries.size() < (size_t)(marker + 1) * 2) {
+		size_t previous = frame.queries.size();
+		frame.queries.resize(previous + 32);
+		glGenQueries(32, &frame.queries[previous]);
+	}
+
+	Marker entry;
+	entry.name = name;
+	entry.depth = (int)stack.size();
+	entry.cpuBegin = now();
+	entry.cpuEnd = entry.cpuBegin;
+	frame.markers.push_back(entry);
+	stack.push_back(marker);
+
+	glQueryCounter(frame.queries[marker * 2], GL_TIMESTAMP);
+	return marker;
+}
+
+void Profiler::end(int marker) {
+	if (!inFrame || marker < 0) {
+		return;
+	}
+	Frame& frame = frames[current];
+	glQueryCounter(frame.queries[marker * 2 + 1], GL_TIMESTAMP);
+	frame.markers[marker].cpuEnd = now();
+	if (!stack.empty() && stack.back() == marker) {
+		stack.pop_back();
+	}
+}
+
+void Profiler::collect() {
+	// Oldest frame first, a frame can only finish after the ones before it
+	for (int i = 1; i <= FRAME_COUNT; i++) {
+		Frame& frame = frames[(current + i) % FRAME_COUNT];
+		if (!frame.pending) {
+			continue;
+		}
+		// The end of the frame marker is the last timestamp the frame wrote
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			break;
+		}
+		resolveFrame(frame);
+		frame.pending = false;
+	}
+}
+
+void Profiler::resolveFrame(Frame& frame) {
+	std::vector<PassTiming>& timings = resolved;
+	size_t timingCount = 0;
+	for (size_t i = 0; i < frame.markers.size(); i++) {
+		const Marker& marker = frame.markers[i];
+		GLuint64 gpuBegin = 0, gpuEnd = 0;
+		glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &gpuBegin);
+		glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &gpuEnd);
+		double cpuMilliseconds = (marker.cpuEnd - marker.cpuBegin) / 1000.0;
+		double gpuMilliseconds = (double)(gpuEnd - gpuBegin) / 1000000.0;
+
+		if (captureFrames > 0) {
+			TraceEvent cpu = { marker.name, 0, marker.cpuBegin, marker.cpuEnd - marker.cpuBegin };
+			TraceEvent gpu = { marker.name, 1, frame.cpuStart + (double)((GLint64)gpuBegin - frame.gpuStart) / 1000.0, gpuMilliseconds * 1000.0 };
+			traceEvents.push_back(cpu);
+			traceEvents.push_back(gpu);
+		}
+
+		bool found = false;
+		for (size_t t = 0; t < timingCount; t++) {
+			PassTiming& timing = timings[t];
+			if (timing.name == marker.name) {
+				timing.cpuMilliseconds += cpuMilliseconds;
+				timing.gpuMilliseconds += gpuMilliseconds;
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			if (timingCount == timings.size()) {
+				timings.push_back(PassTiming());
+			}
+			PassTiming& timing = timings[timingCount++];
+			timing.name.assign(marker.name);
+			timing.depth = marker.depth;
+			timing.cpuMilliseconds = cpuMilliseconds;
+			timing.gpuMilliseconds = gpuMilliseconds;
+		}
+	}
+	timings.resize(timingCount);
+
+	// Carry the averages over by name, passes that just appeared start from their first value
+	for (PassTiming& timing : timings) {
+		timing.cpuAverage = timing.cpuMilliseconds;
+		timing.gpuAverage = timing.gpuMilliseconds;
+		for (const PassTiming& previous : passes) {
+			if (previous.name == timing.name) {
+				timing.cpuAverage = previous.cpuAverage * 0.9 + timing.cpuMilliseconds * 0.1;
+				timing.gpuAverage = previous.gpuAverage * 0.9 + timing.gpuMilliseconds * 0.1;
+				break;
+			}
+		}
+	}
+	passes.swap(timings);
+
+	if (captureFrames > 0 && --captureFrames == 0) {
+		writeTrace();
+	}
+}
+
+double Profiler::getCpuMilliseconds(const char* name) const {
+	for (const PassTiming& timing : passes) {
+		if (timing.name == name) {
+			return timing.cpuMilliseconds;
+		}
+	}
+	return 0.0;
+}
+
+double Profiler::getGpuMilliseconds(const char* name) const {
+	for (const PassTiming& timing : passes) {
+		if (timing.name == name) {
+			return timing.gpuMilliseconds;
+		}
+	}
+	return 0.0;
+}
+
+void Profiler::captureTrace(const std::string& path, int frameCount) {
+	capturePath = path;
+	captureFrames = frameCount;
+	traceEvents.clear();
+}
+
+void Profiler::writeTrace() {
+	FILE* file = nullptr;
+	if (fopen_s(&file, capturePath.c_str(), "w") != 0 || file == nullptr) {
+		std::cerr << "Profiler: could not write trace to " << capturePath << std::endl;
+		traceEvents.clear();
+		return;
+	}
+
+	const char* tracks[2] = { "CPU", "GPU" };
+	fprintf(file, "{\"traceEvents\":[\n");
+	for (int track = 0; track < 2; track++) {
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", track + 1, tracks[track]);
+	}
+	for (size_t i = 0; i < traceEvents.size(); i++) {
+		const TraceEvent& event = traceEvents[i];
+		fprintf(file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+			event.name, tracks[event.track], event.track + 1, event.start, event.duration, i + 1 < traceEvents.size() ? "," : "");
+	}
+	fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(file);
+
+	std::cout << "Profiler: wrote " << traceEvents.size() << " events to " << capturePath << std::endl;
+	traceEvents.clear();
+}
+
+void Profiler::drawOverlay(bool* open) {
+	ImGui::SetNextWindowBgAlpha(0.8f);
+	if (!ImGui::Begin("Profiler", open, ImGuiWindowFlags_AlwaysAutoResize)) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("%-28s %9s %9s", "Pass", "CPU ms", "GPU ms");
+	ImGui::Separator();
+	for (const PassTiming& timing : passes) {
+		int indent = timing.depth * 2;
+		ImGui::Text("%*s%-*s %9.3f %9.3f", indent, "", 28 - indent, timing.name.c_str(), timing.cpuAverage, timing.gpuAverage);
+	}
+	ImGui::Separator();
+	if (droppedFrames > 0) {
+		ImGui::Text("Frames dropped waiting for the GPU: %d", droppedFrames);
+	}
+	if (isCapturing()) {
+		ImGui::Text("Capturing trace, %d frames left", captureFrames);
+	}
+	else if (ImGui::Button("Capture trace (60 frames)")) {
+		captureTrace("profile_trace.json", 60);
+	}
+	ImGui::End();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+#include <chrono>
+
+// OpenGL
+#include <GL/glew.h>
+
+// Timings of one named pass in the last frame that finished on the GPU. Passes that ran more than once
+// in the frame (one per shadow cascade, ...) are summed
+struct PassTiming {
+	std::string name;
+	int depth;              // nesting level, 0 is the frame itself
+	double cpuMilliseconds;
+	double gpuMilliseconds;
+	double cpuAverage;      // exponential moving averages, steadier to read
+	double gpuAverage;
+};
+
+// Frame profiler with nested, named markers. Each marker records the CPU time between begin and end and
+// puts a GL_TIMESTAMP query at either end; timestamps nest freely where GL_TIME_ELAPSED queries don't.
+// Queries are pooled per frame and FRAME_COUNT frames are kept in flight, a frame whose results are not
+// available yet is skipped rather than waited on, so profiling never stalls the pipeline
+class Profiler {
+public:
+	static constexpr int FRAME_COUNT = 3;
+
+	Profiler();
+	~Profiler();
+
+	void beginFrame();
+	void endFrame();
+
+	// Returns the marker to pass to end(). Markers must be closed in reverse order of opening, name is kept
+	// until the frame is resolved so it has to be a string literal or otherwise outlive it
+	int begin(const char* name);
+	void end(int marker);
+
+	const std::vector<PassTiming>& getPasses() const { return passes; }
+	// Last frame's time of the pass called name, 0 if it did not run
+	double getCpuMilliseconds(const char* name) const;
+	double getGpuMilliseconds(const char* name) const;
+	int getDroppedFrames() const { return droppedFrames; }
+
+	// Records the next frameCount finished frames and writes them to path as Chrome trace JSON
+	// (chrome://tracing or ui.perfetto.dev), CPU and GPU markers on separate tracks
+	void captureTrace(const std::string& path, int frameCount);
+	bool isCapturing() const { return captureFrames > 0; }
+
+	void drawOverlay(bool* open);
+
+private:
+	struct Marker {
+		const char* name;
+		int depth;
+		double cpuBegin, cpuEnd; // microseconds since the profiler was created
+	};
+
+	struct Frame {
+		std::vector<Marker> markers;
+		std::vector<GLuint> queries; // two per marker, grown on demand and reused
+		bool pending;
+		double cpuStart;
+		GLint64 gpuStart;            // GL_TIMESTAMP at cpuStart, lines the GPU track up with the CPU
+	};
+
+	struct TraceEvent {
+		const char* name;
+		int track;                   // 0 = CPU, 1 = GPU
+		double start, duration;      // microseconds
+	};
+
+	std::chrono::high_resolution_clock::time_point epoch;
+	Frame frames[FRAME_COUNT];
+	int current;
+	bool inFrame;
+	std::vector<int> stack;
+	std::vector<PassTiming> passes;
+	// Swapped with passes on every resolve so the entries and their names are reused rather than reallocated
+	std::vector<PassTiming> resolved;
+	int droppedFrames;
+
+	std::string capturePath;
+	int captureFrames;
+	std::vector<TraceEvent> traceEvents;
+
+	double now() const;
+	void collect();
+	void resolveFrame(Frame& frame);
+	void writeTrace();
+};
+
+// Opens a marker for the lifetime of the scope, or until end(). Does nothing without a profiler
+class ProfileScope {
+public:
+	ProfileScope(Profiler* profiler, const char* name) {
+		this->profiler = profiler;
+		this->marker = profiler != nullptr ? profiler->begin(name) : -1;
+	}
+
+	~ProfileScope() {
+		end();
+	}
+
+	void end() {
+		if (profiler != nullptr && marker >= 0) {
+			profiler->end(marker);
+		}
+		marker = -1;
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	Profiler* profiler;
+	int marker;
+};
@@ -0,0 +1,86 @@
+#include "scenetarget.h"
+
+// Standard library
+#include <iostream>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+SceneTarget::SceneTarget(int width, int height) {
+	this->width = width;
+	this->height = height;
+	glGenFramebuffers(1, &framebuffer);
+	createTargets();
+}
+
+SceneTarget::~SceneTarget() {
+	deleteTargets();
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+void SceneTarget::createTargets() {
+	GLuint textures[2];
+	glGenTextures(2, textures);
+	colorTexture = textures[0];
+	depthTexture = textures[1];
+
+	GLenum formats[2] = { GL_RGBA16F, GL_DEPTH_COMPONENT24 };
+	// The first bloom downsample relies on bilinear taps averaging 2x2 colour texels. Passes reading at texel
+	// centres get the same values either way, depth stays point sampled
+	GLint filters[2] = { GL_LINEAR, GL_NEAREST };
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filters[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filters[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "SceneTarget: framebuffer incomplete at " << width << "x" << height << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void SceneTarget::deleteTargets() {
+	GLuint textures[2] = { colorTexture, depthTexture };
+	glDeleteTextures(2, textures);
+}
+
+void SceneTarget::resize(int width, int height) {
+	if (width == this->width && height == this->height) {
+		return;
+	}
+	this->width = width;
+	this->height = height;
+	deleteTargets();
+	createTargets();
+}
+
+void SceneTarget::bind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+}
+
+void SceneTarget::blitToScreen() {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+}
+
+void SceneTarget::readColor(std::vector<float>& pixels) {
+	pixels.resize((size_t)width * height * 3);
+	glBindTexture(GL_TEXTURE_2D, colorTexture);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, &pixels[0]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
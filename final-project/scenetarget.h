@@ -0,0 +1,37 @@
+#pragma once
+
+// Standard library
+#include <vector>
+
+// OpenGL
+#include <GL/glew.h>
+
+// Offscreen RGBA16F colour and depth the scene is drawn into before the post chain resolves it to the
+// window. Depth is a texture so screen-space passes can read what the depth pre-pass or the G-buffer laid down
+class SceneTarget {
+public:
+	SceneTarget(int width, int height);
+	~SceneTarget();
+
+	// Reallocates the targets when the window size changed
+	void resize(int width, int height);
+
+	void bind();
+	// Copies the colour into the default framebuffer and leaves that bound
+	void blitToScreen();
+	// Reads the colour back as RGB floats, bottom row first. Stalls until the GPU has finished the frame
+	void readColor(std::vector<float>& pixels);
+
+	GLuint getColorTexture() const { return colorTexture; }
+	GLuint getDepthTexture() const { return depthTexture; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+private:
+	int width, height;
+	GLuint framebuffer;
+	GLuint colorTexture, depthTexture;
+
+	void createTargets();
+	void deleteTargets();
+};
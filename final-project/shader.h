@@ -7,6 +7,7 @@
 #include <string>
 #include <stdio.h>
 #include <math.h>
+#include <chrono>
 #include <vector> // STL dynamic memory.
 
 // OpenGL includes
@@ -25,106 +26,328 @@
 class Shader {
 public:
 	GLuint ID;
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::string defines;
+	double buildMilliseconds = 0.0; // time spent on the last compile or cache load
+	GLint modelLocation = -1;       // of the "model" uniform in ID, looked up again whenever ID changes
 	
-	Shader(const char* vertexPath, const char* fragmentPath) {
-		//Start the process of setting up our shaders by creating a program ID
-	//Note: we will link all the shaders together into this ID
-		ID = glCreateProgram();
+	// defines is inserted after the #version line of both stages, e.g. "#define HAS_NORMAL_MAP\n"
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "") {
+		this->vertexPath = vertexPath;
+		this->fragmentPath = fragmentPath;
+		this->defines = defines;
+
+		std::string error;
+		ID = createProgram(error);
 		if (ID == 0) {
-			std::cerr << "Error creating shader program..." << std::endl;
+			std::cerr << error << std::endl;
 			std::cerr << "Press enter/return to exit..." << std::endl;
 			std::cin.get();
 			exit(1);
 		}
+		modelLocation = glGetUniformLocation(ID, "model");
+	}
 
-		// Create two shader objects, one for the vertex, and one for the fragment shader
-		AddShader(ID, vertexPath, GL_VERTEX_SHADER);
-		AddShader(ID, fragmentPath, GL_FRAGMENT_SHADER);
-
-		GLint Success = 0;
-		GLchar ErrorLog[1024] = { '\0' };
-		// After compiling all shader objects and attaching them to the program, we can finally link it
-		glLinkProgram(ID);
-		// check for program related errors using glGetProgramiv
-		glGetProgramiv(ID, GL_LINK_STATUS, &Success);
-		if (Success == 0) {
-			glGetProgramInfoLog(ID, sizeof(ErrorLog), NULL, ErrorLog);
-			std::cerr << "Error linking shader program: " << ErrorLog << std::endl;
-			std::cerr << "Press enter/return to exit..." << std::endl;
-			std::cin.get();
-			exit(1);
+	// Rebuilds the program from the current files. The new program only replaces the old one
+	// if it compiles and links, otherwise the error is printed and rendering carries on unchanged
+	bool reload() {
+		std::string error;
+		GLuint program = createProgram(error);
+		if (program == 0) {
+			std::cerr << "Keeping previous program for " << vertexPath << " + " << fragmentPath << ": " << error << std::endl;
+			return false;
 		}
+		glDeleteProgram(ID);
+		ID = program;
+		modelLocation = glGetUniformLocation(ID, "model");
+		return true;
+	}
 
-		// program has been successfully linked but needs to be validated to check whether the program can execute given the current pipeline state
-		glValidateProgram(ID);
-		// check for program related errors using glGetProgramiv
-		glGetProgramiv(ID, GL_VALIDATE_STATUS, &Success);
-		if (!Success) {
-			glGetProgramInfoLog(ID, sizeof(ErrorLog), NULL, ErrorLog);
-			std::cerr << "Invalid shader program: " << ErrorLog << std::endl;
-			std::cerr << "Press enter/return to exit..." << std::endl;
-			std::cin.get();
-			exit(1);
-		}
+	// Points a sampler uniform at a texture unit. It is set on the program now and again whenever the program
+	// is rebuilt, so draws only bind textures and never look the sampler up
+	void setSampler(const char* name, int unit) {
+		samplers.push_back(std::make_pair(std::string(name), unit));
+		applySamplers(ID);
+	}
+
+	~Shader() {
+		glDeleteProgram(ID);
 	}
 
 	void use() {
 		glUseProgram(ID);
 	};
 
-	void setBool(const std::string& name, bool value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	void setBool(const char* name, bool value) const {
+		glUniform1i(glGetUniformLocation(ID, name), (int)value);
 	}
 
-	void setInt(const std::string& name, int value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	void setInt(const char* name, int value) const {
+		glUniform1i(glGetUniformLocation(ID, name), value);
 	}
 
-	void setFloat(const std::string& name, float value) const {
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	void setFloat(const char* name, float value) const {
+		glUniform1f(glGetUniformLocation(ID, name), value);
 	}
 
-	void setVec3(const std::string& name, const glm::vec3& value) const {
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+	void setVec3(const char* name, const glm::vec3& value) const {
+		glUniform3fv(glGetUniformLocation(ID, name), 1, glm::value_ptr(value));
 	}
 
-	void setMat4(const std::string& name, const glm::mat4& value) const {
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	void setMat4(const char* name, const glm::mat4& value) const {
+		glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(value));
 	}
 
+	// The destructor deletes the program, a copy would delete it a second time
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
 private:
-	
-	char* readShaderSource(const char* shaderFile) {
+
+	// Header written in front of every cached program binary
+	struct ProgramCacheHeader {
+		unsigned int magic;
+		unsigned int format;
+		unsigned long long key;
+		unsigned int length;
+	};
+	static constexpr unsigned int PROGRAM_CACHE_MAGIC = 0x52505347; // "GSPR"
+
+	unsigned long long cacheKey = 0;
+	std::vector<std::pair<std::string, int>> samplers;
+
+	void applySamplers(GLuint program) const {
+		for (const auto& sampler : samplers) {
+			GLint location = glGetUniformLocation(program, sampler.first.c_str());
+			if (location != -1) {
+				glProgramUniform1i(program, location, sampler.second);
+			}
+		}
+	}
+
+	// Returns the new program, or 0 with a description in error
+	GLuint createProgram(std::string& error) {
+		std::string vertexSource = readShaderSource(vertexPath.c_str());
+		std::string fragmentSource = readShaderSource(fragmentPath.c_str());
+		if (vertexSource.empty() || fragmentSource.empty()) {
+			error = "Error reading shader sources";
+			return 0;
+		}
+		vertexSource = insertDefines(vertexSource);
+		fragmentSource = insertDefines(fragmentSource);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		// Try the on-disk program binary first, it is only valid for the exact sources and driver
+		std::string cachePath = getCachePath(vertexSource, fragmentSource);
+		GLuint program = loadProgramBinary(cachePath);
+		bool cached = program != 0;
+
+		if (!cached) {
+			program = compileProgram(vertexSource, fragmentSource, error);
+			if (program == 0) {
+				return 0;
+			}
+			saveProgramBinary(program, cachePath);
+		}
+
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		std::cout << (cached ? "Loaded " : "Compiled ") << vertexPath << " + " << fragmentPath
+			<< (cached ? " from program cache in " : " in ") << milliseconds << " ms" << std::endl;
+		buildMilliseconds = milliseconds;
+		applySamplers(program);
+		return program;
+	}
+
+	GLuint compileProgram(const std::string& vertexSource, const std::string& fragmentSource, std::string& error) {
+		//Start the process of setting up our shaders by creating a program ID
+		//Note: we will link all the shaders together into this ID
+		GLuint program = glCreateProgram();
+		if (program == 0) {
+			error = "Error creating shader program...";
+			return 0;
+		}
+
+		// Create two shader objects, one for the vertex, and one for the fragment shader
+		GLuint vertexShader = AddShader(program, vertexSource, GL_VERTEX_SHADER, error);
+		GLuint fragmentShader = AddShader(program, fragmentSource, GL_FRAGMENT_SHADER, error);
+		if (vertexShader == 0 || fragmentShader == 0) {
+			glDeleteShader(vertexShader);
+			glDeleteShader(fragmentShader);
+			glDeleteProgram(program);
+			return 0;
+		}
+
+		GLint Success = 0;
+		GLchar ErrorLog[1024] = { '\0' };
+		// Ask the driver to keep the linked binary around so it can be written to the cache
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		// After compiling all shader objects and attaching them to the program, we can finally link it
+		glLinkProgram(program);
+
+		// The shader objects are no longer needed once the program is linked
+		glDetachShader(program, vertexShader);
+		glDetachShader(program, fragmentShader);
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+
+		// check for program related errors using glGetProgramiv
+		glGetProgramiv(program, GL_LINK_STATUS, &Success);
+		if (Success == 0) {
+			glGetProgramInfoLog(program, sizeof(ErrorLog), NULL, ErrorLog);
+			error = std::string("Error linking shader program: ") + ErrorLog;
+			glDeleteProgram(program);
+			return 0;
+		}
+
+		// program has been successfully linked but needs to be validated to check whether the program can execute given the current pipeline state
+		glValidateProgram(program);
+		// check for program related errors using glGetProgramiv
+		glGetProgramiv(program, GL_VALIDATE_STATUS, &Success);
+		if (!Success) {
+			glGetProgramInfoLog(program, sizeof(ErrorLog), NULL, ErrorLog);
+			error = std::string("Invalid shader program: ") + ErrorLog;
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	std::string readShaderSource(const char* shaderFile) {
 		FILE* fp;
 		fopen_s(&fp, shaderFile, "rb");
 
-		if (fp == NULL) { return NULL; }
+		if (fp == NULL) {
+			std::cerr << "Error reading shader source " << shaderFile << std::endl;
+			return std::string();
+		}
 
 		fseek(fp, 0L, SEEK_END);
 		long size = ftell(fp);
 
 		fseek(fp, 0L, SEEK_SET);
-		char* buf = new char[size + 1];
-		fread(buf, 1, size, fp);
-		buf[size] = '\0';
+		std::string buf(size, '\0');
+		fread(&buf[0], 1, size, fp);
 
 		fclose(fp);
 
 		return buf;
 	}
 
-	void AddShader(GLuint ShaderProgram, const char* pShaderText, GLenum ShaderType)
+	std::string insertDefines(const std::string& source) const {
+		if (defines.empty()) {
+			return source;
+		}
+		// #version has to stay the first directive, so the defines go on the line after it
+		size_t version = source.find("#version");
+		if (version == std::string::npos) {
+			return defines + source;
+		}
+		size_t lineEnd = source.find('\n', version);
+		if (lineEnd == std::string::npos) {
+			return source + "\n" + defines;
+		}
+		return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+	}
+
+	// 64-bit FNV-1a
+	static unsigned long long hashString(const std::string& text, unsigned long long hash = 14695981039346656037ull) {
+		for (unsigned char c : text) {
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	std::string getCachePath(const std::string& vertexSource, const std::string& fragmentSource) {
+		// A driver update or a different GPU produces a different key, so stale binaries are never loaded
+		std::string driver = std::string((const char*)glGetString(GL_VENDOR)) + "|" +
+			(const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+
+		cacheKey = hashString(vertexSource);
+		cacheKey = hashString(std::string(1, '\0') + fragmentSource, cacheKey);
+		cacheKey = hashString(std::string(1, '\0') + driver, cacheKey);
+
+		char name[64];
+		snprintf(name, sizeof(name), "shadercache/%016llx.bin", cacheKey);
+		return name;
+	}
+
+	GLuint loadProgramBinary(const std::string& cachePath) {
+		GLint formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		if (formatCount == 0) {
+			return 0;
+		}
+
+		FILE* fp;
+		fopen_s(&fp, cachePath.c_str(), "rb");
+		if (fp == NULL) {
+			return 0;
+		}
+
+		ProgramCacheHeader header;
+		std::vector<char> binary;
+		bool valid = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == PROGRAM_CACHE_MAGIC && header.key == cacheKey;
+		if (valid) {
+			binary.resize(header.length);
+			valid = header.length > 0 && fread(&binary[0], 1, header.length, fp) == header.length;
+		}
+		fclose(fp);
+		if (!valid) {
+			return 0;
+		}
+
+		GLuint program = glCreateProgram();
+		glProgramBinary(program, header.format, &binary[0], header.length);
+
+		// The driver may still reject the binary, in which case we fall back to compiling
+		GLint Success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &Success);
+		if (Success == 0) {
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	void saveProgramBinary(GLuint program, const std::string& cachePath) {
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+
+		std::vector<char> binary(length);
+		ProgramCacheHeader header;
+		header.magic = PROGRAM_CACHE_MAGIC;
+		header.key = cacheKey;
+		glGetProgramBinary(program, length, NULL, (GLenum*)&header.format, &binary[0]);
+		header.length = (unsigned int)length;
+
+		CreateDirectoryA("shadercache", NULL);
+		FILE* fp;
+		fopen_s(&fp, cachePath.c_str(), "wb");
+		if (fp == NULL) {
+			std::cerr << "Could not write program cache " << cachePath << std::endl;
+			return;
+		}
+		fwrite(&header, sizeof(header), 1, fp);
+		fwrite(&binary[0], 1, length, fp);
+		fclose(fp);
+	}
+
+	GLuint AddShader(GLuint ShaderProgram, const std::string& shaderSource, GLenum ShaderType, std::string& error)
 	{
 		// create a shader object
 		GLuint ShaderObj = glCreateShader(ShaderType);
 
 		if (ShaderObj == 0) {
-			std::cerr << "Error creating shader..." << std::endl;
-			std::cerr << "Press enter/return to exit..." << std::endl;
-			std::cin.get();
-			exit(1);
+			error = "Error creating shader...";
+			return 0;
 		}
-		const char* pShaderSource = readShaderSource(pShaderText);
+		const char* pShaderSource = shaderSource.c_str();
 
 		// Bind the source code to the shader, this happens before compilation
 		glShaderSource(ShaderObj, 1, (const GLchar**)&pShaderSource, NULL);
@@ -136,15 +359,15 @@ private:
 		if (!success) {
 			GLchar InfoLog[1024] = { '\0' };
 			glGetShaderInfoLog(ShaderObj, 1024, NULL, InfoLog);
-			std::cerr << "Error compiling "
-				<< (ShaderType == GL_VERTEX_SHADER ? "vertex" : "fragment")
-				<< " shader program: " << InfoLog << std::endl;
-			std::cerr << "Press enter/return to exit..." << std::endl;
-			std::cin.get();
-			exit(1);
+			error = std::string("Error compiling ")
+				+ (ShaderType == GL_VERTEX_SHADER ? "vertex" : "fragment")
+				+ " shader program: " + InfoLog;
+			glDeleteShader(ShaderObj);
+			return 0;
 		}
 		// Attach the compiled shader object to the program object
 		glAttachShader(ShaderProgram, ShaderObj);
+		return ShaderObj;
 	}
 };
 
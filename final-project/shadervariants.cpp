@@ -0,0 +1,69 @@
+#include "shadervariants.h"
+
+// Standard library
+#include <map>
+#include <string>
+#include <iostream>
+
+// Project includes
+#include "shader.h"
+#include "shaderwatcher.h"
+
+// Boolean features and the define they turn on
+struct FeatureDefine {
+	unsigned int feature;
+	const char* define;
+};
+
+static const FeatureDefine featureDefines[] = {
+	{ FEATURE_NORMAL_MAP, "HAS_NORMAL_MAP" },
+	{ FEATURE_CLUSTERED_LIGHTS, "CLUSTERED_LIGHTING" },
+	{ FEATURE_SHADOWS, "HAS_SHADOWS" },
+	{ FEATURE_GBUFFER, "GBUFFER_PASS" },
+	{ FEATURE_IBL, "HAS_IBL" },
+	{ FEATURE_SSAO, "HAS_SSAO" },
+	{ FEATURE_VIRTUAL_TEXTURE, "VIRTUAL_TEXTURE" },
+};
+
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath, ShaderWatcher* watcher) {
+	this->vertexPath = vertexPath;
+	this->fragmentPath = fragmentPath;
+	this->watcher = watcher;
+	this->compileMilliseconds = 0.0;
+}
+
+ShaderVariants::~ShaderVariants() {
+	for (auto& variant : variants) {
+		delete variant.second;
+	}
+}
+
+Shader* ShaderVariants::get(unsigned int features) {
+	auto found = variants.find(features);
+	if (found != variants.end()) {
+		return found->second;
+	}
+
+	std::string defines = getDefines(features);
+	std::cout << "Building shader variant 0x" << std::hex << features << std::dec << ":\n" << defines;
+
+	Shader* shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines);
+	compileMilliseconds += shader->buildMilliseconds;
+	variants[features] = shader;
+	if (watcher != nullptr) {
+		watcher->watch(shader);
+	}
+	return shader;
+}
+
+std::string ShaderVariants::getDefines(unsigned int features) {
+	std::string defines;
+	for (const FeatureDefine& featureDefine : featureDefines) {
+		if (features & featureDefine.feature) {
+			defines += std::string("#define ") + featureDefine.define + "\n";
+		}
+	}
+	unsigned int lightingModel = (features & FEATURE_LIGHTING_MASK) >> FEATURE_LIGHTING_SHIFT;
+	defines += "#define LIGHTING_MODEL " + std::to_string(lightingModel) + "\n";
+	return defines;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Standard library
+#include <map>
+#include <string>
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "shaderwatcher.h"
+
+// Lighting models selectable through LIGHTING_MODEL, values match the defines in indirectFragmentShader.txt
+enum LightingModel : unsigned int {
+	LIGHTING_BLINN_PHONG = 0,
+	LIGHTING_GOOCH = 1,
+	LIGHTING_OREN_NAYAR = 2,
+	LIGHTING_REFLECTANCE = 3,
+	LIGHTING_GGX = 4
+};
+
+// Feature bitmask used as the variant key
+enum ShaderFeature : unsigned int {
+	FEATURE_NORMAL_MAP = 1u << 0,
+	// Bits 1-3 hold the LightingModel
+	FEATURE_LIGHTING_SHIFT = 1,
+	FEATURE_LIGHTING_MASK = 7u << 1,
+	FEATURE_CLUSTERED_LIGHTS = 1u << 4,
+	FEATURE_SHADOWS = 1u << 5,
+	FEATURE_GBUFFER = 1u << 6,
+	FEATURE_IBL = 1u << 7,
+	FEATURE_SSAO = 1u << 8,
+	FEATURE_VIRTUAL_TEXTURE = 1u << 9
+};
+
+inline unsigned int lightingFeature(LightingModel model) {
+	return ((unsigned int)model << FEATURE_LIGHTING_SHIFT) & FEATURE_LIGHTING_MASK;
+}
+
+// Compiles specialised versions of one vertex/fragment pair on demand and keeps them keyed by feature bitmask
+class ShaderVariants {
+public:
+	ShaderVariants(const char* vertexPath, const char* fragmentPath, ShaderWatcher* watcher = nullptr);
+	~ShaderVariants();
+
+	Shader* get(unsigned int features);
+
+	size_t getVariantCount() const { return variants.size(); }
+	double getCompileMilliseconds() const { return compileMilliseconds; }
+
+	static std::string getDefines(unsigned int features);
+
+private:
+	std::string vertexPath;
+	std::string fragmentPath;
+	ShaderWatcher* watcher;
+
+	std::map<unsigned int, Shader*> variants;
+	double compileMilliseconds;
+};
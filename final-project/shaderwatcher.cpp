@@ -0,0 +1,68 @@
+#include "shaderwatcher.h"
+
+// Standard library
+#include <string>
+#include <vector>
+#include <iostream>
+
+// Windows specific
+#include <windows.h>
+
+// Project includes
+#include "shader.h"
+
+ShaderWatcher::ShaderWatcher(const char* directory) {
+	changeHandle = FindFirstChangeNotificationA(directory, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE);
+	if (changeHandle == INVALID_HANDLE_VALUE) {
+		std::cerr << "ShaderWatcher: could not watch " << directory << ", hot reload disabled" << std::endl;
+	}
+}
+
+ShaderWatcher::~ShaderWatcher() {
+	if (changeHandle != INVALID_HANDLE_VALUE) {
+		FindCloseChangeNotification(changeHandle);
+	}
+}
+
+void ShaderWatcher::watch(Shader* shader) {
+	WatchedShader watched;
+	watched.shader = shader;
+	watched.vertexWriteTime = getWriteTime(shader->vertexPath);
+	watched.fragmentWriteTime = getWriteTime(shader->fragmentPath);
+	shaders.push_back(watched);
+}
+
+int ShaderWatcher::poll() {
+	if (changeHandle == INVALID_HANDLE_VALUE || WaitForSingleObject(changeHandle, 0) != WAIT_OBJECT_0) {
+		return 0;
+	}
+	FindNextChangeNotification(changeHandle);
+
+	// Something in the directory was written, find out which programs actually use it
+	int reloaded = 0;
+	for (WatchedShader& watched : shaders) {
+		FILETIME vertexWriteTime = getWriteTime(watched.shader->vertexPath);
+		FILETIME fragmentWriteTime = getWriteTime(watched.shader->fragmentPath);
+		if (CompareFileTime(&vertexWriteTime, &watched.vertexWriteTime) == 0 &&
+			CompareFileTime(&fragmentWriteTime, &watched.fragmentWriteTime) == 0) {
+			continue;
+		}
+		watched.vertexWriteTime = vertexWriteTime;
+		watched.fragmentWriteTime = fragmentWriteTime;
+
+		if (watched.shader->reload()) {
+			std::cout << "Reloaded " << watched.shader->vertexPath << " + " << watched.shader->fragmentPath << std::endl;
+			reloaded++;
+		}
+	}
+	return reloaded;
+}
+
+FILETIME ShaderWatcher::getWriteTime(const std::string& path) {
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	FILETIME writeTime = { 0, 0 };
+	if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes)) {
+		writeTime = attributes.ftLastWriteTime;
+	}
+	return writeTime;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+
+// Windows specific
+#include <windows.h>
+
+// Project includes - needed for definitions
+#include "shader.h"
+
+// Watches the shader source files of registered programs and reloads them when they change.
+// Polling happens on the render thread at the start of a frame, so programs are never swapped mid-frame
+class ShaderWatcher {
+public:
+	ShaderWatcher(const char* directory = ".");
+	~ShaderWatcher();
+
+	void watch(Shader* shader);
+	int poll();
+
+private:
+	struct WatchedShader {
+		Shader* shader;
+		FILETIME vertexWriteTime;
+		FILETIME fragmentWriteTime;
+	};
+
+	HANDLE changeHandle;
+	std::vector<WatchedShader> shaders;
+
+	static FILETIME getWriteTime(const std::string& path);
+};
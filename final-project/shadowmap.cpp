@@ -0,0 +1,175 @@
+#include "shadowmap.h"
+
+// Standard library
+#include <vector>
+#include <chrono>
+#include <math.h>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes
+#include "frustum.h"
+
+// How far behind a cascade's bounding sphere casters are still rendered
+#define SHADOW_CASTER_DISTANCE 200.0f
+
+CascadedShadowMap::CascadedShadowMap(int resolution, int cascadeCount, Profiler* profiler) {
+	this->profiler = profiler;
+	this->resolution = resolution;
+	this->cascadeCount = cascadeCount > MAX_CASCADES ? MAX_CASCADES : cascadeCount;
+	this->cpuMilliseconds = 0.0;
+	for (int i = 0; i < MAX_CASCADES; i++) {
+		lightViewProj[i] = glm::mat4(1.0f);
+		splits[i] = 0.0f;
+		texelWorldSize[i] = 0.0f;
+		stats[i].drawn = stats[i].culled = 0;
+	}
+
+	glGenTextures(1, &depthArray);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, resolution, resolution, this->cascadeCount);
+
+	// Compare mode gives a bilinear 2x2 PCF per tap through sampler2DArrayShadow
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+CascadedShadowMap::~CascadedShadowMap() {
+	glDeleteTextures(1, &depthArray);
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+void CascadedShadowMap::update(const glm::mat4& view, float fovY, float aspect, float zNear, float zFar, const glm::vec3& lightDirection) {
+	float shadowFar = zFar < shadowDistance ? zFar : shadowDistance;
+
+	// Practical split scheme
+	for (int i = 0; i < cascadeCount; i++) {
+		float fraction = (float)(i + 1) / cascadeCount;
+		float logarithmic = zNear * powf(shadowFar / zNear, fraction);
+		float uniform = zNear + (shadowFar - zNear) * fraction;
+		splits[i] = splitLambda * logarithmic + (1.0f - splitLambda) * uniform;
+	}
+
+	glm::vec3 up = fabsf(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	for (int i = 0; i < cascadeCount; i++) {
+		float sliceNear = i == 0 ? zNear : splits[i - 1];
+		float sliceFar = splits[i];
+
+		// World space corners of this slice of the camera frustum
+		glm::mat4 inverseSlice = glm::inverse(glm::perspective(fovY, aspect, sliceNear, sliceFar) * view);
+		glm::vec3 corners[8];
+		glm::vec3 center = glm::vec3(0.0f, 0.0f, 0.0f);
+		for (int c = 0; c < 8; c++) {
+			glm::vec4 ndc = glm::vec4((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f, 1.0f);
+			glm::vec4 world = inverseSlice * ndc;
+			corners[c] = glm::vec3(world) / world.w;
+			center += corners[c];
+		}
+		center /= 8.0f;
+
+		// A bounding sphere keeps the projection size constant as the camera rotates
+		float radius = 0.0f;
+		for (int c = 0; c < 8; c++) {
+			radius = glm::max(radius, glm::length(corners[c] - center));
+		}
+		radius = ceilf(radius * 16.0f) / 16.0f;
+
+		// The eye sits on the sphere, so the slice spans depths 0 to 2 * radius; casters up to
+		// SHADOW_CASTER_DISTANCE further towards the light still land in the map
+		glm::mat4 lightView = glm::lookAt(center - glm::normalize(lightDirection) * radius, center, up);
+		glm::mat4 lightProj = glm::ortho(-radius, radius, -radius, radius, -SHADOW_CASTER_DISTANCE, 2.0f * radius);
+
+		// Snap the projection to whole shadow map texels so moving the camera does not shimmer the edges
+		glm::vec4 origin = lightProj * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		origin *= resolution * 0.5f;
+		glm::vec4 rounded = glm::vec4(floorf(origin.x + 0.5f), floorf(origin.y + 0.5f), origin.z, origin.w);
+		glm::vec4 offset = (rounded - origin) * (2.0f / resolution);
+		lightProj[3][0] += offset.x;
+		lightProj[3][1] += offset.y;
+
+		lightViewProj[i] = lightProj * lightView;
+		texelWorldSize[i] = 2.0f * radius / resolution;
+	}
+}
+
+void CascadedShadowMap::render(const std::vector<Model*>& models, MeshBuffer& meshBuffer, Shader* depthShader) {
+	auto start = std::chrono::high_resolution_clock::now();
+	ProfileScope scope(profiler, "Shadows");
+
+	GLint previousViewport[4];
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, resolution, resolution);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+
+	depthShader->use();
+	int light_location = glGetUniformLocation(depthShader->ID, "lightViewProj");
+
+	for (int i = 0; i < cascadeCount; i++) {
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, i);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glUniformMatrix4fv(light_location, 1, GL_FALSE, glm::value_ptr(lightViewProj[i]));
+
+		// Same draw list as the camera pass, culled against this cascade's light volume
+		Frustum frustum(lightViewProj[i]);
+		stats[i].drawn = stats[i].culled = 0;
+		meshBuffer.beginFrame();
+		for (Model* model : models) {
+			glm::vec3 center;
+			float radius;
+			model->getWorldBounds(center, radius);
+			if (!frustum.intersectsSphere(center, radius)) {
+				stats[i].culled++;
+				continue;
+			}
+			model->Submit(meshBuffer, 0);
+			stats[i].drawn++;
+		}
+		meshBuffer.submit(true);
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+	scope.end();
+	cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void CascadedShadowMap::bind(Shader* shader) {
+	glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniformMatrix4fv(glGetUniformLocation(shader->ID, "lightViewProj"), cascadeCount, GL_FALSE, glm::value_ptr(lightViewProj[0]));
+	glUniform1fv(glGetUniformLocation(shader->ID, "cascadeSplits"), cascadeCount, splits);
+	glUniform1fv(glGetUniformLocation(shader->ID, "cascadeTexelSize"), cascadeCount, texelWorldSize);
+	shader->setInt("cascadeCount", cascadeCount);
+	shader->setFloat("shadowMapTexel", 1.0f / resolution);
+}
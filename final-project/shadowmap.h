@@ -0,0 +1,60 @@
+#pragma once
+
+// Standard library
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "model.h"
+#include "meshbuffer.h"
+#include "profiler.h"
+
+// Cascaded shadow maps for a directional light. Each cascade covers one slice of the camera frustum
+// with a bounding-sphere fitted orthographic projection, snapped to whole texels so shadows don't shimmer
+class CascadedShadowMap {
+public:
+	static constexpr int MAX_CASCADES = 4;
+	static constexpr GLuint SHADOW_UNIT = 3;
+
+	struct CascadeStats {
+		int drawn;
+		int culled;
+	};
+
+	// Blend between logarithmic (1) and uniform (0) split distances
+	float splitLambda = 0.75f;
+	// Shadows stop at this view distance, rather than stretching the cascades to the far plane
+	float shadowDistance = 150.0f;
+
+	CascadedShadowMap(int resolution, int cascadeCount = MAX_CASCADES, Profiler* profiler = nullptr);
+	~CascadedShadowMap();
+
+	void update(const glm::mat4& view, float fovY, float aspect, float zNear, float zFar, const glm::vec3& lightDirection);
+	void render(const std::vector<Model*>& models, MeshBuffer& meshBuffer, Shader* depthShader);
+	void bind(Shader* shader);
+
+	int getCascadeCount() const { return cascadeCount; }
+	float getSplit(int cascade) const { return splits[cascade]; }
+	const CascadeStats& getStats(int cascade) const { return stats[cascade]; }
+	double getCpuMilliseconds() const { return cpuMilliseconds; }
+	double getGpuMilliseconds() const { return profiler != nullptr ? profiler->getGpuMilliseconds("Shadows") : 0.0; }
+
+private:
+	int resolution;
+	int cascadeCount;
+	GLuint depthArray;
+	GLuint framebuffer;
+
+	glm::mat4 lightViewProj[MAX_CASCADES];
+	float splits[MAX_CASCADES];
+	float texelWorldSize[MAX_CASCADES];
+	CascadeStats stats[MAX_CASCADES];
+
+	Profiler* profiler;
+	double cpuMilliseconds;
+};
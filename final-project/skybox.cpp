@@ -3,49 +3,225 @@
 // Standard library
 #include <string>
 #include <vector>
+#include <iostream>
+#include <chrono>
 #include <math.h>
 
 // Project includes - needed for definitions
 #include "shader.h"
 #include "skybox.h"
 #include "stb_image.h"
+#include "filecache.h"
 
-Skybox::Skybox(std::vector<std::string> faces, float timeOfDay) {
+static constexpr unsigned int SKYBOX_CACHE_MAGIC = 0x594B5347; // "GSKY"
+
+struct SkyboxCacheHeader {
+	unsigned int magic;
+	int size;
+	int levels;
+};
+
+Skybox::Skybox(std::vector<std::string> faces, float timeOfDay, ThreadPool* threadPool) {
+	this->loadedFromCache = false;
+	this->loadMilliseconds = 0.0;
 	this->setupVAO();
-	this->textureID = loadCubeMap(faces);
+	this->textureID = loadCubeMap(faces, threadPool);
+}
+
+bool Skybox::decodeFaces(const std::vector<std::string>& faces, ThreadPool* threadPool, CubeMipChain& chain) {
+	if (faces.size() != 6) {
+		return false;
+	}
+	unsigned char* pixels[6];
+	int widths[6], heights[6];
+	auto decode = [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int nrChannels;
+			pixels[i] = stbi_load(faces[i].c_str(), &widths[i], &heights[i], &nrChannels, 3);
+		}
+	};
+	// JPEG decoding dominates a cold load and the faces are independent
+	if (threadPool != nullptr) {
+		threadPool->parallelFor(6, decode);
+	}
+	else {
+		decode(0, 6);
+	}
+
+	bool valid = true;
+	for (int i = 0; i < 6; i++) {
+		if (!pixels[i]) {
+			std::cout << "Failed to load " << faces[i] << std::endl;
+			valid = false;
+		}
+		else if (widths[i] != heights[i] || widths[i] != widths[0]) {
+			std::cout << "Cube map face " << faces[i] << " is " << widths[i] << "x" << heights[i] << ", faces must be square and the same size" << std::endl;
+			valid = false;
+		}
+	}
+
+	if (valid) {
+		chain.size = widths[0];
+		chain.levels = 1;
+		chain.data.assign(6, std::vector<unsigned char>());
+		for (int i = 0; i < 6; i++) {
+			chain.data[i].assign(pixels[i], pixels[i] + 3 * widths[i] * heights[i]);
+			std::cout << "Loaded: " << faces[i] << " (" << widths[i] << "x" << heights[i] << ")" << std::endl;
+		}
+	}
+	for (int i = 0; i < 6; i++) {
+		if (pixels[i]) {
+			stbi_image_free(pixels[i]);
+		}
+	}
+	return valid;
+}
+
+void Skybox::generateMips(ThreadPool* threadPool, CubeMipChain& chain) {
+	chain.levels = 1;
+	while ((chain.size >> chain.levels) > 0) {
+		chain.levels++;
+	}
+	chain.data.resize(6 * chain.levels);
+
+	// 2x2 box filter per face, odd sizes clamp the second tap to the edge
+	auto downsample = [&](int begin, int end) {
+		for (int face = begin; face < end; face++) {
+			for (int level = 1; level < chain.levels; level++) {
+				int sourceSize = chain.size >> (level - 1) > 0 ? chain.size >> (level - 1) : 1;
+				int size = chain.size >> level;
+				const std::vector<unsigned char>& source = chain.data[(level - 1) * 6 + face];
+				std::vector<unsigned char>& target = chain.data[level * 6 + face];
+				target.resize(3 * size * size);
+				for (int y = 0; y < size; y++) {
+					int y0 = 2 * y, y1 = 2 * y + 1 < sourceSize ? 2 * y + 1 : 2 * y;
+					for (int x = 0; x < size; x++) {
+						int x0 = 2 * x, x1 = 2 * x + 1 < sourceSize ? 2 * x + 1 : 2 * x;
+						for (int c = 0; c < 3; c++) {
+							int sum = source[3 * (y0 * sourceSize + x0) + c] + source[3 * (y0 * sourceSize + x1) + c] +
+								source[3 * (y1 * sourceSize + x0) + c] + source[3 * (y1 * sourceSize + x1) + c];
+							target[3 * (y * size + x) + c] = (unsigned char)((sum + 2) / 4);
+						}
+					}
+				}
+			}
+		}
+	};
+	if (threadPool != nullptr) {
+		threadPool->parallelFor(6, downsample);
+	}
+	else {
+		downsample(0, 6);
+	}
 }
 
-unsigned int Skybox::loadCubeMap(std::vector<std::string> faces) {
+std::string Skybox::getCachePath(const std::vector<std::string>& faces) {
+	char name[64];
+	snprintf(name, sizeof(name), "texturecache/%016llx.cube", hashFiles(faces));
+	return name;
+}
+
+bool Skybox::loadCache(const std::string& path, CubeMipChain& chain) {
+	FILE* fp;
+	fopen_s(&fp, path.c_str(), "rb");
+	if (fp == NULL) {
+		return false;
+	}
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxSize);
+	SkyboxCacheHeader header;
+	bool valid = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == SKYBOX_CACHE_MAGIC &&
+		header.size > 0 && header.size <= maxSize;
+	if (valid) {
+		// A full chain down to 1x1, the same as generateMips builds
+		int levels = 1;
+		while ((header.size >> levels) > 0) {
+			levels++;
+		}
+		valid = header.levels == levels;
+	}
+	if (valid) {
+		chain.size = header.size;
+		chain.levels = header.levels;
+		chain.data.assign(6 * header.levels, std::vector<unsigned char>());
+		for (int level = 0; level < chain.levels && valid; level++) {
+			int size = chain.size >> level;
+			for (int face = 0; face < 6 && valid; face++) {
+				std::vector<unsigned char>& data = chain.data[level * 6 + face];
+				data.resize(3 * (size_t)size * size);
+				valid = fread(&data[0], 1, data.size(), fp) == data.size();
+			}
+		}
+	}
+	fclose(fp);
+	return valid;
+}
+
+void Skybox::saveCache(const std::string& path, const CubeMipChain& chain) {
+	CreateDirectoryA("texturecache", NULL);
+	FILE* fp;
+	fopen_s(&fp, path.c_str(), "wb");
+	if (fp == NULL) {
+		std::cerr << "Could not write cube map cache " << path << std::endl;
+		return;
+	}
+	SkyboxCacheHeader header;
+	header.magic = SKYBOX_CACHE_MAGIC;
+	header.size = chain.size;
+	header.levels = chain.levels;
+	fwrite(&header, sizeof(header), 1, fp);
+	for (const std::vector<unsigned char>& data : chain.data) {
+		fwrite(&data[0], 1, data.size(), fp);
+	}
+	fclose(fp);
+}
+
+unsigned int Skybox::loadCubeMap(std::vector<std::string> faces, ThreadPool* threadPool) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// One file with every level, so a warm start skips both the JPEG decode and the downsampling
+	CubeMipChain chain;
+	std::string cachePath = getCachePath(faces);
+	loadedFromCache = loadCache(cachePath, chain);
+	if (!loadedFromCache) {
+		if (!decodeFaces(faces, threadPool, chain)) {
+			chain.size = 1;
+			chain.levels = 1;
+			chain.data.assign(6, std::vector<unsigned char>(3, 0));
+		}
+		else {
+			generateMips(threadPool, chain);
+			saveCache(cachePath, chain);
+		}
+	}
+
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	glTexStorage2D(GL_TEXTURE_CUBE_MAP, chain.levels, GL_RGB8, chain.size, chain.size);
 
-	int width, height, nrChannels;
-	for (unsigned int i = 0; i < faces.size(); i++) {
-		unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data) {
-			GLenum format = GL_RGB;
-			if (nrChannels == 1)
-				format = GL_RED;
-			else if (nrChannels == 3)
-				format = GL_RGB;
-			else if (nrChannels == 4)
-				format = GL_RGBA;
-
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			std::cout << "Loaded: " << faces[i] << " (" << width << "x" << height << ", " << nrChannels << " channels)" << std::endl;
-			stbi_image_free(data);
-		}
-		else {
-			std::cout << "Failed to load " << faces[i] << std::endl;
+	// Rows of RGB8 data are not 4 byte aligned at most mip sizes
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int level = 0; level < chain.levels; level++) {
+		int size = chain.size >> level;
+		for (int face = 0; face < 6; face++) {
+			glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, size, size, GL_RGB, GL_UNSIGNED_BYTE, &chain.data[level * 6 + face][0]);
 		}
 	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+	// Filter across face edges, otherwise the smaller mips show the seams
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	loadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Skybox " << (loadedFromCache ? "loaded from cache" : "decoded") << " in " << loadMilliseconds << " ms ("
+		<< chain.size << "x" << chain.size << ", " << chain.levels << " levels)" << std::endl;
 	return textureID;
 }
 
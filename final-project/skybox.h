@@ -7,6 +7,14 @@
 // Project includes - needed for definitions
 #include "shader.h"
 #include "mesh.h"
+#include "threadpool.h"
+
+// All levels of all six faces, RGB8, level-major: data[level * 6 + face]
+struct CubeMipChain {
+    int size;
+    int levels;
+    std::vector<std::vector<unsigned char>> data;
+};
 
 class Skybox {
 public:
@@ -58,9 +66,22 @@ public:
         -1.0f, -1.0f,  1.0f,
          1.0f, -1.0f,  1.0f
     };
-    Skybox(std::vector<std::string> faces, float timeOfDay = 0.5f);
+    Skybox(std::vector<std::string> faces, float timeOfDay = 0.5f, ThreadPool* threadPool = nullptr);
+
+    bool wasLoadedFromCache() const { return loadedFromCache; }
+    double getLoadMilliseconds() const { return loadMilliseconds; }
+
+    // CPU side of the load, usable without a GL context
+    static bool decodeFaces(const std::vector<std::string>& faces, ThreadPool* threadPool, CubeMipChain& chain);
+    static void generateMips(ThreadPool* threadPool, CubeMipChain& chain);
+    static std::string getCachePath(const std::vector<std::string>& faces);
+    static bool loadCache(const std::string& path, CubeMipChain& chain);
+    static void saveCache(const std::string& path, const CubeMipChain& chain);
 
 private:
-    unsigned int loadCubeMap(std::vector<std::string> faces);
+    bool loadedFromCache;
+    double loadMilliseconds;
+
+    unsigned int loadCubeMap(std::vector<std::string> faces, ThreadPool* threadPool);
     void setupVAO();
 };
\ No newline at end of file
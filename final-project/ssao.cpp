@@ -0,0 +1,171 @@
+#include "ssao.h"
+
+// Standard library
+#include <iostream>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+const SSAOPreset ScreenSpaceAmbientOcclusion::presets[PRESET_COUNT] = {
+	{ "Performance", 0.5f, 6, 1.0f, 0.1f },
+	{ "Balanced", 0.5f, 12, 1.5f, 0.15f },
+	{ "Quality", 1.0f, 24, 1.5f, 0.25f },
+};
+
+ScreenSpaceAmbientOcclusion::ScreenSpaceAmbientOcclusion(int width, int height, ShaderWatcher* watcher, Profiler* profiler) {
+	this->profiler = profiler;
+	this->width = width;
+	this->height = height;
+	this->historyIndex = 0;
+	this->historyValid = false;
+	this->frameIndex = 0;
+	this->previousView = glm::mat4(1.0f);
+
+	occlusionShader = new Shader("deferredVertexShader.txt", "ssaoFragmentShader.txt");
+	temporalShader = new Shader("deferredVertexShader.txt", "ssaoTemporalFragmentShader.txt");
+	upsampleShader = new Shader("deferredVertexShader.txt", "ssaoUpsampleFragmentShader.txt");
+	if (watcher != nullptr) {
+		watcher->watch(occlusionShader);
+		watcher->watch(temporalShader);
+		watcher->watch(upsampleShader);
+	}
+
+	glGenFramebuffers(1, &framebuffer);
+	glGenVertexArrays(1, &emptyVAO);
+	createTargets();
+}
+
+ScreenSpaceAmbientOcclusion::~ScreenSpaceAmbientOcclusion() {
+	deleteTargets();
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteVertexArrays(1, &emptyVAO);
+	delete occlusionShader;
+	delete temporalShader;
+	delete upsampleShader;
+}
+
+static GLuint createTarget(GLenum internalFormat, int width, int height, GLenum filter) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+void ScreenSpaceAmbientOcclusion::createTargets() {
+	allocatedPreset = preset;
+	float scale = presets[preset].resolutionScale;
+	scaledWidth = (int)(width * scale) > 1 ? (int)(width * scale) : 1;
+	scaledHeight = (int)(height * scale) > 1 ? (int)(height * scale) : 1;
+
+	occlusionTexture = createTarget(GL_RG16F, scaledWidth, scaledHeight, GL_NEAREST);
+	// The history is read at reprojected positions, filtered so slow camera motion does not stair-step
+	historyTextures[0] = createTarget(GL_RG16F, scaledWidth, scaledHeight, GL_LINEAR);
+	historyTextures[1] = createTarget(GL_RG16F, scaledWidth, scaledHeight, GL_LINEAR);
+	resultTexture = createTarget(GL_R8, width, height, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	historyValid = false;
+}
+
+void ScreenSpaceAmbientOcclusion::deleteTargets() {
+	GLuint textures[4] = { occlusionTexture, historyTextures[0], historyTextures[1], resultTexture };
+	glDeleteTextures(4, textures);
+}
+
+void ScreenSpaceAmbientOcclusion::resize(int width, int height) {
+	if (width == this->width && height == this->height && preset == allocatedPreset) {
+		return;
+	}
+	this->width = width;
+	this->height = height;
+	deleteTargets();
+	createTargets();
+}
+
+void ScreenSpaceAmbientOcclusion::drawFullscreen() {
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+}
+
+void ScreenSpaceAmbientOcclusion::render(GLuint depthTexture, const glm::mat4& view, const glm::mat4& proj) {
+	// A preset with a different resolution needs new targets
+	resize(width, height);
+	const SSAOPreset& settings = presets[preset];
+	glm::mat4 inverseProj = glm::inverse(proj);
+	ProfileScope scope(profiler, "Ambient occlusion");
+
+	glDisable(GL_DEPTH_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+
+	// Occlusion at the preset's resolution
+	ProfileScope occlusionScope(profiler, "AO occlusion");
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, occlusionTexture, 0);
+	glViewport(0, 0, scaledWidth, scaledHeight);
+	occlusionShader->use();
+	occlusionShader->setMat4("proj", proj);
+	occlusionShader->setMat4("inverseProj", inverseProj);
+	occlusionShader->setInt("sampleCount", settings.sampleCount);
+	occlusionShader->setFloat("radius", settings.radius);
+	glUniform2i(glGetUniformLocation(occlusionShader->ID, "outputSize"), scaledWidth, scaledHeight);
+	glUniform1ui(glGetUniformLocation(occlusionShader->ID, "frameIndex"), frameIndex);
+	drawFullscreen();
+	occlusionScope.end();
+
+	// Temporal accumulation into the other history texture
+	ProfileScope temporalScope(profiler, "AO temporal");
+	int writeIndex = historyIndex ^ 1;
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTextures[writeIndex], 0);
+	glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, occlusionTexture);
+	glActiveTexture(GL_TEXTURE0 + HISTORY_UNIT);
+	glBindTexture(GL_TEXTURE_2D, historyTextures[historyIndex]);
+	temporalShader->use();
+	temporalShader->setMat4("proj", proj);
+	temporalShader->setMat4("inverseProj", inverseProj);
+	temporalShader->setMat4("currentToPreviousView", previousView * glm::inverse(view));
+	temporalShader->setFloat("blend", historyValid ? settings.temporalBlend : 1.0f);
+	drawFullscreen();
+	temporalScope.end();
+
+	// Bilateral upsample to full resolution
+	ProfileScope upsampleScope(profiler, "AO upsample");
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resultTexture, 0);
+	glViewport(0, 0, width, height);
+	glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, historyTextures[writeIndex]);
+	upsampleShader->use();
+	upsampleShader->setMat4("inverseProj", inverseProj);
+	upsampleShader->setFloat("intensity", intensity);
+	drawFullscreen();
+	upsampleScope.end();
+
+	historyIndex = writeIndex;
+	historyValid = true;
+	previousView = view;
+	frameIndex++;
+
+	// The depth texture is usually still attached to the target drawn into next
+	glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void ScreenSpaceAmbientOcclusion::bind() {
+	glActiveTexture(GL_TEXTURE0 + AO_UNIT);
+	glBindTexture(GL_TEXTURE_2D, resultTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "shaderwatcher.h"
+#include "profiler.h"
+
+// One quality level of the ambient occlusion, the presets trade GPU time for noise and detail
+struct SSAOPreset {
+	const char* name;
+	float resolutionScale; // of the occlusion pass, the result is upsampled to full resolution
+	int sampleCount;
+	float radius;          // world units
+	float temporalBlend;   // weight of the new frame in the history, 1 turns accumulation off
+};
+
+// Screen-space ambient occlusion from a depth texture in three fullscreen passes:
+//   occlusion  normal-oriented hemisphere samples at the preset's resolution, writes (ao, view depth)
+//   temporal   reprojects last frame's result and blends it in, rejecting history across depth changes
+//   upsample   depth-aware bilateral upsample to a full resolution R8 target the scene shaders read
+class ScreenSpaceAmbientOcclusion {
+public:
+	// The scene shaders read the result from AO_UNIT, the passes use the units after it
+	static constexpr GLuint AO_UNIT = 10;
+	static constexpr GLuint DEPTH_UNIT = 11;
+	static constexpr GLuint SOURCE_UNIT = 12;
+	static constexpr GLuint HISTORY_UNIT = 13;
+
+	static constexpr int PRESET_COUNT = 3;
+	static const SSAOPreset presets[PRESET_COUNT];
+
+	int preset = 1;
+	// Exponent applied to the result, above 1 darkens the creases
+	float intensity = 1.5f;
+
+	ScreenSpaceAmbientOcclusion(int width, int height, ShaderWatcher* watcher = nullptr, Profiler* profiler = nullptr);
+	~ScreenSpaceAmbientOcclusion();
+
+	// Reallocates the targets when the window size changed
+	void resize(int width, int height);
+
+	// Runs the three passes on depthTexture (depth of the camera view/proj) and leaves framebuffer 0 bound
+	void render(GLuint depthTexture, const glm::mat4& view, const glm::mat4& proj);
+	void bind();
+
+	double getOcclusionMilliseconds() const { return profiler != nullptr ? profiler->getGpuMilliseconds("AO occlusion") : 0.0; }
+	double getTemporalMilliseconds() const { return profiler != nullptr ? profiler->getGpuMilliseconds("AO temporal") : 0.0; }
+	double getUpsampleMilliseconds() const { return profiler != nullptr ? profiler->getGpuMilliseconds("AO upsample") : 0.0; }
+
+private:
+	int width, height;
+	int scaledWidth, scaledHeight;
+	int allocatedPreset;
+
+	GLuint framebuffer;
+	GLuint occlusionTexture;   // scaled, RG16F (ao, view depth)
+	GLuint historyTextures[2]; // scaled, RG16F, ping-ponged between frames
+	GLuint resultTexture;      // full resolution, R8
+	GLuint emptyVAO;
+
+	int historyIndex;
+	bool historyValid;
+	unsigned int frameIndex;
+	glm::mat4 previousView;
+
+	Shader* occlusionShader;
+	Shader* temporalShader;
+	Shader* upsampleShader;
+
+	Profiler* profiler;
+
+	void createTargets();
+	void deleteTargets();
+	void drawFullscreen();
+};
@@ -0,0 +1,121 @@
+#include "streambuffer.h"
+
+// Standard library
+#include <iostream>
+#include <string.h>
+
+StreamBuffer::StreamBuffer(GLsizeiptr frameSize) {
+	this->frameSize = frameSize;
+	this->mapped = nullptr;
+	this->current = 0;
+	this->head = 0;
+	this->inFrame = false;
+	this->frameBytes = 0;
+	this->peakFrameBytes = 0;
+	this->fenceWaitMilliseconds = 0.0;
+	this->overflows = 0;
+	for (int i = 0; i < FRAME_COUNT; i++) {
+		fences[i] = nullptr;
+	}
+
+	GLint alignment = 16;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	storageAlignment = alignment;
+	// Each region has to start on the alignment too, offsets are aligned relative to their region
+	frameSize = (frameSize + storageAlignment - 1) / storageAlignment * storageAlignment;
+	this->frameSize = frameSize;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (GLEW_ARB_buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, frameSize * FRAME_COUNT, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, frameSize * FRAME_COUNT, flags);
+	}
+	if (mapped == nullptr) {
+		std::cout << "StreamBuffer: persistent mapping unavailable, falling back to glBufferSubData" << std::endl;
+		glBufferData(GL_COPY_WRITE_BUFFER, frameSize * FRAME_COUNT, NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer() {
+	for (int i = 0; i < FRAME_COUNT; i++) {
+		if (fences[i] != nullptr) {
+			glDeleteSync(fences[i]);
+		}
+	}
+	if (mapped != nullptr) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void StreamBuffer::beginFrame() {
+	if (inFrame) {
+		endFrame();
+	}
+	current = (current + 1) % FRAME_COUNT;
+	head = 0;
+	inFrame = true;
+
+	// Normally signalled long ago, a wait here means the CPU is FRAME_COUNT frames ahead of the GPU
+	fenceWaitMilliseconds = 0.0;
+	if (fences[current] != nullptr) {
+		auto start = std::chrono::high_resolution_clock::now();
+		GLenum status = glClientWaitSync(fences[current], 0, 0);
+		while (status == GL_TIMEOUT_EXPIRED) {
+			status = glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		fenceWaitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		glDeleteSync(fences[current]);
+		fences[current] = nullptr;
+	}
+}
+
+void StreamBuffer::endFrame() {
+	if (!inFrame) {
+		return;
+	}
+	fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frameBytes = head;
+	peakFrameBytes = head > peakFrameBytes ? head : peakFrameBytes;
+	inFrame = false;
+}
+
+bool StreamBuffer::upload(const void* data, GLsizeiptr size, GLsizeiptr alignment, StreamRange& range) {
+	GLsizeiptr offset = (head + alignment - 1) / alignment * alignment;
+	if (!inFrame || offset + size > frameSize) {
+		overflows++;
+		return false;
+	}
+	range.offset = (GLintptr)(current * frameSize + offset);
+	range.size = size;
+	if (mapped != nullptr) {
+		memcpy(mapped + range.offset, data, size);
+	}
+	else {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, range.offset, size, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	head = offset + size;
+	return true;
+}
+
+bool StreamBuffer::uploadAll(const void* const* data, const GLsizeiptr* sizes, const GLsizeiptr* alignments, StreamRange* ranges, int count) {
+	GLsizeiptr end = head;
+	for (int i = 0; i < count; i++) {
+		end = (end + alignments[i] - 1) / alignments[i] * alignments[i] + sizes[i];
+	}
+	if (!inFrame || end > frameSize) {
+		overflows++;
+		return false;
+	}
+	for (int i = 0; i < count; i++) {
+		upload(data[i], sizes[i], alignments[i], ranges[i]);
+	}
+	return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// Standard library
+#include <chrono>
+
+// OpenGL
+#include <GL/glew.h>
+
+// Where an upload landed in the stream buffer, bind it with glBindBufferRange or use offset as the
+// indirect pointer
+struct StreamRange {
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+};
+
+// Ring buffer for data written once a frame and read by the GPU in that frame. One buffer is persistently
+// and coherently mapped and split into FRAME_COUNT regions; each frame bump-allocates from its own region and
+// fences it at the end, and the region is only reused once that fence has signalled, so writing never stalls
+// on a buffer the GPU is still reading and no upload goes through the driver. Without ARB_buffer_storage the
+// same regions are filled with glBufferSubData
+class StreamBuffer {
+public:
+	static constexpr int FRAME_COUNT = 3;
+
+	StreamBuffer(GLsizeiptr frameSize);
+	~StreamBuffer();
+
+	// Waits for the GPU to release the oldest region and starts allocating from it
+	void beginFrame();
+	void endFrame();
+
+	// Copies size bytes into this frame's region at a multiple of alignment. False when the region is full,
+	// the caller has to upload some other way
+	bool upload(const void* data, GLsizeiptr size, GLsizeiptr alignment, StreamRange& range);
+	// upload() for count blocks in order, all or none of them: nothing is copied unless every block fits
+	bool uploadAll(const void* const* data, const GLsizeiptr* sizes, const GLsizeiptr* alignments, StreamRange* ranges, int count);
+
+	GLuint getBuffer() const { return buffer; }
+	// Offsets bound to a shader storage block have to be a multiple of this
+	GLsizeiptr getStorageAlignment() const { return storageAlignment; }
+	bool isPersistent() const { return mapped != nullptr; }
+
+	// Last finished frame
+	GLsizeiptr getFrameBytes() const { return frameBytes; }
+	GLsizeiptr getPeakFrameBytes() const { return peakFrameBytes; }
+	double getFenceWaitMilliseconds() const { return fenceWaitMilliseconds; }
+	GLsizeiptr getFrameSize() const { return frameSize; }
+	// Uploads that did not fit since the buffer was created, an uploadAll() counts once
+	int getOverflows() const { return overflows; }
+
+private:
+	GLuint buffer;
+	unsigned char* mapped;
+	GLsizeiptr frameSize;
+	GLsizeiptr storageAlignment;
+
+	GLsync fences[FRAME_COUNT];
+	int current;
+	GLsizeiptr head;
+	bool inFrame;
+
+	GLsizeiptr frameBytes;
+	GLsizeiptr peakFrameBytes;
+	double fenceWaitMilliseconds;
+	int overflows;
+};
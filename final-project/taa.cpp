@@ -0,0 +1,181 @@
+#include "taa.h"
+
+// Standard library
+#include <iostream>
+
+// OpenGL
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+TemporalAntiAliasing::TemporalAntiAliasing(int width, int height, ShaderWatcher* watcher, Profiler* profiler) {
+	this->profiler = profiler;
+	this->width = width;
+	this->height = height;
+	this->historyIndex = 0;
+	this->historyValid = false;
+	this->velocityValid = false;
+	this->frameIndex = 0;
+	this->previousViewProj = glm::mat4(1.0f);
+
+	velocityShader = new Shader("velocityVertexShader.txt", "velocityFragmentShader.txt");
+	resolveShader = new Shader("deferredVertexShader.txt", "taaFragmentShader.txt");
+	if (watcher != nullptr) {
+		watcher->watch(velocityShader);
+		watcher->watch(resolveShader);
+	}
+
+	glGenFramebuffers(1, &framebuffer);
+	glGenVertexArrays(1, &emptyVAO);
+	createTargets();
+}
+
+TemporalAntiAliasing::~TemporalAntiAliasing() {
+	deleteTargets();
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteVertexArrays(1, &emptyVAO);
+	delete velocityShader;
+	delete resolveShader;
+}
+
+static GLuint createTarget(GLenum internalFormat, int width, int height, GLenum filter) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+void TemporalAntiAliasing::createTargets() {
+	velocityTexture = createTarget(GL_RG16F, width, height, GL_NEAREST);
+	// The history is read at reprojected positions, filtered so sub-pixel motion does not snap
+	historyTextures[0] = createTarget(GL_RGBA16F, width, height, GL_LINEAR);
+	historyTextures[1] = createTarget(GL_RGBA16F, width, height, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	historyValid = false;
+}
+
+void TemporalAntiAliasing::deleteTargets() {
+	GLuint textures[3] = { velocityTexture, historyTextures[0], historyTextures[1] };
+	glDeleteTextures(3, textures);
+}
+
+void TemporalAntiAliasing::resize(int width, int height) {
+	if (width == this->width && height == this->height) {
+		return;
+	}
+	this->width = width;
+	this->height = height;
+	deleteTargets();
+	createTargets();
+}
+
+// Radical inverse of index in the given base, the low-discrepancy sequence the jitter is taken from
+static float halton(unsigned int index, unsigned int base) {
+	float result = 0.0f;
+	float fraction = 1.0f / base;
+	while (index > 0) {
+		result += (index % base) * fraction;
+		index /= base;
+		fraction /= base;
+	}
+	return result;
+}
+
+glm::mat4 TemporalAntiAliasing::jitter(const glm::mat4& proj) const {
+	// Index 0 of the sequence is (0, 0), start at 1 so every phase is offset
+	unsigned int index = frameIndex % JITTER_PHASES + 1;
+	float x = halton(index, 2) - 0.5f;
+	float y = halton(index, 3) - 0.5f;
+
+	// Offsetting the z column shifts every projected point by the same amount in NDC after the divide
+	glm::mat4 result = proj;
+	result[2][0] += x * 2.0f / width;
+	result[2][1] += y * 2.0f / height;
+	return result;
+}
+
+void TemporalAntiAliasing::renderVelocity(SceneTarget& scene, MeshBuffer& meshBuffer, const glm::mat4& view, const glm::mat4& jitteredProj, const glm::mat4& proj) {
+	resize(scene.getWidth(), scene.getHeight());
+
+	ProfileScope scope(profiler, "TAA velocity");
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, velocityTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, scene.getDepthTexture(), 0);
+	glViewport(0, 0, width, height);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// Only the visible surface of each pixel passes against the finished depth
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+	velocityShader->use();
+	velocityShader->setMat4("view", view);
+	velocityShader->setMat4("proj", jitteredProj);
+	velocityShader->setMat4("viewProj", proj * view);
+	velocityShader->setMat4("previousViewProj", previousViewProj);
+	meshBuffer.submit(true);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	scope.end();
+
+	// The scene still renders into its depth, don't keep it attached here as well
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	velocityValid = true;
+}
+
+void TemporalAntiAliasing::resolve(SceneTarget& scene, const glm::mat4& view, const glm::mat4& proj) {
+	resize(scene.getWidth(), scene.getHeight());
+	glm::mat4 viewProj = proj * view;
+
+	ProfileScope scope(profiler, "TAA resolve");
+	glDisable(GL_DEPTH_TEST);
+	int writeIndex = historyIndex ^ 1;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTextures[writeIndex], 0);
+	glViewport(0, 0, width, height);
+
+	glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, scene.getColorTexture());
+	glActiveTexture(GL_TEXTURE0 + HISTORY_UNIT);
+	glBindTexture(GL_TEXTURE_2D, historyTextures[historyIndex]);
+	glActiveTexture(GL_TEXTURE0 + VELOCITY_UNIT);
+	glBindTexture(GL_TEXTURE_2D, velocityTexture);
+	glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, scene.getDepthTexture());
+
+	resolveShader->use();
+	resolveShader->setMat4("inverseViewProj", glm::inverse(viewProj));
+	resolveShader->setMat4("previousViewProj", previousViewProj);
+	resolveShader->setBool("velocityValid", velocityValid);
+	resolveShader->setFloat("feedback", historyValid ? feedback : 0.0f);
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	scope.end();
+
+	// Hand the result to the post chain through the scene colour, the history keeps its own copy
+	glCopyImageSubData(historyTextures[writeIndex], GL_TEXTURE_2D, 0, 0, 0, 0,
+		scene.getColorTexture(), GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+
+	historyIndex = writeIndex;
+	historyValid = true;
+	velocityValid = false;
+	previousViewProj = viewProj;
+	frameIndex++;
+
+	glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "shaderwatcher.h"
+#include "profiler.h"
+#include "meshbuffer.h"
+#include "scenetarget.h"
+
+// Temporal anti-aliasing: every frame the projection is offset by a sub-pixel Halton(2,3) jitter and the
+// result is blended into a history that is reprojected with per-pixel motion vectors
+//   velocity  redraws the frame's draw list against the scene depth, writes the screen motion of each surface
+//   resolve   fetches the history at the reprojected position, clips it to the current 3x3 neighbourhood
+//             in YCoCg and blends; the result is copied back into the scene colour for the post chain
+class TemporalAntiAliasing {
+public:
+	// Only bound during the passes, shared with the transient units of the other screen-space passes
+	static constexpr GLuint DEPTH_UNIT = 11;
+	static constexpr GLuint SOURCE_UNIT = 12;
+	static constexpr GLuint HISTORY_UNIT = 13;
+	static constexpr GLuint VELOCITY_UNIT = 14;
+
+	static constexpr int JITTER_PHASES = 8;
+
+	// Weight of the history, higher is smoother but slower to respond
+	float feedback = 0.9f;
+
+	TemporalAntiAliasing(int width, int height, ShaderWatcher* watcher = nullptr, Profiler* profiler = nullptr);
+	~TemporalAntiAliasing();
+
+	// Reallocates the targets when the window size changed
+	void resize(int width, int height);
+	// Drops the history, the next resolve starts from the current frame only
+	void reset() { historyValid = false; }
+
+	// proj with this frame's sub-pixel offset applied
+	glm::mat4 jitter(const glm::mat4& proj) const;
+
+	// Motion of everything queued in meshBuffer since beginFrame(). jitteredProj must be the projection the
+	// scene was drawn with, proj is the same without the jitter
+	void renderVelocity(SceneTarget& scene, MeshBuffer& meshBuffer, const glm::mat4& view, const glm::mat4& jitteredProj, const glm::mat4& proj);
+	// Blends the scene colour with the history and writes the result back into it. Without renderVelocity()
+	// this frame the history is reprojected by the camera motion alone
+	void resolve(SceneTarget& scene, const glm::mat4& view, const glm::mat4& proj);
+
+	double getVelocityMilliseconds() const { return profiler != nullptr ? profiler->getGpuMilliseconds("TAA velocity") : 0.0; }
+	double getResolveMilliseconds() const { return profiler != nullptr ? profiler->getGpuMilliseconds("TAA resolve") : 0.0; }
+
+private:
+	int width, height;
+
+	GLuint framebuffer;
+	GLuint velocityTexture;    // RG16F, uv offset from the previous frame
+	GLuint historyTextures[2]; // RGBA16F, ping-ponged between frames
+	GLuint emptyVAO;
+
+	int historyIndex;
+	bool historyValid;
+	bool velocityValid;
+	unsigned int frameIndex;
+	glm::mat4 previousViewProj;
+
+	Shader* velocityShader;
+	Shader* resolveShader;
+
+	Profiler* profiler;
+
+	void createTargets();
+	void deleteTargets();
+};
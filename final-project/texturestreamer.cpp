@@ -0,0 +1,253 @@
+#include "texturestreamer.h"
+
+// Standard library
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+// Project includes
+#include "filecache.h"
+
+TextureStreamer::TextureStreamer(size_t budget)
+	: readThread(1) {
+	this->budget = budget;
+	this->residentBytes = 0;
+	this->pendingBytes = 0;
+	this->uploadedBytes = 0;
+	this->evictions = 0;
+	// lastUsed starts at 0, so no texture counts as in view before its first request
+	this->frame = 1;
+}
+
+TextureStreamer::~TextureStreamer() {
+	// The workers write into textures, they have to be done first
+	for (std::future<void>& read : reads) {
+		read.wait();
+	}
+	for (StreamedTexture* texture : textures) {
+		glDeleteTextures(1, &texture->id);
+		delete texture;
+	}
+}
+
+GLuint TextureStreamer::load(const std::string& path) {
+	auto found = paths.find(path);
+	if (found != paths.end()) {
+		return found->second;
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "texturecache/%016llx.mips", hashFiles({ path }));
+	StreamedTexture* texture = new StreamedTexture();
+	if (!texture->file.open(name) && (!MipChainFile::build(path, name) || !texture->file.open(name))) {
+		delete texture;
+		return 0;
+	}
+
+	MipChainFile& file = texture->file;
+	texture->floorMip = 0;
+	while (texture->floorMip < file.getMipCount() - 1 &&
+		(file.getLevelWidth(texture->floorMip) > MIN_RESIDENT_SIZE || file.getLevelHeight(texture->floorMip) > MIN_RESIDENT_SIZE)) {
+		texture->floorMip++;
+	}
+	texture->residentMip = file.getMipCount();
+	texture->wantedMip = texture->floorMip;
+	texture->loadingMip = -1;
+	texture->lastUsed = 0;
+
+	glGenTextures(1, &texture->id);
+	glBindTexture(GL_TEXTURE_2D, texture->id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, file.getMipCount() - 1);
+
+	// Coarsest first, so the chain from the base level down is always complete
+	std::vector<unsigned char> texels(file.getLevelBytes(texture->floorMip));
+	for (int mip = file.getMipCount() - 1; mip >= texture->floorMip; mip--) {
+		if (!file.readLevel(mip, &texels[0])) {
+			std::cerr << "Could not read level " << mip << " of " << name << std::endl;
+			break;
+		}
+		uploadLevel(*texture, mip, &texels[0]);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	textures.push_back(texture);
+	wanting.reserve(textures.size());
+	lookup[texture->id] = texture;
+	paths[path] = texture->id;
+	return texture->id;
+}
+
+void TextureStreamer::request(GLuint texture, float uvPerPixel) {
+	auto found = lookup.find(texture);
+	if (found == lookup.end()) {
+		return;
+	}
+	StreamedTexture& streamed = *found->second;
+	if (streamed.lastUsed != frame) {
+		streamed.lastUsed = frame;
+		streamed.wantedMip = streamed.floorMip;
+	}
+
+	// The level where one texel covers about one pixel, rounded to the finer one as trilinear filtering blends
+	// between the two around it
+	float texelsPerPixel = uvPerPixel * (float)std::max(streamed.file.getWidth(), streamed.file.getHeight());
+	int mip = texelsPerPixel > 1.0f ? (int)floor(log2(texelsPerPixel)) : 0;
+	streamed.wantedMip = std::min(streamed.wantedMip, std::max(mip, 0));
+}
+
+void TextureStreamer::update() {
+	reads.erase(std::remove_if(reads.begin(), reads.end(), [](std::future<void>& read) {
+		return read.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), reads.end());
+	{
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		for (LoadedLevel& level : loaded) {
+			uploads.push_back(std::move(level));
+		}
+		loaded.clear();
+	}
+
+	// The bytes were set aside when the read started, so an upload never goes over the budget
+	uploadedBytes = 0;
+	size_t count = 0;
+	while (count < uploads.size() && (count == 0 || uploadedBytes < MAX_UPLOAD_BYTES_PER_FRAME)) {
+		LoadedLevel& level = uploads[count++];
+		StreamedTexture& texture = *level.texture;
+		size_t bytes = texture.file.getLevelBytes(level.mip);
+		pendingBytes -= bytes;
+		texture.loadingMip = -1;
+		// The level below may have been evicted while this one was read, then it no longer fits the chain
+		if (level.valid && level.mip == texture.residentMip - 1) {
+			glBindTexture(GL_TEXTURE_2D, texture.id);
+			uploadLevel(texture, level.mip, &level.texels[0]);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			uploadedBytes += bytes;
+		}
+	}
+	uploads.erase(uploads.begin(), uploads.begin() + count);
+
+	// The budget may have been lowered
+	makeRoom(0, nullptr);
+
+	// Textures furthest from what they asked for go first
+	wanting.clear();
+	for (StreamedTexture* texture : textures) {
+		if (texture->lastUsed == frame && texture->wantedMip < texture->residentMip && texture->loadingMip < 0) {
+			wanting.push_back(texture);
+		}
+	}
+	std::sort(wanting.begin(), wanting.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+		return a->residentMip - a->wantedMip > b->residentMip - b->wantedMip;
+	});
+	for (StreamedTexture* texture : wanting) {
+		if ((int)reads.size() >= MAX_PENDING_LOADS) {
+			break;
+		}
+		int mip = texture->residentMip - 1;
+		if (makeRoom(texture->file.getLevelBytes(mip), texture)) {
+			startLoad(*texture, mip);
+		}
+	}
+	frame++;
+}
+
+void TextureStreamer::makeResident(GLuint texture) {
+	auto found = lookup.find(texture);
+	if (found == lookup.end()) {
+		return;
+	}
+	StreamedTexture& streamed = *found->second;
+	if (streamed.residentMip == 0) {
+		return;
+	}
+	// A read in flight would no longer fit the chain, update() drops it
+	std::vector<unsigned char> texels(streamed.file.getLevelBytes(0));
+	glBindTexture(GL_TEXTURE_2D, streamed.id);
+	for (int mip = streamed.residentMip - 1; mip >= 0; mip--) {
+		if (!streamed.file.readLevel(mip, &texels[0])) {
+			break;
+		}
+		uploadLevel(streamed, mip, &texels[0]);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+size_t TextureStreamer::getFullBytes() const {
+	size_t bytes = 0;
+	for (const StreamedTexture* texture : textures) {
+		for (int mip = 0; mip < texture->file.getMipCount(); mip++) {
+			bytes += texture->file.getLevelBytes(mip);
+		}
+	}
+	return bytes;
+}
+
+int TextureStreamer::getResidentMip(GLuint texture) const {
+	auto found = lookup.find(texture);
+	return found != lookup.end() ? found->second->residentMip : -1;
+}
+
+int TextureStreamer::getWantedMip(GLuint texture) const {
+	auto found = lookup.find(texture);
+	return found != lookup.end() ? found->second->wantedMip : -1;
+}
+
+// Expects the texture to be bound
+void TextureStreamer::uploadLevel(StreamedTexture& texture, int mip, const unsigned char* texels) {
+	glTexImage2D(GL_TEXTURE_2D, mip, GL_RGBA8, texture.file.getLevelWidth(mip), texture.file.getLevelHeight(mip), 0,
+		GL_RGBA, GL_UNSIGNED_BYTE, texels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mip);
+	texture.residentMip = mip;
+	residentBytes += texture.file.getLevelBytes(mip);
+}
+
+void TextureStreamer::dropTopMip(StreamedTexture& texture) {
+	int mip = texture.residentMip;
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mip + 1);
+	// Redefining the level as empty releases its storage, the texture itself stays the same object
+	glTexImage2D(GL_TEXTURE_2D, mip, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	texture.residentMip = mip + 1;
+	residentBytes -= texture.file.getLevelBytes(mip);
+	evictions++;
+}
+
+bool TextureStreamer::makeRoom(size_t bytes, const StreamedTexture* requester) {
+	while (residentBytes + pendingBytes + bytes > budget) {
+		// Few enough textures that a scan for the least recently used one is cheaper than keeping a list
+		StreamedTexture* victim = nullptr;
+		for (StreamedTexture* texture : textures) {
+			bool surplus = texture->residentMip < texture->floorMip &&
+				(texture->lastUsed != frame || texture->residentMip < texture->wantedMip);
+			if (texture != requester && surplus && (victim == nullptr || texture->lastUsed < victim->lastUsed)) {
+				victim = texture;
+			}
+		}
+		if (victim == nullptr) {
+			return false;
+		}
+		dropTopMip(*victim);
+	}
+	return true;
+}
+
+void TextureStreamer::startLoad(StreamedTexture& texture, int mip) {
+	texture.loadingMip = mip;
+	pendingBytes += texture.file.getLevelBytes(mip);
+	StreamedTexture* target = &texture;
+	reads.push_back(readThread.submit([this, target, mip]() {
+		LoadedLevel level;
+		level.texture = target;
+		level.mip = mip;
+		level.texels.resize(target->file.getLevelBytes(mip));
+		level.valid = target->file.readLevel(mip, &level.texels[0]);
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		loaded.push_back(std::move(level));
+	}));
+}
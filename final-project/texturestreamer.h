@@ -0,0 +1,107 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <future>
+
+// OpenGL
+#include <GL/glew.h>
+
+// Project includes - needed for definitions
+#include "threadpool.h"
+#include "mipchain.h"
+
+// Streams textures by mip level. A texture starts out with only its small levels resident and the finer ones
+// are read from a MipChainFile under texturecache/ as the things using it come closer, one level at a time on
+// a read thread of its own. Each frame the users report how much of the UV range a screen pixel spans, which
+// picks the finest level worth having. GL_TEXTURE_BASE_LEVEL hides the levels that aren't there, so a texture
+// id never changes and sampling always finds a complete chain.
+// Over the byte budget, the top mip of the least recently used texture is freed first; textures in view this
+// frame only give up levels finer than they asked for
+class TextureStreamer {
+public:
+	// Levels this size and smaller stay resident for good, they are loaded with the texture
+	static constexpr int MIN_RESIDENT_SIZE = 64;
+	static constexpr int MAX_PENDING_LOADS = 8;
+	// At least one level is uploaded a frame even when it is bigger than this
+	static constexpr size_t MAX_UPLOAD_BYTES_PER_FRAME = 8 << 20;
+
+	TextureStreamer(size_t budget);
+	~TextureStreamer();
+
+	// Texture with the levels up to MIN_RESIDENT_SIZE resident, the same path gives the same texture. The mip
+	// chain is built the first time an image is seen. 0 when the image can't be read
+	GLuint load(const std::string& path);
+	// For every use of texture in view this frame; ignored for textures that aren't streamed
+	void request(GLuint texture, float uvPerPixel);
+	// Once a frame after the requests: uploads the levels that have been read, keeps to the budget and starts
+	// reading the next levels
+	void update();
+	// Reads every level of texture right away, for the benchmarks that draw without requesting. The levels
+	// count against the budget from the next update() on
+	void makeResident(GLuint texture);
+
+	void setBudget(size_t budget) { this->budget = budget; }
+	size_t getBudget() const { return budget; }
+	size_t getResidentBytes() const { return residentBytes; }
+	// What every level of every texture would take
+	size_t getFullBytes() const;
+	int getPendingLoads() const { return (int)reads.size(); }
+	size_t getUploadedBytes() const { return uploadedBytes; }
+	unsigned long long getEvictions() const { return evictions; }
+	size_t getTextureCount() const { return textures.size(); }
+	// Finest level resident and finest level asked for in the last frame, -1 for unknown textures
+	int getResidentMip(GLuint texture) const;
+	int getWantedMip(GLuint texture) const;
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+private:
+	struct StreamedTexture {
+		GLuint id;
+		MipChainFile file;
+		int residentMip;  // finest level in GL, also its GL_TEXTURE_BASE_LEVEL
+		int floorMip;     // this level and all coarser ones are always resident
+		int wantedMip;    // finest level asked for in frame lastUsed
+		int loadingMip;   // level being read, -1 when none
+		unsigned long long lastUsed;
+	};
+
+	// A level read by a worker, waiting for the render thread to upload it
+	struct LoadedLevel {
+		StreamedTexture* texture;
+		int mip;
+		std::vector<unsigned char> texels;
+		bool valid;
+	};
+
+	// Off the shared pool, so reads of several MB never queue in front of the render thread's parallelFor jobs
+	ThreadPool readThread;
+	size_t budget;
+	size_t residentBytes;
+	size_t pendingBytes;
+	size_t uploadedBytes;
+	unsigned long long evictions;
+	unsigned long long frame;
+
+	std::vector<StreamedTexture*> textures;
+	std::vector<StreamedTexture*> wanting; // scratch for update(), kept so the frame doesn't allocate
+	std::unordered_map<GLuint, StreamedTexture*> lookup;
+	std::map<std::string, GLuint> paths;
+
+	std::vector<std::future<void>> reads;
+	std::mutex loadedMutex;
+	std::vector<LoadedLevel> loaded;   // filled by the workers
+	std::vector<LoadedLevel> uploads;  // taken from loaded, uploaded within MAX_UPLOAD_BYTES_PER_FRAME
+
+	void uploadLevel(StreamedTexture& texture, int mip, const unsigned char* texels);
+	void dropTopMip(StreamedTexture& texture);
+	// Evicts until bytes more fit in the budget, without touching requester. False when it can't
+	bool makeRoom(size_t bytes, const StreamedTexture* requester);
+	void startLoad(StreamedTexture& texture, int mip);
+};
@@ -0,0 +1,79 @@
+#include "threadpool.h"
+
+// Standard library
+#include <memory>
+#include <vector>
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+	this->stopping = false;
+	if (threadCount == 0) {
+		// Leave one core for the render thread, which also takes a share in parallelFor
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+	for (unsigned int i = 0; i < threadCount; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+std::future<void> ThreadPool::submit(const std::function<void()>& job) {
+	auto task = std::make_shared<std::packaged_task<void()>>(job);
+	std::future<void> result = task->get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back([task]() { (*task)(); });
+	}
+	condition.notify_one();
+	return result;
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int begin, int end)>& task) {
+	if (count <= 0) {
+		return;
+	}
+	int chunks = (int)workers.size() + 1;
+	if (chunks > count) {
+		chunks = count;
+	}
+	int chunkSize = (count + chunks - 1) / chunks;
+
+	std::vector<std::future<void>> pending;
+	for (int begin = chunkSize; begin < count; begin += chunkSize) {
+		int end = begin + chunkSize < count ? begin + chunkSize : count;
+		pending.push_back(submit([&task, begin, end]() { task(begin, end); }));
+	}
+
+	// The caller works on the first chunk instead of idling
+	task(0, chunkSize < count ? chunkSize : count);
+
+	for (std::future<void>& result : pending) {
+		result.get();
+	}
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (stopping && jobs.empty()) {
+				return;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// Standard library
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by the CPU side systems (light binning, asset processing)
+class ThreadPool {
+public:
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	std::future<void> submit(const std::function<void()>& job);
+
+	// Splits [0, count) into one range per worker plus the calling thread and waits for all of them
+	void parallelFor(int count, const std::function<void(int begin, int end)>& task);
+
+	unsigned int getThreadCount() const { return (unsigned int)workers.size(); }
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+
+	void workerLoop();
+};
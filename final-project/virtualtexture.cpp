@@ -0,0 +1,546 @@
+#include "virtualtexture.h"
+
+// Standard library
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+// Windows specific
+#include <windows.h>
+
+// Project includes
+#include "stb_image.h"
+#include "filecache.h"
+#include "mipchain.h"
+
+VirtualTextureFile::VirtualTextureFile() {
+	this->file = nullptr;
+	this->width = 0;
+	this->height = 0;
+	this->mipCount = 0;
+	firstPage[0] = 0;
+}
+
+VirtualTextureFile::~VirtualTextureFile() {
+	if (file != nullptr) {
+		fclose(file);
+	}
+}
+
+bool VirtualTextureFile::build(const std::string& imagePath, const std::string& outPath) {
+	int imageWidth, imageHeight, nrComponents;
+	unsigned char* pixels = stbi_load(imagePath.c_str(), &imageWidth, &imageHeight, &nrComponents, 4);
+	if (pixels == NULL) {
+		std::cerr << "Virtual texture failed to load at path: " << imagePath << std::endl;
+		return false;
+	}
+
+	CreateDirectoryA("texturecache", NULL);
+	FILE* fp;
+	fopen_s(&fp, outPath.c_str(), "wb");
+	if (fp == NULL) {
+		std::cerr << "Could not write virtual texture " << outPath << std::endl;
+		stbi_image_free(pixels);
+		return false;
+	}
+
+	VirtualTextureHeader header;
+	header.magic = VIRTUAL_TEXTURE_MAGIC;
+	header.pageSize = PAGE_SIZE;
+	header.border = PAGE_BORDER;
+	header.width = imageWidth;
+	header.height = imageHeight;
+	header.mipCount = 1;
+	while (header.mipCount < MAX_MIPS && ((imageWidth >> (header.mipCount - 1)) > PAGE_SIZE || (imageHeight >> (header.mipCount - 1)) > PAGE_SIZE)) {
+		header.mipCount++;
+	}
+	fwrite(&header, sizeof(header), 1, fp);
+
+	// Only one level is held at a time, each is box filtered from the one before
+	std::vector<unsigned char> level(pixels, pixels + 4 * (size_t)imageWidth * imageHeight);
+	stbi_image_free(pixels);
+	int levelWidth = imageWidth;
+	int levelHeight = imageHeight;
+	std::vector<unsigned char> page(PAGE_BYTES);
+
+	for (int mip = 0; mip < header.mipCount; mip++) {
+		int pagesX = (levelWidth + PAGE_SIZE - 1) / PAGE_SIZE;
+		int pagesY = (levelHeight + PAGE_SIZE - 1) / PAGE_SIZE;
+		for (int py = 0; py < pagesY; py++) {
+			for (int px = 0; px < pagesX; px++) {
+				// Texels outside the level wrap around, the same as GL_REPEAT on the material textures
+				for (int ty = 0; ty < PAGE_STRIDE; ty++) {
+					int sy = ((py * PAGE_SIZE + ty - PAGE_BORDER) % levelHeight + levelHeight) % levelHeight;
+					for (int tx = 0; tx < PAGE_STRIDE; tx++) {
+						int sx = ((px * PAGE_SIZE + tx - PAGE_BORDER) % levelWidth + levelWidth) % levelWidth;
+						memcpy(&page[4 * (ty * PAGE_STRIDE + tx)], &level[4 * ((size_t)sy * levelWidth + sx)], 4);
+					}
+				}
+				fwrite(&page[0], 1, PAGE_BYTES, fp);
+			}
+		}
+
+		if (mip + 1 < header.mipCount) {
+			std::vector<unsigned char> next;
+			MipChainFile::downsample(level, levelWidth, levelHeight, next);
+			level.swap(next);
+			levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+			levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+bool VirtualTextureFile::open(const std::string& path) {
+	fopen_s(&file, path.c_str(), "rb");
+	if (file == NULL) {
+		file = nullptr;
+		return false;
+	}
+	VirtualTextureHeader header;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == VIRTUAL_TEXTURE_MAGIC &&
+		header.pageSize == PAGE_SIZE && header.border == PAGE_BORDER && header.width > 0 && header.height > 0 &&
+		header.mipCount > 0 && header.mipCount <= MAX_MIPS;
+	if (!valid) {
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+	width = header.width;
+	height = header.height;
+	mipCount = header.mipCount;
+	for (int mip = 0; mip < mipCount; mip++) {
+		firstPage[mip + 1] = firstPage[mip] + (long long)getPagesX(mip) * getPagesY(mip);
+	}
+
+	// A build that was cut short leaves a file without all of its pages
+	_fseeki64(file, 0, SEEK_END);
+	if (_ftelli64(file) < (long long)sizeof(header) + getPageCount() * (long long)PAGE_BYTES) {
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool VirtualTextureFile::readPage(int mip, int x, int y, unsigned char* out) {
+	if (file == nullptr || mip < 0 || mip >= mipCount || x >= getPagesX(mip) || y >= getPagesY(mip)) {
+		return false;
+	}
+	long long page = firstPage[mip] + (long long)y * getPagesX(mip) + x;
+	std::lock_guard<std::mutex> lock(fileMutex);
+	_fseeki64(file, sizeof(VirtualTextureHeader) + page * (long long)PAGE_BYTES, SEEK_SET);
+	return fread(out, 1, PAGE_BYTES, file) == PAGE_BYTES;
+}
+
+// Page table texel: cache slot x and y, the mip that is resident there, and 255 in alpha
+static unsigned int packEntry(int slot, int slotsPerRow, int mip) {
+	return (unsigned int)(slot % slotsPerRow) | ((unsigned int)(slot / slotsPerRow) << 8) | ((unsigned int)mip << 16) | 0xFF000000u;
+}
+
+VirtualTextureSystem::VirtualTextureSystem(int slotsPerRow)
+	: readThread(1), cache(slotsPerRow * slotsPerRow) {
+	this->slotsPerRow = slotsPerRow;
+	this->frame = 1;
+	this->feedbackFramebuffer = 0;
+	this->feedbackColor = 0;
+	this->feedbackDepth = 0;
+	this->feedbackWidth = 0;
+	this->feedbackHeight = 0;
+	this->feedbackFence = 0;
+	this->requestedPages = 0;
+	this->uploadsLastFrame = 0;
+
+	int cacheSize = slotsPerRow * VirtualTextureFile::PAGE_STRIDE;
+	glGenTextures(1, &cacheTexture);
+	glBindTexture(GL_TEXTURE_2D, cacheTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, cacheSize, cacheSize);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// Read with texelFetch, so only the storage matters
+	glGenTextures(1, &pageTable);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, pageTable);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, PAGE_TABLE_LEVELS, GL_RGBA8, MAX_PAGES, MAX_PAGES, MAX_TEXTURES);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenBuffers(1, &feedbackPixels);
+	feedbackShader = new Shader("indirectVertexShader.txt", "virtualFeedbackFragmentShader.txt");
+
+	for (int i = 0; i < MAX_PENDING_READS; i++) {
+		freeBuffers.push_back(new unsigned char[VirtualTextureFile::PAGE_BYTES]);
+	}
+	requests.reserve(4096);
+	loaded.reserve(MAX_PENDING_READS);
+	uploads.reserve(MAX_PENDING_READS);
+}
+
+VirtualTextureSystem::~VirtualTextureSystem() {
+	// The workers write into the buffers and the loaded list, they have to be done first
+	for (std::future<void>& read : reads) {
+		read.wait();
+	}
+	for (const LoadedPage& page : loaded) {
+		freeBuffers.push_back(page.texels);
+	}
+	for (const LoadedPage& page : uploads) {
+		freeBuffers.push_back(page.texels);
+	}
+	for (unsigned char* buffer : freeBuffers) {
+		delete[] buffer;
+	}
+	for (VirtualTexture* texture : textures) {
+		delete texture;
+	}
+
+	if (feedbackFence != 0) {
+		glDeleteSync(feedbackFence);
+	}
+	if (feedbackFramebuffer != 0) {
+		glDeleteFramebuffers(1, &feedbackFramebuffer);
+		glDeleteRenderbuffers(1, &feedbackColor);
+		glDeleteRenderbuffers(1, &feedbackDepth);
+	}
+	glDeleteBuffers(1, &feedbackPixels);
+	glDeleteTextures(1, &cacheTexture);
+	glDeleteTextures(1, &pageTable);
+	delete feedbackShader;
+}
+
+int VirtualTextureSystem::addTexture(const std::string& imagePath) {
+	if ((int)textures.size() >= MAX_TEXTURES) {
+		std::cerr << "No room for virtual texture " << imagePath << ", the limit is " << MAX_TEXTURES << std::endl;
+		return -1;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+
+	char name[64];
+	snprintf(name, sizeof(name), "texturecache/%016llx.vtex", hashFiles({ imagePath }));
+	VirtualTexture* texture = new VirtualTexture();
+	bool built = false;
+	if (!texture->file.open(name)) {
+		built = VirtualTextureFile::build(imagePath, name) && texture->file.open(name);
+		if (!built) {
+			delete texture;
+			return -1;
+		}
+	}
+	if (texture->file.getPagesX(0) > MAX_PAGES || texture->file.getPagesY(0) > MAX_PAGES) {
+		std::cerr << imagePath << " is larger than the " << MAX_PAGES * VirtualTextureFile::PAGE_SIZE << " texels a virtual texture can span" << std::endl;
+		delete texture;
+		return -1;
+	}
+
+	int index = (int)textures.size();
+	textures.push_back(texture);
+	for (int mip = 0; mip < texture->file.getMipCount(); mip++) {
+		texture->slots[mip].assign((size_t)texture->file.getPagesX(mip) * texture->file.getPagesY(mip), -1);
+	}
+	for (int level = 0; level < PAGE_TABLE_LEVELS; level++) {
+		int size = MAX_PAGES >> level;
+		texture->entries[level].assign((size_t)size * size, 0);
+		texture->dirty[level] = true;
+	}
+
+	// The single page of the coarsest mip is loaded now and pinned, every lookup can fall back to it
+	int topMip = texture->file.getMipCount() - 1;
+	unsigned int key = makePageKey(index, topMip, 0, 0);
+	LoadedPage page;
+	page.key = key;
+	page.texels = freeBuffers.back();
+	freeBuffers.pop_back();
+	page.valid = texture->file.readPage(topMip, 0, 0, page.texels);
+	uploadPage(page);
+	cache.pin(cache.find(key));
+	uploadPageTables();
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << (built ? "Built virtual texture " : "Opened virtual texture ") << imagePath << ": " << texture->file.getWidth() << "x"
+		<< texture->file.getHeight() << ", " << texture->file.getMipCount() << " mips, " << texture->file.getPageCount() << " pages in "
+		<< milliseconds << " ms" << std::endl;
+	return index;
+}
+
+void VirtualTextureSystem::resizeFeedback(int width, int height) {
+	int targetWidth = (width + FEEDBACK_DIVISOR - 1) / FEEDBACK_DIVISOR;
+	int targetHeight = (height + FEEDBACK_DIVISOR - 1) / FEEDBACK_DIVISOR;
+	if (targetWidth == feedbackWidth && targetHeight == feedbackHeight) {
+		return;
+	}
+	feedbackWidth = targetWidth;
+	feedbackHeight = targetHeight;
+
+	if (feedbackFramebuffer == 0) {
+		glGenFramebuffers(1, &feedbackFramebuffer);
+		glGenRenderbuffers(1, &feedbackColor);
+		glGenRenderbuffers(1, &feedbackDepth);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, feedbackColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, feedbackWidth, feedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, feedbackColor);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Virtual texture feedback target is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPixels);
+	glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)feedbackWidth * feedbackHeight * sizeof(unsigned int), NULL, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void VirtualTextureSystem::renderFeedback(MeshBuffer& meshBuffer, const glm::mat4& view, const glm::mat4& proj, int width, int height) {
+	if (textures.empty() || feedbackFence != 0) {
+		return;
+	}
+	resizeFeedback(width, height);
+
+	GLint previousFramebuffer;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+	glViewport(0, 0, feedbackWidth, feedbackHeight);
+	GLuint clear[4] = { 0, 0, 0, 0 };
+	glClearBufferuiv(GL_COLOR, 0, clear);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	feedbackShader->use();
+	feedbackShader->setMat4("view", view);
+	feedbackShader->setMat4("proj", proj);
+	// The target is FEEDBACK_DIVISOR times smaller, so its derivatives are that much larger than the screen's
+	feedbackShader->setFloat("lodBias", -log2f((float)FEEDBACK_DIVISOR));
+	bind(feedbackShader);
+	meshBuffer.submit();
+
+	// Into the pixel buffer, mapped a frame or more later once the fence says the copy is done
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPixels);
+	glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	feedbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+
+void VirtualTextureSystem::readFeedback() {
+	if (feedbackFence == 0) {
+		return;
+	}
+	GLenum status = glClientWaitSync(feedbackFence, 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+		return;
+	}
+	glDeleteSync(feedbackFence);
+	feedbackFence = 0;
+
+	requests.clear();
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPixels);
+	const unsigned int* pixels = (const unsigned int*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+		(GLsizeiptr)feedbackWidth * feedbackHeight * sizeof(unsigned int), GL_MAP_READ_BIT);
+	if (pixels != nullptr) {
+		for (int i = 0; i < feedbackWidth * feedbackHeight; i++) {
+			if (pixels[i] & FEEDBACK_VALID) {
+				requests.push_back(pixels[i] & ~FEEDBACK_VALID);
+			}
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Coarse pages first: they cover the most screen and let the finer ones be refined from something close
+	std::sort(requests.begin(), requests.end(), [](unsigned int a, unsigned int b) {
+		return pageKeyMip(a) != pageKeyMip(b) ? pageKeyMip(a) > pageKeyMip(b) : a < b;
+	});
+	requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+	requestedPages = (int)requests.size();
+}
+
+void VirtualTextureSystem::touchRequests() {
+	for (unsigned int key : requests) {
+		unsigned int textureIndex = pageKeyTexture(key);
+		if (textureIndex >= textures.size()) {
+			continue;
+		}
+		if (cache.touch(key, frame) >= 0) {
+			continue;
+		}
+		requestPage(key);
+
+		// Whatever is drawn in its place until it arrives is in use too, and must not be evicted meanwhile
+		int mipCount = textures[textureIndex]->file.getMipCount();
+		for (unsigned int mip = pageKeyMip(key) + 1; mip < (unsigned int)mipCount; mip++) {
+			unsigned int shift = mip - pageKeyMip(key);
+			int slot = cache.find(makePageKey(textureIndex, mip, pageKeyX(key) >> shift, pageKeyY(key) >> shift));
+			if (slot >= 0) {
+				cache.use(slot, frame);
+				break;
+			}
+		}
+	}
+}
+
+void VirtualTextureSystem::requestPage(unsigned int key) {
+	if (freeBuffers.empty() || pending.count(key) != 0) {
+		return;
+	}
+	pending.insert(key);
+	unsigned char* texels = freeBuffers.back();
+	freeBuffers.pop_back();
+
+	VirtualTexture* texture = textures[pageKeyTexture(key)];
+	reads.push_back(readThread.submit([this, texture, key, texels]() {
+		LoadedPage page;
+		page.key = key;
+		page.texels = texels;
+		page.valid = texture->file.readPage(pageKeyMip(key), pageKeyX(key), pageKeyY(key), texels);
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		loaded.push_back(page);
+	}));
+}
+
+void VirtualTextureSystem::update() {
+	frame++;
+	readFeedback();
+	// Every frame and not only when a readback lands, so the pages on screen stay the most recently used
+	touchRequests();
+
+	// Forget the reads that have finished, their pages are in loaded
+	reads.erase(std::remove_if(reads.begin(), reads.end(), [](std::future<void>& read) {
+		return read.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), reads.end());
+	{
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		uploads.insert(uploads.end(), loaded.begin(), loaded.end());
+		loaded.clear();
+	}
+
+	// A bounded number of uploads a frame keeps a burst of requests from turning into a hitch
+	uploadsLastFrame = 0;
+	size_t count = uploads.size() < MAX_UPLOADS_PER_FRAME ? uploads.size() : MAX_UPLOADS_PER_FRAME;
+	for (size_t i = 0; i < count; i++) {
+		uploadPage(uploads[i]);
+		pending.erase(uploads[i].key);
+		uploadsLastFrame++;
+	}
+	uploads.erase(uploads.begin(), uploads.begin() + count);
+	uploadPageTables();
+}
+
+void VirtualTextureSystem::uploadPage(const LoadedPage& page) {
+	unsigned int evicted;
+	int slot = page.valid ? cache.allocate(page.key, frame, evicted) : -1;
+	// No slot means the cache is full of pages on screen this frame; the page is dropped and asked for again
+	if (slot >= 0) {
+		int x = (slot % slotsPerRow) * VirtualTextureFile::PAGE_STRIDE;
+		int y = (slot / slotsPerRow) * VirtualTextureFile::PAGE_STRIDE;
+		glBindTexture(GL_TEXTURE_2D, cacheTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, VirtualTextureFile::PAGE_STRIDE, VirtualTextureFile::PAGE_STRIDE, GL_RGBA, GL_UNSIGNED_BYTE, page.texels);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		if (evicted != PageCache::INVALID_KEY) {
+			setResident(evicted, -1);
+		}
+		setResident(page.key, slot);
+	}
+	freeBuffers.push_back(page.texels);
+}
+
+void VirtualTextureSystem::setResident(unsigned int key, int slot) {
+	VirtualTexture& texture = *textures[pageKeyTexture(key)];
+	int mip = pageKeyMip(key);
+	int x = pageKeyX(key);
+	int y = pageKeyY(key);
+	texture.slots[mip][(size_t)y * texture.file.getPagesX(mip) + x] = (short)slot;
+	refreshEntries(texture, mip, x, y);
+}
+
+void VirtualTextureSystem::refreshEntries(VirtualTexture& texture, int mip, int x, int y) {
+	// The page's own entry and everything under it at the finer mips, each finer entry that has no
+	// page of its own takes its parent's, so this runs from the changed mip downwards
+	for (int level = mip; level >= 0; level--) {
+		if (level >= PAGE_TABLE_LEVELS) {
+			continue;
+		}
+		int scale = 1 << (mip - level);
+		int pagesX = texture.file.getPagesX(level);
+		int pagesY = texture.file.getPagesY(level);
+		int tableSize = MAX_PAGES >> level;
+		int parentSize = MAX_PAGES >> (level + 1);
+		bool hasParent = level + 1 < texture.file.getMipCount() && level + 1 < PAGE_TABLE_LEVELS;
+		int endY = (y + 1) * scale < pagesY ? (y + 1) * scale : pagesY;
+		int endX = (x + 1) * scale < pagesX ? (x + 1) * scale : pagesX;
+		for (int py = y * scale; py < endY; py++) {
+			for (int px = x * scale; px < endX; px++) {
+				int slot = texture.slots[level][(size_t)py * pagesX + px];
+				unsigned int entry = 0;
+				if (slot >= 0) {
+					entry = packEntry(slot, slotsPerRow, level);
+				}
+				else if (hasParent) {
+					entry = texture.entries[level + 1][(size_t)(py / 2) * parentSize + px / 2];
+				}
+				texture.entries[level][(size_t)py * tableSize + px] = entry;
+			}
+		}
+		texture.dirty[level] = true;
+	}
+}
+
+void VirtualTextureSystem::uploadPageTables() {
+	glBindTexture(GL_TEXTURE_2D_ARRAY, pageTable);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (size_t i = 0; i < textures.size(); i++) {
+		for (int level = 0; level < PAGE_TABLE_LEVELS; level++) {
+			if (!textures[i]->dirty[level]) {
+				continue;
+			}
+			int size = MAX_PAGES >> level;
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, (GLint)i, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, &textures[i]->entries[level][0]);
+			textures[i]->dirty[level] = false;
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void VirtualTextureSystem::bind(Shader* shader) {
+	glActiveTexture(GL_TEXTURE0 + CACHE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, cacheTexture);
+	glActiveTexture(GL_TEXTURE0 + PAGE_TABLE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, pageTable);
+	glActiveTexture(GL_TEXTURE0);
+
+	// Size in texels and mip count of each texture, and the cache layout
+	glm::vec4 info[MAX_TEXTURES];
+	for (size_t i = 0; i < textures.size(); i++) {
+		const VirtualTextureFile& file = textures[i]->file;
+		info[i] = glm::vec4((float)file.getWidth(), (float)file.getHeight(), (float)file.getMipCount(), 0.0f);
+	}
+	if (!textures.empty()) {
+		glUniform4fv(glGetUniformLocation(shader->ID, "virtualTextures"), (GLsizei)textures.size(), glm::value_ptr(info[0]));
+	}
+	float cacheSize = (float)(slotsPerRow * VirtualTextureFile::PAGE_STRIDE);
+	glUniform1f(glGetUniformLocation(shader->ID, "pageCacheSize"), cacheSize);
+}
+
+long long VirtualTextureSystem::getVirtualBytes() const {
+	long long pages = 0;
+	for (const VirtualTexture* texture : textures) {
+		pages += texture->file.getPageCount();
+	}
+	return pages * (long long)VirtualTextureFile::PAGE_BYTES;
+}
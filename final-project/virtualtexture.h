@@ -0,0 +1,175 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+#include <mutex>
+#include <future>
+#include <unordered_set>
+#include <stdio.h>
+
+// OpenGL
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project includes - needed for definitions
+#include "shader.h"
+#include "meshbuffer.h"
+#include "threadpool.h"
+#include "pagecache.h"
+
+// A texture cut into PAGE_SIZE x PAGE_SIZE pages at every mip level and stored page by page, so any one page is
+// a single read. Each page carries a PAGE_BORDER texel border taken from its (wrapped) neighbours, which lets
+// the cache texture filter bilinearly inside a page without reaching into the next slot
+//   header  VirtualTextureHeader
+//   pages   mip 0 row by row, then mip 1 and so on, each PAGE_STRIDE x PAGE_STRIDE RGBA8 texels
+// Mips halve until the whole level fits in one page
+class VirtualTextureFile {
+public:
+	static constexpr int PAGE_SIZE = 128;
+	static constexpr int PAGE_BORDER = 4;
+	static constexpr int PAGE_STRIDE = PAGE_SIZE + 2 * PAGE_BORDER;
+	static constexpr size_t PAGE_BYTES = PAGE_STRIDE * PAGE_STRIDE * 4;
+	static constexpr int MAX_MIPS = 16;
+
+	VirtualTextureFile();
+	~VirtualTextureFile();
+
+	// Decodes the image and writes every page of every mip to outPath
+	static bool build(const std::string& imagePath, const std::string& outPath);
+	bool open(const std::string& path);
+	// PAGE_BYTES into out, safe to call from several threads
+	bool readPage(int mip, int x, int y, unsigned char* out);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getMipCount() const { return mipCount; }
+	int getLevelWidth(int mip) const { return (width >> mip) > 0 ? width >> mip : 1; }
+	int getLevelHeight(int mip) const { return (height >> mip) > 0 ? height >> mip : 1; }
+	int getPagesX(int mip) const { return (getLevelWidth(mip) + PAGE_SIZE - 1) / PAGE_SIZE; }
+	int getPagesY(int mip) const { return (getLevelHeight(mip) + PAGE_SIZE - 1) / PAGE_SIZE; }
+	long long getPageCount() const { return firstPage[mipCount]; }
+
+	VirtualTextureFile(const VirtualTextureFile&) = delete;
+	VirtualTextureFile& operator=(const VirtualTextureFile&) = delete;
+
+private:
+	struct VirtualTextureHeader {
+		unsigned int magic;
+		unsigned int pageSize;
+		unsigned int border;
+		int width;
+		int height;
+		int mipCount;
+	};
+	static constexpr unsigned int VIRTUAL_TEXTURE_MAGIC = 0x58545647; // "GVTX"
+
+	FILE* file;
+	std::mutex fileMutex;
+	int width, height, mipCount;
+	long long firstPage[MAX_MIPS + 1]; // index of each mip's first page in the file
+};
+
+// Software virtual texturing. Only the pages the camera actually needs are resident, in one physical cache
+// texture of fixed size shared by every virtual texture, so the texture set of a scene can be far larger than
+// what fits in video memory.
+//  - A feedback pass renders the draw list at 1/FEEDBACK_DIVISOR resolution, writing the page and mip each pixel
+//    samples, and reads it back through a pixel buffer without waiting on the GPU
+//  - update() turns the feedback into page requests, coarsest mip first, and hands the reads to a thread of
+//    its own, so disk reads never queue in front of the shared pool's jobs that the render thread waits on
+//  - Finished pages are uploaded into the slot the PageCache frees, a few per frame
+//  - A page table per texture (one layer of an array, one level per mip) maps every virtual page to its slot.
+//    Pages that aren't resident point at their nearest resident ancestor, and the coarsest mip is pinned, so
+//    sampling always finds something and just gets sharper as pages arrive
+class VirtualTextureSystem {
+public:
+	// Texture units read by indirectFragmentShader.txt and gbufferFragmentShader.txt under VIRTUAL_TEXTURE
+	static constexpr GLuint CACHE_UNIT = 15;
+	static constexpr GLuint PAGE_TABLE_UNIT = 16;
+	static constexpr int MAX_TEXTURES = 16;
+	// Page table size at mip 0, so virtual textures go up to MAX_PAGES * PAGE_SIZE (16K) on a side
+	static constexpr int MAX_PAGES = 128;
+	static constexpr int PAGE_TABLE_LEVELS = 8;
+	static constexpr int FEEDBACK_DIVISOR = 8;
+	// Feedback pixels carry this bit, cleared pixels are 0
+	static constexpr unsigned int FEEDBACK_VALID = 0x80000000u;
+	static constexpr int MAX_PENDING_READS = 64;
+	static constexpr int MAX_UPLOADS_PER_FRAME = 16;
+
+	// The cache is slotsPerRow x slotsPerRow pages
+	VirtualTextureSystem(int slotsPerRow);
+	~VirtualTextureSystem();
+
+	// Builds the tiled file under texturecache/ the first time an image is seen. Returns the index to give
+	// MaterialLibrary::setVirtualTexture, or -1
+	int addTexture(const std::string& imagePath);
+	size_t getTextureCount() const { return textures.size(); }
+
+	// Draws meshBuffer's draw list into the feedback target. Skipped while the last readback is still in flight
+	void renderFeedback(MeshBuffer& meshBuffer, const glm::mat4& view, const glm::mat4& proj, int width, int height);
+	// Once a frame: requests the pages of the newest feedback and uploads finished ones
+	void update();
+	void bind(Shader* shader);
+
+	Shader* getFeedbackShader() { return feedbackShader; }
+	const PageCache& getCache() const { return cache; }
+	int getPendingReads() const { return (int)pending.size(); }
+	int getRequestedPages() const { return requestedPages; }
+	int getUploadsLastFrame() const { return uploadsLastFrame; }
+	// Bytes of every page of every texture against the bytes of the cache texture
+	long long getVirtualBytes() const;
+	long long getCacheBytes() const { return (long long)cache.getSlotCount() * VirtualTextureFile::PAGE_BYTES; }
+
+private:
+	struct VirtualTexture {
+		VirtualTextureFile file;
+		std::vector<short> slots[VirtualTextureFile::MAX_MIPS]; // per page, -1 when not resident
+		std::vector<unsigned int> entries[PAGE_TABLE_LEVELS];   // RGBA8 page table texels, MAX_PAGES >> level squared
+		bool dirty[PAGE_TABLE_LEVELS];
+	};
+
+	// A page read by a worker, waiting for the render thread to upload it
+	struct LoadedPage {
+		unsigned int key;
+		unsigned char* texels;
+		bool valid;
+	};
+
+	// One thread is enough, the reads take turns on the file anyway
+	ThreadPool readThread;
+	PageCache cache;
+	int slotsPerRow;
+	unsigned long long frame;
+
+	std::vector<VirtualTexture*> textures;
+	GLuint cacheTexture;
+	GLuint pageTable;
+
+	Shader* feedbackShader;
+	GLuint feedbackFramebuffer, feedbackColor, feedbackDepth;
+	int feedbackWidth, feedbackHeight;
+	GLuint feedbackPixels;
+	GLsync feedbackFence;
+	std::vector<unsigned int> requests; // pages of the newest feedback, coarsest first
+	int requestedPages;
+
+	std::unordered_set<unsigned int> pending;
+	std::vector<std::future<void>> reads;
+	std::vector<unsigned char*> freeBuffers;
+	std::mutex loadedMutex;
+	std::vector<LoadedPage> loaded;   // filled by the workers
+	std::vector<LoadedPage> uploads;  // taken from loaded, uploaded a few per frame
+	int uploadsLastFrame;
+
+	void readFeedback();
+	void touchRequests();
+	void requestPage(unsigned int key);
+	void uploadPage(const LoadedPage& page);
+	void setResident(unsigned int key, int slot);
+	void refreshEntries(VirtualTexture& texture, int mip, int x, int y);
+	void uploadPageTables();
+	void resizeFeedback(int width, int height);
+};
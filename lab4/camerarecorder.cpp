@@ -0,0 +1,136 @@
+#include "camerarecorder.h"
+
+// Standard library
+#include <iostream>
+#include <string.h>
+
+CameraRecorder::CameraRecorder() {
+	this->file = nullptr;
+	this->recordedFrames = 0;
+	this->replayIndex = 0;
+	this->replaying = false;
+	memset(&lastRecorded, 0, sizeof(lastRecorded));
+}
+
+CameraRecorder::~CameraRecorder() {
+	stopRecording();
+}
+
+bool CameraRecorder::startRecording(const std::string& path) {
+	stopRecording();
+	if (fopen_s(&file, path.c_str(), "wb") != 0 || file == nullptr) {
+		std::cerr << "CameraRecorder: could not write " << path << std::endl;
+		file = nullptr;
+		return false;
+	}
+	// The frame count is patched in by stopRecording()
+	unsigned int header[2] = { VERSION, 0 };
+	fwrite("GCAM", 1, 4, file);
+	fwrite(header, sizeof(unsigned int), 2, file);
+	recordPath = path;
+	recordedFrames = 0;
+	std::cout << "Recording camera to " << path << std::endl;
+	return true;
+}
+
+void CameraRecorder::record(const CameraFrame& frame) {
+	if (file == nullptr) {
+		return;
+	}
+	// The first frame always carries the state so a replay starts from the same settings
+	bool changed = recordedFrames == 0 || frame.material != lastRecorded.material ||
+		frame.mipmapMode != lastRecorded.mipmapMode || frame.anisotropyLevel != lastRecorded.anisotropyLevel ||
+		frame.textureScale != lastRecorded.textureScale;
+
+	unsigned char flags = changed ? STATE_CHANGED : 0;
+	float pose[8] = { frame.position.x, frame.position.y, frame.position.z,
+		frame.direction.x, frame.direction.y, frame.direction.z, frame.yaw, frame.pitch };
+	fwrite(&flags, 1, 1, file);
+	fwrite(pose, sizeof(float), 8, file);
+	if (changed) {
+		unsigned char state[3] = { (unsigned char)frame.material, (unsigned char)frame.mipmapMode, (unsigned char)frame.anisotropyLevel };
+		fwrite(state, 1, 3, file);
+		fwrite(&frame.textureScale, sizeof(float), 1, file);
+	}
+
+	lastRecorded = frame;
+	recordedFrames++;
+}
+
+void CameraRecorder::stopRecording() {
+	if (file == nullptr) {
+		return;
+	}
+	fseek(file, 8, SEEK_SET);
+	fwrite(&recordedFrames, sizeof(unsigned int), 1, file);
+	fclose(file);
+	file = nullptr;
+	std::cout << "Recorded " << recordedFrames << " frames to " << recordPath << std::endl;
+}
+
+bool CameraRecorder::load(const std::string& path) {
+	FILE* input = nullptr;
+	if (fopen_s(&input, path.c_str(), "rb") != 0 || input == nullptr) {
+		std::cerr << "CameraRecorder: could not open " << path << std::endl;
+		return false;
+	}
+
+	char magic[4];
+	unsigned int header[2];
+	if (fread(magic, 1, 4, input) != 4 || memcmp(magic, "GCAM", 4) != 0 ||
+		fread(header, sizeof(unsigned int), 2, input) != 2 || header[0] != VERSION) {
+		std::cerr << "CameraRecorder: " << path << " is not a version " << VERSION << " camera log" << std::endl;
+		fclose(input);
+		return false;
+	}
+
+	// Every frame is at least the flags and the pose, so a bad count can't reserve more than the file holds
+	long start = ftell(input);
+	fseek(input, 0, SEEK_END);
+	long end = ftell(input);
+	fseek(input, start, SEEK_SET);
+	size_t maxFrames = (size_t)(end - start) / (1 + 8 * sizeof(float));
+
+	frames.clear();
+	frames.reserve(header[1] < maxFrames ? header[1] : maxFrames);
+	CameraFrame frame;
+	memset(&frame, 0, sizeof(frame));
+	for (unsigned int i = 0; i < header[1]; i++) {
+		unsigned char flags;
+		float pose[8];
+		if (fread(&flags, 1, 1, input) != 1 || fread(pose, sizeof(float), 8, input) != 8) {
+			break;
+		}
+		frame.position = glm::vec3(pose[0], pose[1], pose[2]);
+		frame.direction = glm::vec3(pose[3], pose[4], pose[5]);
+		frame.yaw = pose[6];
+		frame.pitch = pose[7];
+		if (flags & STATE_CHANGED) {
+			unsigned char state[3];
+			if (fread(state, 1, 3, input) != 3 || fread(&frame.textureScale, sizeof(float), 1, input) != 1) {
+				break;
+			}
+			frame.material = state[0];
+			frame.mipmapMode = state[1];
+			frame.anisotropyLevel = state[2];
+		}
+		frames.push_back(frame);
+	}
+	fclose(input);
+
+	if (frames.size() != header[1]) {
+		std::cerr << "CameraRecorder: " << path << " is truncated, " << frames.size() << " of " << header[1] << " frames read" << std::endl;
+	}
+	replayIndex = 0;
+	replaying = !frames.empty();
+	return replaying;
+}
+
+bool CameraRecorder::next(CameraFrame& frame) {
+	if (!replaying || replayIndex >= frames.size()) {
+		replaying = false;
+		return false;
+	}
+	frame = frames[replayIndex++];
+	return true;
+}
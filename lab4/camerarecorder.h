@@ -0,0 +1,61 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Everything that decides what one frame draws: the camera pose and the GUI state
+struct CameraFrame {
+	glm::vec3 position;
+	glm::vec3 direction;
+	float yaw;
+	float pitch;
+	int material;
+	int mipmapMode;
+	int anisotropyLevel;
+	float textureScale;
+};
+
+// Records one CameraFrame per frame to a binary log and plays it back. The pose is stored every frame,
+// the GUI state only on the frames it changed, so a log is 33 bytes a frame for a plain flythrough.
+//   header  "GCAM", uint32 version, uint32 frame count
+//   frame   uint8 flags, 8 floats pose; if flags & STATE_CHANGED: uint8 material, uint8 mipmap mode, uint8 anisotropy level,
+//           float texture scale
+class CameraRecorder {
+public:
+	// Replay advances the scene by this much per frame whatever the real frame time was
+	static constexpr float FIXED_TIMESTEP = 1.0f / 60.0f;
+
+	CameraRecorder();
+	~CameraRecorder();
+
+	bool startRecording(const std::string& path);
+	void record(const CameraFrame& frame);
+	// Writes the frame count into the header and closes the file
+	void stopRecording();
+	bool isRecording() const { return file != nullptr; }
+
+	bool load(const std::string& path);
+	// Copies the next frame out, false once the log is exhausted
+	bool next(CameraFrame& frame);
+	bool isReplaying() const { return replaying; }
+	size_t getFrameCount() const { return frames.size(); }
+
+private:
+	static constexpr unsigned int VERSION = 2;
+	static constexpr unsigned char STATE_CHANGED = 1;
+
+	FILE* file;
+	std::string recordPath;
+	unsigned int recordedFrames;
+	CameraFrame lastRecorded;
+
+	std::vector<CameraFrame> frames;
+	size_t replayIndex;
+	bool replaying;
+};
@@ -0,0 +1,424 @@
+#include "glcapture.h"
+
+// Standard library
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+std::string GLCapture::pendingPath;
+bool GLCapture::pending = false;
+bool GLCapture::timing = false;
+bool GLCapture::timed = false;
+bool GLCapture::capturing = false;
+int GLCapture::frameWidth = 0;
+int GLCapture::frameHeight = 0;
+std::chrono::high_resolution_clock::time_point GLCapture::frameStart;
+GLuint GLCapture::frameQuery = 0;
+double GLCapture::frameCpuMilliseconds = 0.0;
+double GLCapture::frameGpuMilliseconds = 0.0;
+
+std::vector<unsigned char> GLCapture::commands;
+std::set<GLuint> GLCapture::programs;
+std::set<GLuint> GLCapture::vertexArrays;
+std::set<std::pair<GLenum, GLuint>> GLCapture::textures;
+std::set<GLuint> GLCapture::samplers;
+
+static void append(std::vector<unsigned char>& out, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	out.insert(out.end(), bytes, bytes + size);
+}
+
+template <typename T>
+static void appendValue(std::vector<unsigned char>& out, T value) {
+	append(out, &value, sizeof(T));
+}
+
+static void appendString(std::vector<unsigned char>& out, const std::string& text) {
+	appendValue(out, (unsigned int)text.size());
+	append(out, text.data(), text.size());
+}
+
+void GLCapture::capture(const std::string& path) {
+	pendingPath = path;
+	pending = true;
+}
+
+void GLCapture::beginFrame(int width, int height) {
+	// The frame before the capture runs as normal and gives the times, recording the commands would add to them
+	if (pending) {
+		pending = false;
+		timing = true;
+		if (frameQuery == 0) {
+			glGenQueries(1, &frameQuery);
+		}
+		glBeginQuery(GL_TIME_ELAPSED, frameQuery);
+		frameStart = std::chrono::high_resolution_clock::now();
+		return;
+	}
+	if (!timed) {
+		return;
+	}
+	timed = false;
+	capturing = true;
+	frameWidth = width;
+	frameHeight = height;
+	commands.clear();
+	programs.clear();
+	vertexArrays.clear();
+	textures.clear();
+	samplers.clear();
+}
+
+void GLCapture::endFrame() {
+	if (timing) {
+		frameCpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+		glEndQuery(GL_TIME_ELAPSED);
+		timing = false;
+		timed = true;
+
+		// Only the timed frame waits for its query
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(frameQuery, GL_QUERY_RESULT, &elapsed);
+		frameGpuMilliseconds = elapsed / 1000000.0;
+		return;
+	}
+	if (!capturing) {
+		return;
+	}
+	capturing = false;
+	write();
+}
+
+void GLCapture::put(const void* data, size_t size) {
+	append(commands, data, size);
+}
+
+void GLCapture::putString(const std::string& text) {
+	appendString(commands, text);
+}
+
+void GLCapture::putUniform(Command command, GLuint program, const std::string& name, const float* values, int count) {
+	programs.insert(program);
+	put(&command, 1);
+	put(&program, sizeof(GLuint));
+	putString(name);
+	put(values, count * sizeof(float));
+}
+
+void GLCapture::useProgram(GLuint program) {
+	glUseProgram(program);
+	if (capturing) {
+		programs.insert(program);
+		Command command = USE_PROGRAM;
+		put(&command, 1);
+		put(&program, sizeof(GLuint));
+	}
+}
+
+void GLCapture::uniform(GLuint program, const std::string& name, int value) {
+	glUniform1i(glGetUniformLocation(program, name.c_str()), value);
+	if (capturing) {
+		programs.insert(program);
+		Command command = UNIFORM_INT;
+		put(&command, 1);
+		put(&program, sizeof(GLuint));
+		putString(name);
+		put(&value, sizeof(int));
+	}
+}
+
+void GLCapture::uniform(GLuint program, const std::string& name, float value) {
+	glUniform1f(glGetUniformLocation(program, name.c_str()), value);
+	if (capturing) {
+		putUniform(UNIFORM_FLOAT, program, name, &value, 1);
+	}
+}
+
+void GLCapture::uniform(GLuint program, const std::string& name, const glm::vec3& value) {
+	glUniform3fv(glGetUniformLocation(program, name.c_str()), 1, glm::value_ptr(value));
+	if (capturing) {
+		putUniform(UNIFORM_VEC3, program, name, glm::value_ptr(value), 3);
+	}
+}
+
+void GLCapture::uniform(GLuint program, const std::string& name, const glm::mat4& value) {
+	glUniformMatrix4fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	if (capturing) {
+		putUniform(UNIFORM_MAT4, program, name, glm::value_ptr(value), 16);
+	}
+}
+
+void GLCapture::activeTexture(GLenum unit) {
+	glActiveTexture(unit);
+	if (capturing) {
+		Command command = ACTIVE_TEXTURE;
+		put(&command, 1);
+		put(&unit, sizeof(GLenum));
+	}
+}
+
+void GLCapture::bindTexture(GLenum target, GLuint texture) {
+	glBindTexture(target, texture);
+	if (capturing) {
+		if (texture != 0) {
+			textures.insert(std::make_pair(target, texture));
+		}
+		Command command = BIND_TEXTURE;
+		put(&command, 1);
+		put(&target, sizeof(GLenum));
+		put(&texture, sizeof(GLuint));
+	}
+}
+
+void GLCapture::bindSampler(GLuint unit, GLuint sampler) {
+	glBindSampler(unit, sampler);
+	if (capturing) {
+		Command command = BIND_SAMPLER;
+		put(&command, 1);
+		put(&unit, sizeof(GLuint));
+		put(&sampler, sizeof(GLuint));
+		if (sampler != 0) {
+			samplers.insert(sampler);
+		}
+	}
+}
+
+void GLCapture::bindVertexArray(GLuint vertexArray) {
+	glBindVertexArray(vertexArray);
+	if (capturing) {
+		if (vertexArray != 0) {
+			vertexArrays.insert(vertexArray);
+		}
+		Command command = BIND_VERTEX_ARRAY;
+		put(&command, 1);
+		put(&vertexArray, sizeof(GLuint));
+	}
+}
+
+void GLCapture::drawArrays(GLenum mode, GLint first, GLsizei count) {
+	glDrawArrays(mode, first, count);
+	if (capturing) {
+		Command command = DRAW_ARRAYS;
+		put(&command, 1);
+		put(&mode, sizeof(GLenum));
+		put(&first, sizeof(GLint));
+		put(&count, sizeof(GLsizei));
+	}
+}
+
+void GLCapture::enable(GLenum capability) {
+	glEnable(capability);
+	if (capturing) {
+		Command command = ENABLE;
+		put(&command, 1);
+		put(&capability, sizeof(GLenum));
+	}
+}
+
+void GLCapture::disable(GLenum capability) {
+	glDisable(capability);
+	if (capturing) {
+		Command command = DISABLE;
+		put(&command, 1);
+		put(&capability, sizeof(GLenum));
+	}
+}
+
+void GLCapture::depthFunc(GLenum function) {
+	glDepthFunc(function);
+	if (capturing) {
+		Command command = DEPTH_FUNC;
+		put(&command, 1);
+		put(&function, sizeof(GLenum));
+	}
+}
+
+void GLCapture::clearColor(float r, float g, float b, float a) {
+	glClearColor(r, g, b, a);
+	if (capturing) {
+		float color[4] = { r, g, b, a };
+		Command command = CLEAR_COLOR;
+		put(&command, 1);
+		put(color, sizeof(color));
+	}
+}
+
+void GLCapture::clear(GLbitfield mask) {
+	glClear(mask);
+	if (capturing) {
+		Command command = CLEAR;
+		put(&command, 1);
+		put(&mask, sizeof(GLbitfield));
+	}
+}
+
+bool GLCapture::write() {
+	std::vector<unsigned char> out;
+	append(out, "GLCF", 4);
+	appendValue(out, VERSION);
+	appendValue(out, (int)frameWidth);
+	appendValue(out, (int)frameHeight);
+	appendValue(out, (float)frameCpuMilliseconds);
+	appendValue(out, (float)frameGpuMilliseconds);
+
+	// Programs as their shader sources, with the attribute locations the replay has to bind before linking
+	appendValue(out, (unsigned int)programs.size());
+	for (GLuint program : programs) {
+		GLuint shaders[8];
+		GLsizei shaderCount = 0;
+		glGetAttachedShaders(program, 8, &shaderCount, shaders);
+		appendValue(out, program);
+		appendValue(out, (unsigned int)shaderCount);
+		for (GLsizei i = 0; i < shaderCount; i++) {
+			GLint type = 0, length = 0;
+			glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+			glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length);
+			std::string source(length > 0 ? length : 1, '\0');
+			glGetShaderSource(shaders[i], (GLsizei)source.size(), nullptr, &source[0]);
+			source.resize(strlen(source.c_str()));
+			appendValue(out, (GLenum)type);
+			appendString(out, source);
+		}
+
+		GLint attributeCount = 0;
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attributeCount);
+		appendValue(out, (unsigned int)attributeCount);
+		for (GLint i = 0; i < attributeCount; i++) {
+			char name[256];
+			GLint size;
+			GLenum type;
+			glGetActiveAttrib(program, i, sizeof(name), nullptr, &size, &type, name);
+			appendValue(out, (GLint)glGetAttribLocation(program, name));
+			appendString(out, name);
+		}
+	}
+
+	// Vertex arrays, collecting the buffers they source from
+	std::set<GLuint> buffers;
+	GLint previousArray = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousArray);
+	appendValue(out, (unsigned int)vertexArrays.size());
+	for (GLuint vertexArray : vertexArrays) {
+		glBindVertexArray(vertexArray);
+		GLint elementBuffer = 0;
+		glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+		appendValue(out, vertexArray);
+		appendValue(out, elementBuffer);
+		if (elementBuffer != 0) {
+			buffers.insert(elementBuffer);
+		}
+		for (GLuint a = 0; a < MAX_ATTRIBUTES; a++) {
+			GLint attribute[7];
+			glGetVertexAttribiv(a, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &attribute[0]);
+			glGetVertexAttribiv(a, GL_VERTEX_ATTRIB_ARRAY_SIZE, &attribute[1]);
+			glGetVertexAttribiv(a, GL_VERTEX_ATTRIB_ARRAY_TYPE, &attribute[2]);
+			glGetVertexAttribiv(a, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &attribute[3]);
+			glGetVertexAttribiv(a, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &attribute[4]);
+			glGetVertexAttribiv(a, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &attribute[5]);
+			void* pointer = nullptr;
+			glGetVertexAttribPointerv(a, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+			attribute[6] = (GLint)(intptr_t)pointer;
+			append(out, attribute, sizeof(attribute));
+			if (attribute[0] && attribute[5] != 0) {
+				buffers.insert(attribute[5]);
+			}
+		}
+	}
+	glBindVertexArray(previousArray);
+
+	appendValue(out, (unsigned int)buffers.size());
+	for (GLuint buffer : buffers) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		GLint size = 0;
+		glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+		std::vector<unsigned char> data(size);
+		if (size > 0) {
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, data.data());
+		}
+		appendValue(out, buffer);
+		appendValue(out, (unsigned int)size);
+		append(out, data.data(), data.size());
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	// Textures are read back as RGBA8 whatever their format, every level of every face
+	GLint previousUnit = 0;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &previousUnit);
+	glActiveTexture(GL_TEXTURE0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	appendValue(out, (unsigned int)textures.size());
+	for (const auto& texture : textures) {
+		GLenum target = texture.first;
+		glBindTexture(target, texture.second);
+		GLint parameters[5];
+		glGetTexParameteriv(target, GL_TEXTURE_MIN_FILTER, &parameters[0]);
+		glGetTexParameteriv(target, GL_TEXTURE_MAG_FILTER, &parameters[1]);
+		glGetTexParameteriv(target, GL_TEXTURE_WRAP_S, &parameters[2]);
+		glGetTexParameteriv(target, GL_TEXTURE_WRAP_T, &parameters[3]);
+		glGetTexParameteriv(target, GL_TEXTURE_WRAP_R, &parameters[4]);
+		appendValue(out, texture.second);
+		appendValue(out, target);
+		append(out, parameters, sizeof(parameters));
+
+		unsigned int faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+		appendValue(out, faces);
+		for (unsigned int face = 0; face < faces; face++) {
+			GLenum faceTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+			unsigned int levels = 0;
+			GLint levelWidth = 0;
+			while (levels < 16) {
+				glGetTexLevelParameteriv(faceTarget, levels, GL_TEXTURE_WIDTH, &levelWidth);
+				if (levelWidth <= 0) {
+					break;
+				}
+				levels++;
+			}
+			appendValue(out, levels);
+			for (unsigned int level = 0; level < levels; level++) {
+				GLint width = 0, height = 0;
+				glGetTexLevelParameteriv(faceTarget, level, GL_TEXTURE_WIDTH, &width);
+				glGetTexLevelParameteriv(faceTarget, level, GL_TEXTURE_HEIGHT, &height);
+				std::vector<unsigned char> texels((size_t)width * height * 4);
+				glGetTexImage(faceTarget, level, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+				appendValue(out, width);
+				appendValue(out, height);
+				append(out, texels.data(), texels.size());
+			}
+		}
+		glBindTexture(target, 0);
+	}
+	glActiveTexture(previousUnit);
+
+	appendValue(out, (unsigned int)samplers.size());
+	for (GLuint sampler : samplers) {
+		GLint parameters[4];
+		glGetSamplerParameteriv(sampler, GL_TEXTURE_MIN_FILTER, &parameters[0]);
+		glGetSamplerParameteriv(sampler, GL_TEXTURE_MAG_FILTER, &parameters[1]);
+		glGetSamplerParameteriv(sampler, GL_TEXTURE_WRAP_S, &parameters[2]);
+		glGetSamplerParameteriv(sampler, GL_TEXTURE_WRAP_T, &parameters[3]);
+		float anisotropy = 1.0f;
+		if (GLEW_EXT_texture_filter_anisotropic) {
+			glGetSamplerParameterfv(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, &anisotropy);
+		}
+		appendValue(out, sampler);
+		append(out, parameters, sizeof(parameters));
+		appendValue(out, anisotropy);
+	}
+
+	appendValue(out, (unsigned int)commands.size());
+	append(out, commands.data(), commands.size());
+
+	FILE* file = nullptr;
+	if (fopen_s(&file, pendingPath.c_str(), "wb") != 0 || file == nullptr) {
+		std::cerr << "GLCapture: could not write " << pendingPath << std::endl;
+		return false;
+	}
+	fwrite(out.data(), 1, out.size(), file);
+	fclose(file);
+
+	std::cout << "Captured frame to " << pendingPath << ": " << commands.size() << " command bytes, " << programs.size() << " programs, "
+		<< buffers.size() << " buffers, " << textures.size() << " textures, " << out.size() / 1024 << " KB ("
+		<< frameCpuMilliseconds << " ms CPU, " << frameGpuMilliseconds << " ms GPU)" << std::endl;
+	return true;
+}
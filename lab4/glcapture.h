@@ -0,0 +1,97 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+
+// OpenGL
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Captures the GL commands of one frame. The renderer makes its per-frame GL calls through the wrappers
+// below, which forward to GL and, while a capture is running, append the command to a stream. At the end of
+// the frame the stream is written out with the contents of every program, buffer, vertex array and texture
+// it referenced, so GLReplay can run the frame again with none of the scene code
+//   header    "GLCF", uint32 version, int32 width, height, float frame CPU ms, float frame GPU ms
+//             (the times are of the frame before the capture, so the capture's own work isn't in them)
+//   programs  uint32 count; id, shader count, (type, source) each, attribute count, (location, name) each
+//   arrays    uint32 count; id, element buffer, MAX_ATTRIBUTES x (enabled, size, type, normalized, stride, buffer, offset)
+//   buffers   uint32 count; id, uint32 size, bytes
+//   textures  uint32 count; id, target, min/mag filter, wrap s/t/r, faces x levels x (width, height, RGBA8 texels)
+//   samplers  uint32 count; id, min/mag filter, wrap s/t, float max anisotropy
+//   commands  uint32 size, bytes; each command is a Command byte followed by its arguments
+// Strings are a uint32 length followed by the characters
+class GLCapture {
+public:
+	enum Command : unsigned char {
+		USE_PROGRAM,       // program
+		UNIFORM_INT,       // program, name, int
+		UNIFORM_FLOAT,     // program, name, float
+		UNIFORM_VEC3,      // program, name, 3 floats
+		UNIFORM_MAT4,      // program, name, 16 floats
+		ACTIVE_TEXTURE,    // unit
+		BIND_TEXTURE,      // target, texture
+		BIND_VERTEX_ARRAY, // vertex array
+		DRAW_ARRAYS,       // mode, first, count
+		ENABLE,            // capability
+		DISABLE,           // capability
+		DEPTH_FUNC,        // function
+		CLEAR_COLOR,       // 4 floats
+		CLEAR,             // mask
+		BIND_SAMPLER       // unit, sampler
+	};
+
+	static constexpr unsigned int VERSION = 3;
+	static constexpr int MAX_ATTRIBUTES = 8;
+
+	// Times the next frame and captures the one after it to path
+	static void capture(const std::string& path);
+	static bool isCapturing() { return capturing; }
+
+	// Bracket the commands of one frame. width and height are the size it renders at
+	static void beginFrame(int width, int height);
+	static void endFrame();
+
+	static void useProgram(GLuint program);
+	static void uniform(GLuint program, const std::string& name, int value);
+	static void uniform(GLuint program, const std::string& name, float value);
+	static void uniform(GLuint program, const std::string& name, const glm::vec3& value);
+	static void uniform(GLuint program, const std::string& name, const glm::mat4& value);
+	static void activeTexture(GLenum unit);
+	static void bindTexture(GLenum target, GLuint texture);
+	static void bindSampler(GLuint unit, GLuint sampler);
+	static void bindVertexArray(GLuint vertexArray);
+	static void drawArrays(GLenum mode, GLint first, GLsizei count);
+	static void enable(GLenum capability);
+	static void disable(GLenum capability);
+	static void depthFunc(GLenum function);
+	static void clearColor(float r, float g, float b, float a);
+	static void clear(GLbitfield mask);
+
+private:
+	static std::string pendingPath;
+	static bool pending;
+	static bool timing;
+	static bool timed;
+	static bool capturing;
+	static int frameWidth, frameHeight;
+	static std::chrono::high_resolution_clock::time_point frameStart;
+	static GLuint frameQuery;
+	static double frameCpuMilliseconds, frameGpuMilliseconds;
+
+	static std::vector<unsigned char> commands;
+	static std::set<GLuint> programs;
+	static std::set<GLuint> vertexArrays;
+	static std::set<std::pair<GLenum, GLuint>> textures;
+	static std::set<GLuint> samplers;
+
+	static void put(const void* data, size_t size);
+	static void putString(const std::string& text);
+	static void putUniform(Command command, GLuint program, const std::string& name, const float* values, int count);
+	static bool write();
+};
@@ -0,0 +1,466 @@
+#include "glreplay.h"
+
+// Standard library
+#include <iostream>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+// Bounds checked cursor over the capture file, failed stays set after the first short read
+struct CaptureReader {
+	std::vector<unsigned char> data;
+	size_t offset = 0;
+	bool failed = false;
+
+	void read(void* out, size_t size) {
+		if (failed || offset + size > data.size()) {
+			failed = true;
+			memset(out, 0, size);
+			return;
+		}
+		memcpy(out, data.data() + offset, size);
+		offset += size;
+	}
+
+	template <typename T>
+	T read() {
+		T value;
+		read(&value, sizeof(T));
+		return value;
+	}
+
+	// Whether count items of size bytes are left, checked before sizing anything from a count in the file
+	bool fits(size_t count, size_t size) {
+		if (failed || count > (data.size() - offset) / size) {
+			failed = true;
+		}
+		return !failed;
+	}
+
+	std::string readString() {
+		unsigned int length = read<unsigned int>();
+		if (failed || offset + length > data.size()) {
+			failed = true;
+			return "";
+		}
+		std::string text((const char*)data.data() + offset, length);
+		offset += length;
+		return text;
+	}
+};
+
+struct CapturedAttribute {
+	GLint enabled, size, type, normalized, stride, buffer, offset;
+};
+
+struct CapturedVertexArray {
+	GLuint id;
+	GLuint elementBuffer;
+	CapturedAttribute attributes[GLCapture::MAX_ATTRIBUTES];
+};
+
+static GLuint remap(const std::map<GLuint, GLuint>& names, GLuint name) {
+	auto found = names.find(name);
+	return found != names.end() ? found->second : 0;
+}
+
+GLReplay::GLReplay() {
+	this->width = 0;
+	this->height = 0;
+	this->capturedCpuMilliseconds = 0.0f;
+	this->capturedGpuMilliseconds = 0.0f;
+	this->framebuffer = 0;
+	this->colorTarget = 0;
+	this->depthTarget = 0;
+}
+
+GLReplay::~GLReplay() {
+	release();
+}
+
+bool GLReplay::load(const std::string& path) {
+	release();
+	this->path = path;
+
+	FILE* file = nullptr;
+	if (fopen_s(&file, path.c_str(), "rb") != 0 || file == nullptr) {
+		std::cerr << "GLReplay: could not open " << path << std::endl;
+		return false;
+	}
+	CaptureReader reader;
+	fseek(file, 0, SEEK_END);
+	reader.data.resize(ftell(file));
+	fseek(file, 0, SEEK_SET);
+	fread(reader.data.data(), 1, reader.data.size(), file);
+	fclose(file);
+
+	char magic[4];
+	reader.read(magic, 4);
+	if (reader.failed || memcmp(magic, "GLCF", 4) != 0 || reader.read<unsigned int>() != GLCapture::VERSION) {
+		std::cerr << "GLReplay: " << path << " is not a version " << GLCapture::VERSION << " frame capture" << std::endl;
+		return false;
+	}
+	width = reader.read<int>();
+	height = reader.read<int>();
+	capturedCpuMilliseconds = reader.read<float>();
+	capturedGpuMilliseconds = reader.read<float>();
+
+	// Attribute locations are bound before linking so the captured vertex arrays line up
+	unsigned int programCount = reader.read<unsigned int>();
+	for (unsigned int i = 0; i < programCount && !reader.failed; i++) {
+		GLuint id = reader.read<GLuint>();
+		GLuint program = glCreateProgram();
+		unsigned int shaderCount = reader.read<unsigned int>();
+		for (unsigned int s = 0; s < shaderCount && !reader.failed; s++) {
+			GLenum type = reader.read<GLenum>();
+			std::string source = reader.readString();
+			const char* text = source.c_str();
+			GLuint shader = glCreateShader(type);
+			glShaderSource(shader, 1, &text, nullptr);
+			glCompileShader(shader);
+			glAttachShader(program, shader);
+			glDeleteShader(shader);
+		}
+		unsigned int attributeCount = reader.read<unsigned int>();
+		for (unsigned int a = 0; a < attributeCount && !reader.failed; a++) {
+			GLint location = reader.read<GLint>();
+			std::string name = reader.readString();
+			if (location >= 0) {
+				glBindAttribLocation(program, location, name.c_str());
+			}
+		}
+		glLinkProgram(program);
+		GLint linked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			GLchar log[1024] = { '\0' };
+			glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+			std::cerr << "GLReplay: program " << id << " failed to link: " << log << std::endl;
+		}
+		programs[id] = program;
+	}
+
+	unsigned int arrayCount = reader.read<unsigned int>();
+	std::vector<CapturedVertexArray> capturedArrays(reader.fits(arrayCount, sizeof(CapturedVertexArray)) ? arrayCount : 0);
+	for (CapturedVertexArray& captured : capturedArrays) {
+		captured.id = reader.read<GLuint>();
+		captured.elementBuffer = (GLuint)reader.read<GLint>();
+		reader.read(captured.attributes, sizeof(captured.attributes));
+	}
+
+	unsigned int bufferCount = reader.read<unsigned int>();
+	for (unsigned int i = 0; i < bufferCount && !reader.failed; i++) {
+		GLuint id = reader.read<GLuint>();
+		unsigned int size = reader.read<unsigned int>();
+		if (!reader.fits(size, 1)) {
+			break;
+		}
+		std::vector<unsigned char> contents(size);
+		reader.read(contents.data(), size);
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, size, contents.data(), GL_STATIC_DRAW);
+		buffers[id] = buffer;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	for (const CapturedVertexArray& captured : capturedArrays) {
+		GLuint vertexArray;
+		glGenVertexArrays(1, &vertexArray);
+		glBindVertexArray(vertexArray);
+		for (GLuint a = 0; a < GLCapture::MAX_ATTRIBUTES; a++) {
+			const CapturedAttribute& attribute = captured.attributes[a];
+			if (!attribute.enabled) {
+				continue;
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, remap(buffers, attribute.buffer));
+			glEnableVertexAttribArray(a);
+			glVertexAttribPointer(a, attribute.size, attribute.type, (GLboolean)attribute.normalized, attribute.stride, (void*)(intptr_t)attribute.offset);
+		}
+		if (captured.elementBuffer != 0) {
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, remap(buffers, captured.elementBuffer));
+		}
+		vertexArrays[captured.id] = vertexArray;
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	unsigned int textureCount = reader.read<unsigned int>();
+	for (unsigned int i = 0; i < textureCount && !reader.failed; i++) {
+		GLuint id = reader.read<GLuint>();
+		GLenum target = reader.read<GLenum>();
+		GLint parameters[5];
+		reader.read(parameters, sizeof(parameters));
+
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(target, texture);
+		unsigned int faces = reader.read<unsigned int>();
+		unsigned int maxLevel = 0;
+		for (unsigned int face = 0; face < faces && !reader.failed; face++) {
+			GLenum faceTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+			unsigned int levels = reader.read<unsigned int>();
+			for (unsigned int level = 0; level < levels && !reader.failed; level++) {
+				GLint levelWidth = reader.read<GLint>();
+				GLint levelHeight = reader.read<GLint>();
+				if (levelWidth <= 0 || levelHeight <= 0 || !reader.fits((size_t)levelWidth * levelHeight, 4)) {
+					reader.failed = true;
+					break;
+				}
+				std::vector<unsigned char> texels((size_t)levelWidth * levelHeight * 4);
+				reader.read(texels.data(), texels.size());
+				glTexImage2D(faceTarget, level, GL_RGBA8, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+			}
+			maxLevel = levels > 0 ? levels - 1 : 0;
+		}
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, maxLevel);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, parameters[0]);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, parameters[1]);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, parameters[2]);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, parameters[3]);
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, parameters[4]);
+		glBindTexture(target, 0);
+		textures[id] = texture;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	unsigned int samplerCount = reader.read<unsigned int>();
+	for (unsigned int i = 0; i < samplerCount && !reader.failed; i++) {
+		GLuint id = reader.read<GLuint>();
+		GLint parameters[4];
+		reader.read(parameters, sizeof(parameters));
+		float anisotropy = reader.read<float>();
+		GLuint sampler;
+		glGenSamplers(1, &sampler);
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, parameters[0]);
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, parameters[1]);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, parameters[2]);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, parameters[3]);
+		if (GLEW_EXT_texture_filter_anisotropic) {
+			glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
+		}
+		samplers[id] = sampler;
+	}
+
+	// Decode the stream, the current program is tracked to resolve uniform names against it
+	CaptureReader stream;
+	unsigned int streamSize = reader.read<unsigned int>();
+	stream.data.resize(reader.fits(streamSize, 1) ? streamSize : 0);
+	reader.read(stream.data.data(), stream.data.size());
+	while (!reader.failed && !stream.failed && stream.offset < stream.data.size()) {
+		ReplayCommand command;
+		memset(&command, 0, sizeof(command));
+		command.command = (GLCapture::Command)stream.read<unsigned char>();
+		switch (command.command) {
+		case GLCapture::USE_PROGRAM:
+			command.object = remap(programs, stream.read<GLuint>());
+			break;
+		case GLCapture::UNIFORM_INT:
+		case GLCapture::UNIFORM_FLOAT:
+		case GLCapture::UNIFORM_VEC3:
+		case GLCapture::UNIFORM_MAT4: {
+			GLuint program = remap(programs, stream.read<GLuint>());
+			std::string name = stream.readString();
+			command.location = glGetUniformLocation(program, name.c_str());
+			if (command.command == GLCapture::UNIFORM_INT) {
+				command.value = stream.read<int>();
+			}
+			else {
+				int count = command.command == GLCapture::UNIFORM_FLOAT ? 1 : command.command == GLCapture::UNIFORM_VEC3 ? 3 : 16;
+				stream.read(command.values, count * sizeof(float));
+			}
+			break;
+		}
+		case GLCapture::ACTIVE_TEXTURE:
+		case GLCapture::ENABLE:
+		case GLCapture::DISABLE:
+		case GLCapture::DEPTH_FUNC:
+			command.target = stream.read<GLenum>();
+			break;
+		case GLCapture::BIND_TEXTURE:
+			command.target = stream.read<GLenum>();
+			command.object = remap(textures, stream.read<GLuint>());
+			break;
+		case GLCapture::BIND_VERTEX_ARRAY:
+			command.object = remap(vertexArrays, stream.read<GLuint>());
+			break;
+		case GLCapture::DRAW_ARRAYS:
+			command.target = stream.read<GLenum>();
+			command.location = stream.read<GLint>();
+			command.count = stream.read<GLsizei>();
+			break;
+		case GLCapture::CLEAR_COLOR:
+			stream.read(command.values, 4 * sizeof(float));
+			break;
+		case GLCapture::CLEAR:
+			command.target = stream.read<GLbitfield>();
+			break;
+		case GLCapture::BIND_SAMPLER:
+			command.target = stream.read<GLuint>();
+			command.object = remap(samplers, stream.read<GLuint>());
+			break;
+		default:
+			std::cerr << "GLReplay: unknown command " << (int)command.command << " at byte " << stream.offset - 1 << std::endl;
+			stream.failed = true;
+			continue;
+		}
+		commands.push_back(command);
+	}
+
+	if (reader.failed || stream.failed) {
+		std::cerr << "GLReplay: " << path << " is truncated or corrupt" << std::endl;
+		release();
+		return false;
+	}
+	std::cout << "Loaded " << path << ": " << width << "x" << height << ", " << commands.size() << " commands, " << programs.size()
+		<< " programs, " << buffers.size() << " buffers, " << textures.size() << " textures" << std::endl;
+	return true;
+}
+
+void GLReplay::execute() {
+	for (const ReplayCommand& command : commands) {
+		switch (command.command) {
+		case GLCapture::USE_PROGRAM:
+			glUseProgram(command.object);
+			break;
+		case GLCapture::UNIFORM_INT:
+			glUniform1i(command.location, command.value);
+			break;
+		case GLCapture::UNIFORM_FLOAT:
+			glUniform1f(command.location, command.values[0]);
+			break;
+		case GLCapture::UNIFORM_VEC3:
+			glUniform3fv(command.location, 1, command.values);
+			break;
+		case GLCapture::UNIFORM_MAT4:
+			glUniformMatrix4fv(command.location, 1, GL_FALSE, command.values);
+			break;
+		case GLCapture::ACTIVE_TEXTURE:
+			glActiveTexture(command.target);
+			break;
+		case GLCapture::BIND_TEXTURE:
+			glBindTexture(command.target, command.object);
+			break;
+		case GLCapture::BIND_VERTEX_ARRAY:
+			glBindVertexArray(command.object);
+			break;
+		case GLCapture::DRAW_ARRAYS:
+			glDrawArrays(command.target, command.location, command.count);
+			break;
+		case GLCapture::ENABLE:
+			glEnable(command.target);
+			break;
+		case GLCapture::DISABLE:
+			glDisable(command.target);
+			break;
+		case GLCapture::DEPTH_FUNC:
+			glDepthFunc(command.target);
+			break;
+		case GLCapture::CLEAR_COLOR:
+			glClearColor(command.values[0], command.values[1], command.values[2], command.values[3]);
+			break;
+		case GLCapture::CLEAR:
+			glClear(command.target);
+			break;
+		case GLCapture::BIND_SAMPLER:
+			glBindSampler(command.target, command.object);
+			break;
+		}
+	}
+}
+
+void GLReplay::run(int iterations) {
+	if (framebuffer == 0) {
+		glGenRenderbuffers(1, &colorTarget);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorTarget);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &depthTarget);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthTarget);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorTarget);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthTarget);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "GLReplay: offscreen target is incomplete" << std::endl;
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+
+	GLuint query;
+	glGenQueries(1, &query);
+
+	// The first run pays for any lazy driver work on the new objects
+	execute();
+	glFinish();
+
+	double cpuTotal = 0.0, cpuMin = 0.0, cpuMax = 0.0;
+	double gpuTotal = 0.0, gpuMin = 0.0, gpuMax = 0.0;
+	for (int i = 0; i < iterations; i++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		execute();
+		glEndQuery(GL_TIME_ELAPSED);
+		double cpu = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		glFinish();
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+		double gpu = elapsed / 1000000.0;
+
+		cpuMin = i == 0 || cpu < cpuMin ? cpu : cpuMin;
+		cpuMax = i == 0 || cpu > cpuMax ? cpu : cpuMax;
+		gpuMin = i == 0 || gpu < gpuMin ? gpu : gpuMin;
+		gpuMax = i == 0 || gpu > gpuMax ? gpu : gpuMax;
+		cpuTotal += cpu;
+		gpuTotal += gpu;
+	}
+	glDeleteQueries(1, &query);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (iterations <= 0) {
+		return;
+	}
+	double cpuMean = cpuTotal / iterations;
+	std::cout << "Replayed " << path << " " << iterations << " times" << std::endl;
+	std::cout << "  Replay CPU ms: mean " << cpuMean << ", min " << cpuMin << ", max " << cpuMax << std::endl;
+	std::cout << "  Replay GPU ms: mean " << gpuTotal / iterations << ", min " << gpuMin << ", max " << gpuMax << std::endl;
+	std::cout << "  Captured frame: " << capturedCpuMilliseconds << " ms CPU, " << capturedGpuMilliseconds << " ms GPU" << std::endl;
+	std::cout << "  Renderer CPU overhead: " << capturedCpuMilliseconds - cpuMean << " ms" << std::endl;
+}
+
+void GLReplay::release() {
+	for (const auto& program : programs) {
+		glDeleteProgram(program.second);
+	}
+	for (const auto& buffer : buffers) {
+		glDeleteBuffers(1, &buffer.second);
+	}
+	for (const auto& vertexArray : vertexArrays) {
+		glDeleteVertexArrays(1, &vertexArray.second);
+	}
+	for (const auto& texture : textures) {
+		glDeleteTextures(1, &texture.second);
+	}
+	for (const auto& sampler : samplers) {
+		glDeleteSamplers(1, &sampler.second);
+	}
+	programs.clear();
+	buffers.clear();
+	vertexArrays.clear();
+	textures.clear();
+	samplers.clear();
+	commands.clear();
+
+	if (framebuffer != 0) {
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &colorTarget);
+		glDeleteRenderbuffers(1, &depthTarget);
+		framebuffer = colorTarget = depthTarget = 0;
+	}
+}
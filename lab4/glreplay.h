@@ -0,0 +1,54 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <vector>
+#include <map>
+
+// OpenGL
+#include <GL/glew.h>
+
+// Project includes - needed for definitions
+#include "glcapture.h"
+
+// Runs a frame written by GLCapture. The capture is decoded once up front, uniform names resolved to
+// locations and object names remapped, so a run is the command stream and nothing else; its CPU time is
+// the driver's cost of the frame, and the live frame's CPU time minus it is the renderer's own overhead.
+// Renders into an offscreen target the size of the captured frame, the window can stay hidden
+class GLReplay {
+public:
+	GLReplay();
+	~GLReplay();
+
+	bool load(const std::string& path);
+	// Runs the frame iterations times after one warm-up run and prints the CPU and GPU times
+	void run(int iterations);
+
+private:
+	struct ReplayCommand {
+		GLCapture::Command command;
+		GLenum target;     // texture target, draw mode, capability, depth function, texture unit or sampler unit, clear mask
+		GLuint object;     // program, texture, sampler or vertex array, already remapped
+		GLint location;    // uniform location, first vertex for draws
+		GLsizei count;
+		int value;
+		float values[16];
+	};
+
+	std::string path;
+	int width, height;
+	float capturedCpuMilliseconds, capturedGpuMilliseconds;
+
+	std::map<GLuint, GLuint> programs;
+	std::map<GLuint, GLuint> buffers;
+	std::map<GLuint, GLuint> vertexArrays;
+	std::map<GLuint, GLuint> textures;
+	std::map<GLuint, GLuint> samplers;
+	std::vector<ReplayCommand> commands;
+
+	GLuint framebuffer;
+	GLuint colorTarget, depthTarget;
+
+	void execute();
+	void release();
+};
@@ -5,6 +5,7 @@
 #include <vector>
 #include <iostream>
 #include <limits>
+#include <chrono>
 #include <math.h>
 
 namespace std {
@@ -37,6 +38,10 @@ namespace std {
 #include "model.h"
 #include "directionallight.h"
 #include "skybox.h"
+#include "camerarecorder.h"
+#include "glcapture.h"
+#include "glreplay.h"
+#include "samplers.h"
 
 #include "imgui.h"
 #include "imgui_impl_glut.h"
@@ -44,6 +49,11 @@ namespace std {
 
 #define CAMERASPEED 50.0f
 
+// --bench-filtering renders offscreen at this size
+#define BENCHMARK_WIDTH 1920
+#define BENCHMARK_HEIGHT 1080
+#define BENCHMARK_FRAMES 200
+
 
 typedef struct
 {
@@ -80,14 +90,10 @@ float lightPos[3] = { 10.0f, 10.0f, 4.0f };
 static int currentMaterial = 0;
 static int previousMaterial = -1;
 
-enum class MipmapMode : int {
-	Trilinear = 0,
-	Bilinear = 1,
-	Nearest = 2,
-	NoMip = 3
-};
-
+// Filtering comes from sampler objects bound to the material units, the textures' own parameters are unused
+TextureSamplers* samplers = nullptr;
 static MipmapMode currentMipmapMode = MipmapMode::Trilinear;
+static int anisotropyLevel = 0;
 
 
 float textureScale =1.0f;
@@ -99,43 +105,20 @@ struct MaterialTextures {
 };
 MaterialTextures materialTextures[3]; // brick, wicker, fabric
 
-// Forward declaration - defined in model.cpp
-unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false);
+// Flythrough recording and replay, 'r' toggles recording
+CameraRecorder recorder;
+const char* flythroughFile = "flythrough.cam";
+// 'c' writes the next frame's GL commands here, for --gl-replay
+const char* captureFile = "frame.glcap";
 
-void applyMipmapMode(MipmapMode mode) {
-	GLenum minFilter;
-	switch (mode)
-	{
-	case MipmapMode::Trilinear:
-		minFilter = GL_LINEAR_MIPMAP_LINEAR;
-		break;
-	case MipmapMode::Bilinear:
-		minFilter = GL_LINEAR_MIPMAP_NEAREST;
-		break;
-	case MipmapMode::Nearest:
-		minFilter = GL_NEAREST_MIPMAP_NEAREST;
-		break;
-	case MipmapMode::NoMip:
-		minFilter = GL_LINEAR;
-		break;
-	default:
-		minFilter = GL_LINEAR_MIPMAP_LINEAR;
-		break;
-	}
-	for (const Texture& tex : Model::textures_loaded) {
-		glBindTexture(GL_TEXTURE_2D, tex.id);
-		
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	}
-	for (int i = 0; i < 3; i++) {
-		glBindTexture(GL_TEXTURE_2D, materialTextures[i].diffuse);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+// Frame times measured during a replay
+double replayFrameTotal = 0.0;
+double replayFrameMin = 0.0;
+double replayFrameMax = 0.0;
+int replayFrames = 0;
 
-		glBindTexture(GL_TEXTURE_2D, materialTextures[i].normal);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
-	}
-}
+// Forward declaration - defined in model.cpp
+unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false);
 
 // Function to update textures on all models
 void updateModelTextures(int materialIndex) {
@@ -161,6 +144,39 @@ void updateModelTextures(int materialIndex) {
 	}
 }
 
+CameraFrame captureFrame() {
+	CameraFrame frame;
+	frame.position = camera.position;
+	frame.direction = camera.direction;
+	frame.yaw = yaw;
+	frame.pitch = pitch;
+	frame.material = currentMaterial;
+	frame.mipmapMode = static_cast<int>(currentMipmapMode);
+	frame.anisotropyLevel = anisotropyLevel;
+	frame.textureScale = textureScale;
+	return frame;
+}
+
+void applyFrame(const CameraFrame& frame) {
+	camera.position = frame.position;
+	camera.direction = frame.direction;
+	yaw = frame.yaw;
+	pitch = frame.pitch;
+	textureScale = frame.textureScale;
+
+	// A log from another build or a damaged one may name settings this one doesn't have
+	int materialCount = sizeof(materialTextures) / sizeof(materialTextures[0]);
+	currentMaterial = glm::clamp(frame.material, 0, materialCount - 1);
+
+	// Only rebind textures when the log says the state changed
+	if (currentMaterial != previousMaterial) {
+		updateModelTextures(currentMaterial);
+		previousMaterial = currentMaterial;
+	}
+	currentMipmapMode = static_cast<MipmapMode>(glm::clamp(frame.mipmapMode, 0, TextureSamplers::MODE_COUNT - 1));
+	anisotropyLevel = glm::clamp(frame.anisotropyLevel, 0, TextureSamplers::ANISOTROPY_LEVELS - 1);
+}
+
 #pragma region INPUT_FUNCTIONS
 
 static bool g_keyPressed = false;
@@ -194,6 +210,27 @@ void keypress(unsigned char key, int x, int y) {
 		glutLeaveMainLoop();
 	}
 
+	// Capture the next frame's GL commands, works during a replay too
+	if (key == 'c') {
+		GLCapture::capture(captureFile);
+		return;
+	}
+
+	// The log drives the camera during a replay
+	if (recorder.isReplaying()) {
+		return;
+	}
+
+	if (key == 'r') {
+		if (recorder.isRecording()) {
+			recorder.stopRecording();
+		}
+		else {
+			recorder.startRecording(flythroughFile);
+		}
+		return;
+	}
+
 	// Forward/Backward and sideways movement
 	if (key == 'w') {
 		camera.position += camera.direction * CAMERASPEED * delta;
@@ -226,7 +263,7 @@ void mouse(int x, int y) {
 
 	ImGuiIO& io = ImGui::GetIO();
 	
-	if (io.WantCaptureMouse || showGUI) {
+	if (io.WantCaptureMouse || showGUI || recorder.isReplaying()) {
 		return;
 	}
 	// If the mouse has just entered the window
@@ -323,13 +360,21 @@ void renderGUI() {
 
 		if (ImGui::CollapsingHeader("MipMap Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
 
-			const char* mipmapItems[] = { "Trilinear", "Bilinear", "Nearest", "No Mipmapping" };
+			const char* mipmapItems[TextureSamplers::MODE_COUNT];
+			for (int i = 0; i < TextureSamplers::MODE_COUNT; i++) {
+				mipmapItems[i] = TextureSamplers::getModeName(static_cast<MipmapMode>(i));
+			}
+			const char* anisotropyItems[TextureSamplers::ANISOTROPY_LEVELS];
+			for (int i = 0; i < TextureSamplers::ANISOTROPY_LEVELS; i++) {
+				anisotropyItems[i] = TextureSamplers::getAnisotropyName(i);
+			}
 			int modeIndex = static_cast<int>(currentMipmapMode);
 			if (ImGui::CollapsingHeader("Texture Filtering", ImGuiTreeNodeFlags_DefaultOpen)) {
 				if (ImGui::Combo("Mipmap Mode", &modeIndex, mipmapItems, IM_ARRAYSIZE(mipmapItems))) {
 					currentMipmapMode = static_cast<MipmapMode>(modeIndex);
-					applyMipmapMode(currentMipmapMode);
 				}
+				ImGui::Combo("Anisotropy", &anisotropyLevel, anisotropyItems, IM_ARRAYSIZE(anisotropyItems));
+				ImGui::Text("Hardware maximum %.0fx", samplers->getMaxAnisotropy());
 			}
 
 			ImGui::SliderFloat("Texture Scale", &textureScale,1.0f,25.0f, "x %.1f");
@@ -363,34 +408,49 @@ void printMatrix(const glm::mat4& matrix, const std::string& name) {
 	}
 }
 
-void display() {
-	glEnable(GL_DEPTH_TEST);
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glDepthFunc(GL_LESS);
-	
-	
-	glm::vec3 rotation = glm::vec3(0.0, 50.0, 50.0);
-	glm::vec3 position;
-	
+void drawScene() {
 	shader->use();
 
-	int view_mat_location = glGetUniformLocation(shader->ID, "view");
-	int proj_mat_location = glGetUniformLocation(shader->ID, "proj");
-
-	glUniformMatrix4fv(proj_mat_location, 1, GL_FALSE, glm::value_ptr(persp_proj));
-	glUniformMatrix4fv(view_mat_location, 1, GL_FALSE, glm::value_ptr(view));
+	shader->setMat4("proj", persp_proj);
+	shader->setMat4("view", view);
+	shader->setFloat("textureScale", textureScale);
 
-	int texScaleLocation = glGetUniformLocation(shader->ID, "textureScale");
-	glUniform1f(texScaleLocation, textureScale);
+	// Diffuse and normal map units
+	samplers->bind(0, 2, currentMipmapMode, anisotropyLevel);
 
 	cubes[0]->Draw();
+}
+
+void display() {
+	// The scene's commands go through GLCapture so 'c' can write this frame out, the GUI is left out
+	GLCapture::beginFrame(width, height);
+	GLCapture::enable(GL_DEPTH_TEST);
+	GLCapture::clearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	GLCapture::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	GLCapture::depthFunc(GL_LESS);
+	
+	
+	drawScene();
+	GLCapture::endFrame();
 	renderGUI();
 	glutSwapBuffers();
+
+	// Wait for the GPU so a replayed frame's time covers its whole render
+	if (recorder.isReplaying()) {
+		glFinish();
+	}
 }
 
 
+void printReplayStats() {
+	if (replayFrames == 0) {
+		return;
+	}
+	std::cout << "Replayed " << replayFrames << " frames: mean " << replayFrameTotal / replayFrames << " ms, min "
+		<< replayFrameMin << " ms, max " << replayFrameMax << " ms" << std::endl;
+}
+
 void updateScene() {
 
 	static DWORD last_time = 0;
@@ -398,6 +458,33 @@ void updateScene() {
 	if (last_time == 0)
 		last_time = curr_time;
 	delta = (curr_time - last_time) * 0.001f;
+
+	if (recorder.isReplaying()) {
+		// timeGetTime only counts whole milliseconds, too coarse for frame times of a few ms
+		static std::chrono::high_resolution_clock::time_point lastReplayFrame;
+		std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+		// The first frame has no previous one to measure against
+		static bool firstReplayFrame = true;
+		if (!firstReplayFrame) {
+			double frameTime = std::chrono::duration<double, std::milli>(now - lastReplayFrame).count();
+			replayFrameMin = replayFrames == 0 || frameTime < replayFrameMin ? frameTime : replayFrameMin;
+			replayFrameMax = replayFrames == 0 || frameTime > replayFrameMax ? frameTime : replayFrameMax;
+			replayFrameTotal += frameTime;
+			replayFrames++;
+		}
+		firstReplayFrame = false;
+		lastReplayFrame = now;
+
+		// Fixed timestep so the replay is identical whatever the machine
+		delta = CameraRecorder::FIXED_TIMESTEP;
+		CameraFrame frame;
+		if (!recorder.next(frame)) {
+			printReplayStats();
+			glutLeaveMainLoop();
+			return;
+		}
+		applyFrame(frame);
+	}
 	last_time = curr_time;
 
 	view = glm::lookAt(
@@ -405,6 +492,10 @@ void updateScene() {
 		camera.position + camera.direction,
 		glm::vec3(0.0f,1.0f,0.0f) // Ensure the up vector is consistent and correct
 	);
+
+	if (recorder.isRecording()) {
+		recorder.record(captureFrame());
+	}
 	
 	// Draw the next frame
 	glutPostRedisplay();
@@ -414,6 +505,7 @@ void updateScene() {
 void init()
 {
 	shader = new Shader("simpleVertexShader.txt", "simpleFragmentShader.txt");
+	samplers = new TextureSamplers();
 
 	Model* cube = new Model("cube.obj", glm::vec3(0.0f ,0.0, -20.0), shader);
 	
@@ -445,11 +537,87 @@ void init()
 	previousMaterial = currentMaterial;
 }
 
+#pragma region BENCHMARKS
+
+// GPU time of the scene under every mipmap mode and anisotropy level, on the wicker and checker materials.
+// The view runs along the floor with the texture scale at the slider's maximum so most of the screen is
+// minified at a grazing angle, which is where the presets differ
+void runFilteringBenchmark(int frames) {
+	GLuint colorTarget, depthTarget, framebuffer;
+	glGenRenderbuffers(1, &colorTarget);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorTarget);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+	glGenRenderbuffers(1, &depthTarget);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthTarget);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorTarget);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthTarget);
+	glViewport(0, 0, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+
+	view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -0.4f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	persp_proj = glm::perspective(glm::radians(45.0f), (float)BENCHMARK_WIDTH / (float)BENCHMARK_HEIGHT, 0.1f, 1000.0f);
+	textureScale = 25.0f;
+
+	GLuint query;
+	glGenQueries(1, &query);
+
+	const int benchmarkMaterials[2] = { 1, 2 };
+	const char* materialNames[2] = { "Wicker", "Checker" };
+
+	std::cout << "Filtering benchmark: " << BENCHMARK_WIDTH << "x" << BENCHMARK_HEIGHT << ", " << frames
+		<< " frames per preset, hardware anisotropy up to " << samplers->getMaxAnisotropy() << "x" << std::endl;
+	for (int m = 0; m < 2; m++) {
+		updateModelTextures(benchmarkMaterials[m]);
+		for (int mode = 0; mode < TextureSamplers::MODE_COUNT; mode++) {
+			// Anisotropy needs mipmaps to choose from
+			int levels = (MipmapMode)mode == MipmapMode::NoMip ? 1 : TextureSamplers::ANISOTROPY_LEVELS;
+			for (int level = 0; level < levels; level++) {
+				currentMipmapMode = (MipmapMode)mode;
+				anisotropyLevel = level;
+
+				double gpuTotal = 0.0;
+				// One untimed frame so the first sample does not pay for the switch
+				for (int frame = -1; frame < frames; frame++) {
+					glBeginQuery(GL_TIME_ELAPSED, query);
+					glEnable(GL_DEPTH_TEST);
+					glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					drawScene();
+					glEndQuery(GL_TIME_ELAPSED);
+
+					GLuint64 elapsed = 0;
+					glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+					if (frame >= 0) {
+						gpuTotal += elapsed / 1000000.0;
+					}
+				}
+				std::cout << "  " << materialNames[m] << ", " << TextureSamplers::getModeName(currentMipmapMode) << ", anisotropy "
+					<< TextureSamplers::getAnisotropyName(level) << ": " << gpuTotal / frames << " ms GPU" << std::endl;
+			}
+		}
+	}
+
+	glDeleteQueries(1, &query);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &colorTarget);
+	glDeleteRenderbuffers(1, &depthTarget);
+}
+
+#pragma endregion BENCHMARKS
+
 void cleanup() {
+	recorder.stopRecording();
+
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGLUT_Shutdown();
 	ImGui::DestroyContext();
 
+	delete samplers;
 	delete shader;
 }
 
@@ -473,6 +641,19 @@ int main(int argc, char** argv) {
 		return 1;
 	}
 
+	// --gl-replay <file> [iterations] times a captured frame without loading the scene
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--gl-replay" && i + 1 < argc) {
+			glutHideWindow();
+			GLReplay replay;
+			if (!replay.load(argv[i + 1])) {
+				return 1;
+			}
+			replay.run(i + 2 < argc ? atoi(argv[i + 2]) : 100);
+			return 0;
+		}
+	}
+
 	ImGuiContext* ctx = ImGui::CreateContext();
 	ImGui::SetCurrentContext(ctx);
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
@@ -484,6 +665,33 @@ int main(int argc, char** argv) {
 
 	init();
 
+	// --bench-filtering [frames] times every filtering preset offscreen and exits
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--bench-filtering") {
+			glutHideWindow();
+			int frames = i + 1 < argc ? atoi(argv[i + 1]) : 0;
+			runFilteringBenchmark(frames > 0 ? frames : BENCHMARK_FRAMES);
+			return 0;
+		}
+	}
+
+	// --record <file> logs the flythrough from the first frame, --replay <file> plays one back and exits,
+	// --capture <file> times the first frame and writes the second frame's GL commands
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--record" && i + 1 < argc) {
+			recorder.startRecording(argv[++i]);
+		}
+		else if (std::string(argv[i]) == "--capture" && i + 1 < argc) {
+			GLCapture::capture(argv[++i]);
+		}
+		else if (std::string(argv[i]) == "--replay" && i + 1 < argc) {
+			if (!recorder.load(argv[++i])) {
+				return 1;
+			}
+			std::cout << "Replaying " << recorder.getFrameCount() << " frames from " << argv[i] << std::endl;
+		}
+	}
+
 	glutDisplayFunc(display);
 	glutIdleFunc(updateScene);
 	glutKeyboardFunc(keypress);
@@ -21,6 +21,7 @@ namespace std {
 
 // Project includes
 #include "shader.h"
+#include "glcapture.h"
 
 // Assimp includes
 #include <assimp/cimport.h> // scene importer
@@ -41,26 +42,25 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std:
 void Mesh::Draw(glm::mat4 model) {
 	Material material;
 	for (unsigned int i = 0; i < textures.size(); i++) {
-		glActiveTexture(GL_TEXTURE0 + i);
+		GLCapture::activeTexture(GL_TEXTURE0 + i);
 		string name = textures[i].type;
 		if (name == "texture_diffuse") {
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			GLCapture::bindTexture(GL_TEXTURE_2D, textures[i].id);
 			shader->setInt("ourTexture", 0);
 			material = textures[i].material;
 		}
 		else if (name == "texture_normal") {
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			GLCapture::bindTexture(GL_TEXTURE_2D, textures[i].id);
 			shader->setInt("normalMap", 1);
 		}
 	}
 
-	int matrix_location = glGetUniformLocation(shaderProgramID, "model");
-	glUniformMatrix4fv(matrix_location, 1, GL_FALSE, glm::value_ptr(model));
-	glBindVertexArray(VAO);
-	glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-	glBindVertexArray(0);
+	shader->setMat4("model", model);
+	GLCapture::bindVertexArray(VAO);
+	GLCapture::drawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+	GLCapture::bindVertexArray(0);
 
-	glActiveTexture(GL_TEXTURE0);
+	GLCapture::activeTexture(GL_TEXTURE0);
 }
     
 void Mesh::setupMesh() {
@@ -0,0 +1,71 @@
+#include "samplers.h"
+
+// Project includes - needed for definitions
+#include "glcapture.h"
+
+TextureSamplers::TextureSamplers() {
+	this->maxAnisotropy = 1.0f;
+	if (GLEW_EXT_texture_filter_anisotropic) {
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+	}
+
+	glGenSamplers(MODE_COUNT * ANISOTROPY_LEVELS, &samplers[0][0]);
+	for (int mode = 0; mode < MODE_COUNT; mode++) {
+		GLenum minFilter;
+		switch ((MipmapMode)mode)
+		{
+		case MipmapMode::Bilinear:
+			minFilter = GL_LINEAR_MIPMAP_NEAREST;
+			break;
+		case MipmapMode::Nearest:
+			minFilter = GL_NEAREST_MIPMAP_NEAREST;
+			break;
+		case MipmapMode::NoMip:
+			minFilter = GL_LINEAR;
+			break;
+		default:
+			minFilter = GL_LINEAR_MIPMAP_LINEAR;
+			break;
+		}
+
+		for (int level = 0; level < ANISOTROPY_LEVELS; level++) {
+			GLuint sampler = samplers[mode][level];
+			// Same wrapping TextureFromFile gives the textures, the sampler replaces all of their state
+			glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, minFilter);
+			glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			if (GLEW_EXT_texture_filter_anisotropic) {
+				float anisotropy = (float)(1 << level);
+				glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy < maxAnisotropy ? anisotropy : maxAnisotropy);
+			}
+		}
+	}
+}
+
+TextureSamplers::~TextureSamplers() {
+	glDeleteSamplers(MODE_COUNT * ANISOTROPY_LEVELS, &samplers[0][0]);
+}
+
+GLuint TextureSamplers::get(MipmapMode mode, int anisotropyLevel) const {
+	int modeIndex = (int)mode >= 0 && (int)mode < MODE_COUNT ? (int)mode : 0;
+	int level = anisotropyLevel < 0 ? 0 : anisotropyLevel >= ANISOTROPY_LEVELS ? ANISOTROPY_LEVELS - 1 : anisotropyLevel;
+	return samplers[modeIndex][level];
+}
+
+void TextureSamplers::bind(GLuint firstUnit, GLuint unitCount, MipmapMode mode, int anisotropyLevel) const {
+	GLuint sampler = get(mode, anisotropyLevel);
+	for (GLuint unit = firstUnit; unit < firstUnit + unitCount; unit++) {
+		GLCapture::bindSampler(unit, sampler);
+	}
+}
+
+const char* TextureSamplers::getModeName(MipmapMode mode) {
+	const char* names[MODE_COUNT] = { "Trilinear", "Bilinear", "Nearest", "No Mipmapping" };
+	return (int)mode >= 0 && (int)mode < MODE_COUNT ? names[(int)mode] : "";
+}
+
+const char* TextureSamplers::getAnisotropyName(int anisotropyLevel) {
+	const char* names[ANISOTROPY_LEVELS] = { "Off", "2x", "4x", "8x", "16x" };
+	return anisotropyLevel >= 0 && anisotropyLevel < ANISOTROPY_LEVELS ? names[anisotropyLevel] : "";
+}
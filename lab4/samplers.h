@@ -0,0 +1,41 @@
+#pragma once
+
+// OpenGL
+#include <GL/glew.h>
+
+// Minification presets of the texture filtering combo
+enum class MipmapMode : int {
+	Trilinear = 0,
+	Bilinear = 1,
+	Nearest = 2,
+	NoMip = 3
+};
+
+// Sampler objects for every mipmap mode and anisotropy level, created once up front. A sampler bound to a
+// texture unit overrides the filtering stored in whatever texture is bound there, so switching the filtering
+// of every texture in the scene is one glBindSampler per unit instead of a glTexParameteri per texture
+class TextureSamplers {
+public:
+	static constexpr int MODE_COUNT = 4;
+	// Anisotropy level n is 2^n samples: off, 2x, 4x, 8x, 16x
+	static constexpr int ANISOTROPY_LEVELS = 5;
+
+	TextureSamplers();
+	~TextureSamplers();
+
+	// Levels above what the hardware supports are created with its maximum
+	GLuint get(MipmapMode mode, int anisotropyLevel) const;
+	// Binds the sampler to units [firstUnit, firstUnit + unitCount), through GLCapture so captures keep it
+	void bind(GLuint firstUnit, GLuint unitCount, MipmapMode mode, int anisotropyLevel) const;
+
+	float getMaxAnisotropy() const { return maxAnisotropy; }
+	static const char* getModeName(MipmapMode mode);
+	static const char* getAnisotropyName(int anisotropyLevel);
+
+	TextureSamplers(const TextureSamplers&) = delete;
+	TextureSamplers& operator=(const TextureSamplers&) = delete;
+
+private:
+	GLuint samplers[MODE_COUNT][ANISOTROPY_LEVELS];
+	float maxAnisotropy;
+};
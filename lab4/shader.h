@@ -22,6 +22,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// Project includes - needed for definitions
+#include "glcapture.h"
+
 class Shader {
 public:
 	GLuint ID;
@@ -69,27 +72,27 @@ public:
 	}
 
 	void use() {
-		glUseProgram(ID);
+		GLCapture::useProgram(ID);
 	};
 
 	void setBool(const std::string& name, bool value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		GLCapture::uniform(ID, name, (int)value);
 	}
 
 	void setInt(const std::string& name, int value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		GLCapture::uniform(ID, name, value);
 	}
 
 	void setFloat(const std::string& name, float value) const {
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		GLCapture::uniform(ID, name, value);
 	}
 
 	void setVec3(const std::string& name, const glm::vec3& value) const {
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+		GLCapture::uniform(ID, name, value);
 	}
 
 	void setMat4(const std::string& name, const glm::mat4& value) const {
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+		GLCapture::uniform(ID, name, value);
 	}
 
 private: